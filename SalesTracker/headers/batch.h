@@ -0,0 +1,80 @@
+/**
+ * @file batch.h
+ * @author Luke Early
+ * Header file with function prototypes for batch.c.
+ *
+ * A scripted session often has long runs of reports with no sale between
+ * them. Each report reads only a pinned snapshot or the live counts, so a
+ * run of them can be spread over a pool of threads. Sales come only from
+ * the script, so the one thing that could change the group during a batch
+ * is a background reload, and reloads are held off until the batch is
+ * done: every command in a batch reads the same records. Every command
+ * writes into its own memory buffer, and the buffers are written out in
+ * the order the commands were given, so the output is the same as running
+ * them one after another with no reload landing in between.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "group.h"
+
+/** Most threads a batch pool can have */
+#define BATCH_THREADS_MAX 64
+
+/** Most commands gathered into one batch */
+#define BATCH_MAX 1024
+
+struct BatchPoolStruct {
+  pthread_mutex_t lock;  // guards everything below
+  pthread_cond_t work;   // signalled when a batch is posted or the pool stops
+  pthread_cond_t done;   // signalled when the last command of a batch finishes
+  pthread_t threads[ BATCH_THREADS_MAX ];
+  int threadCount;       // threads besides the one running the batch
+  bool stop;
+  Group *group;          // the batch being run
+  char **cmds;
+  char **outputs;        // output of each command, once it's finished
+  size_t *lengths;
+  int count;
+  int next;              // next command for a thread to take
+  int finished;
+};
+typedef struct BatchPoolStruct BatchPool;
+
+/**
+ * Starts a pool of threads for running batches. The thread that runs a
+ * batch works on it too, so a pool of one thread starts no others.
+ *
+ * @param threads how many threads run each batch, up to BATCH_THREADS_MAX
+ * @return pointer to the new BatchPool
+ */
+BatchPool *makeBatchPool( int threads );
+
+/**
+ * Stops the pool's threads and frees it.
+ *
+ * @param pool to free
+ */
+void freeBatchPool( BatchPool *pool );
+
+/**
+ * Runs a batch of read-only commands at the same time, then writes the
+ * output of each to out in the order they were given, each followed by
+ * separator. No reload is applied while the batch runs, and no sale may
+ * be recorded by another thread.
+ *
+ * @param pool the pool to run them on
+ * @param group the live group
+ * @param cmds the command lines, all passing readOnlyCommand()
+ * @param count number of commands, up to BATCH_MAX
+ * @param separator written after each command's output, such as a prompt
+ * @param out stream the output is written to
+ */
+void runBatch( BatchPool *pool, Group *group, char **cmds, int count, char const *separator, FILE *out );
+
+#endif
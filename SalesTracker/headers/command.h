@@ -0,0 +1,43 @@
+/**
+ * @file command.h
+ * @author Luke Early
+ * Header file with function prototypes for command.c.
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "group.h"
+
+/** Longest single word accepted in a user command */
+#define WORD_MAX 30
+
+/** Rows in a leaderboard when the command doesn't give a number */
+#define TOP_ROWS 10
+
+/**
+ * Tells whether a command line only reads the group, so it can run at the
+ * same time as other such commands.
+ *
+ * @param cmd the raw command line
+ * @return true for list, search and history commands
+ */
+bool readOnlyCommand( char const *cmd );
+
+/**
+ * Runs a single line of the command language against the given group.
+ *
+ * All output for the command (including the echoed command line) is written
+ * to out, so the same commands can be served to the terminal or to a socket.
+ *
+ * @param group the group the command operates on
+ * @param cmd the raw command line, without its trailing newline
+ * @param out stream the command's output is written to
+ * @return false if the command was quit, true otherwise
+ */
+bool runCommand( Group *group, char const *cmd, FILE *out );
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file export.h
+ * @author Luke Early
+ * Header file with function prototypes for export.c.
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "group.h"
+
+/** Bytes collected before each write to the export file */
+#define EXPORT_BUFFER_SIZE ( 1 << 20 )
+
+/** Most bytes one exported row can take, with every name character escaped */
+#define EXPORT_ROW_MAX 512
+
+/** Rows between progress reports, for exports bigger than this */
+#define EXPORT_PROGRESS_ROWS 1000000
+
+/**
+ * Writes one report of a group to a file as CSV or JSON Lines, straight
+ * from a read view of the group.
+ *
+ * The report is items, members or sales (one row for each item a member
+ * has sold), in the order they were loaded. Rows are formatted directly
+ * into a large buffer that is written out whenever it fills, so no
+ * intermediate strings are built. A line saying how many rows were
+ * written, and a progress line every EXPORT_PROGRESS_ROWS rows of a big
+ * export, go to out.
+ *
+ * @param group the live group
+ * @param report items, members or sales
+ * @param format csv or jsonl
+ * @param filename name of the file to write
+ * @param out stream progress and the result are written to
+ * @return false if the report or format isn't known
+ */
+bool exportReport( Group *group, char const *report, char const *format, char const *filename, FILE *out );
+
+#endif
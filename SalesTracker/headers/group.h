@@ -1,135 +1,432 @@
-/**
- * @file group.h
- * @author Luke Early
- * Group header file containing all function prototypes.
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdbool.h>
-
-#define NAME_MAX 30
-#define ID_MAX 8
-#define INIT_CAPACITY 5
-
-struct ItemStruct {
-  int id;
-  char name[ NAME_MAX ];
-  int cost;
-  int numSold;
-  char **mList;
-  int mCap;
-  int mCount;
-};
-typedef struct ItemStruct Item;
-
-struct SaleItemStruct {
-  Item *itemPtr;
-  int numSold;
-};
-typedef struct SaleItemStruct SaleItem;
-
-struct MemberStruct {
-  char id[ ID_MAX ];
-  char name[ NAME_MAX ];
-  SaleItem **list;
-  int count;
-  int capacity; // initial capacity of 5
-};
-typedef struct MemberStruct Member;
-
-struct GroupStruct {
-  int iCount;
-  Item **iList;
-  int iCap;
-  int mCount;
-  Member **mList;
-  int mCap;
-};
-typedef struct GroupStruct Group;
-
-/**
- * This function dynamically allocates storage for the Group, initializes its 
- * fields (to store the two resizable arrays) and returns a pointer to the new 
- * Group. It’s kind of like a constructor in Java.
- * 
- * @return pointer to Group Struct
- */
-Group *makeGroup();
-
-/**
- * This function frees the memory used to store the given Group, including 
- * freeing space for all the Items, Members, and Member SaleItem lists, freeing 
- * the resizable arrays of pointers and freeing space for the Group struct itself.
- * 
- * @param group group containing all memory to be freed
- */
-void freeGroup( Group *group );
-
-/** 
- * This function reads all the items from an item file with the given name. 
- * 
- * It makes an instance of the Item struct for an item in the file and stores a 
- * pointer to that Item in the resizable item array in group.
- * 
- * Exits unsuccessful if criteria for file are not met.
- * 
- * @param filename is the name of the group file passed to the function
- * @param group is the pointer to the group that the file will read the item into
- */
-void readItems( char const *filename, Group *group );
-
-/** 
- * This function reads all the members from a member file with the given name.
- * 
- * Makes an instance of the Member struct for a member in the file and stores a 
- * pointer to that Member in the resizable member array in group.
- * 
- * Exits unsuccessful if:
- *     - name longer than 30
- *     - ID longer than 8
- *     - missing a field
- *     - two IDs are the same
- * 
- * @param filename string for the member file name
- * @param group pointer to group this will populate
- */
-void readMembers( char const *filename, Group *group );
-
-/** 
- * This function sorts the items in the given group based on input from user.
- * 
- * Used in conjunction with qsort()
- * 
- * @param group the group with the items that will be sorted
- * @param compare the function that will handle the sorting
- */
-void sortItems( Group *group, int (* compare) (void const *va, void const *vb ));
-
-/** 
- * This function sorts the members in the given group based on input from user.
- * 
- * Used in conjunction with qsort()
- * 
- * @param group the group with the items that will be sorted
- * @param compare the function that will handle the sorting
- */
-void sortMembers( Group *group, int (* compare) (void const *va, void const *vb ));
-
-/** 
- * This function prints all or some of the items based on test and str from user input. 
- * 
- * @param group from which the items will be printed
- * @param test function to handle determining if an item should be printed or not
- * @param str basis upon which items are or are not printed
- */
-void listItems( Group *group, bool (*test)( Item const *item, char const *str ), char const *str );
-
-/** 
- * This function prints all or some of the members based on test and str from user input. 
- * 
- * @param group from which the members will be printed
- * @param test function to handle determining if an item should be printed or not
- * @param str basis upon which members are or are not printed
- */
-void listMembers( Group *group, bool (*test)( Member const *member, char const *str ), char const *str );
+/**
+ * @file group.h
+ * @author Luke Early
+ * Group header file containing all function prototypes.
+ */
+
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "intern.h"
+#include "loader.h"
+
+#define NAME_MAX 30
+#define ID_MAX 8
+#define INIT_CAPACITY 5
+
+/** Parts of a report this small are put in order by insertion sort */
+#define SORT_RANGE_SMALL 16
+
+/** Shards an item's seller ranking is split into, by member index */
+#define SELLER_SHARDS 8
+
+/** Shards a group's recent sales are split into, by the thread recording them */
+#define SALE_SHARDS 16
+
+struct RollupStruct;
+struct RankNodeStruct;
+struct RankingStruct;
+struct SketchStruct;
+
+struct ItemStruct {
+  int id;
+  char name[ NAME_MAX + 1 ];
+  int cost;
+  int numSold;
+  long version; // epoch of the snapshot that will show the latest change
+  struct RankingStruct **sellers; // members who sold it, most first, in SELLER_SHARDS
+                                  // rankings split by member index, NULL until its first sale
+};
+typedef struct ItemStruct Item;
+
+struct SaleItemStruct {
+  Item *itemPtr;
+  int numSold;
+  struct RankNodeStruct *rank; // the member's place in the item's sellers, live SaleItems only
+};
+typedef struct SaleItemStruct SaleItem;
+
+struct MemberStruct {
+  StrHandle id;   // handle in the group's ID pool, equal to the member's index
+  StrHandle name; // handle in the group's name pool
+  SaleItem **list;
+  int count;
+  int capacity; // 0 until the first sale, then starts at 5
+  int sold;     // totals of its SaleItems, kept up to date as sales are recorded
+  int sales;
+  long version; // epoch of the snapshot that will show the latest change
+};
+typedef struct MemberStruct Member;
+
+/**
+ * The rows of a report to print: at most limit rows, starting with the
+ * one at offset. A negative limit means every row from offset on.
+ */
+struct PageStruct {
+  int offset;
+  int limit;
+};
+typedef struct PageStruct Page;
+
+/** Page holding every row of a report */
+#define ALL_ROWS ( ( Page ) { 0, -1 } )
+
+/**
+ * One shard of the group's item leaderboards: what each item has sold in
+ * the shard, ranked by revenue and by units. The group's shard lock of the
+ * same number guards it, along with the shard's rollup.
+ */
+struct ItemRanksStruct {
+  struct RankingStruct *byRevenue;
+  struct RankingStruct *byUnits;
+  struct RankNodeStruct **revenue; // each item's node in byRevenue, by index, NULL until it sells in the shard
+  struct RankNodeStruct **units;   // each item's node in byUnits
+  int cap;
+};
+typedef struct ItemRanksStruct ItemRanks;
+
+struct VersionsStruct;
+struct SnapshotStruct;
+struct ReloadStruct;
+struct HistoryStruct;
+struct PublisherStruct;
+struct LazyStruct;
+
+struct GroupStruct {
+  int iCount;
+  Item **iList;
+  int iCap;
+  int mCount;
+  Member **mList; // NULL where a lazily loaded member hasn't been made yet
+  int mCap;
+  StrPool *ids;   // every member ID, shared by the live group and its views
+  StrPool *names; // every member name
+  int totalSold;  // kept up to date by recordSale(), with atomic adds
+  int totalSales;
+  struct VersionsStruct *versions; // published snapshots, live group only
+  struct SnapshotStruct *snapshot; // snapshot a read view is pinned to
+  int pin;                         // reader slot held by a read view
+  char *itemFile;                  // files the live group was loaded from
+  char *memberFile;
+  FileMark itemMark;               // how much of each file has been loaded
+  FileMark memberMark;
+  struct ReloadStruct *reload;     // background reload of the files
+  struct HistoryStruct *history;   // every sale ever recorded, NULL if not kept
+  void *windowRecords;             // record copies a windowed view's list points into
+  struct SketchStruct *sketch;     // approximate top sellers, NULL unless asked for
+  struct PublisherStruct *publisher; // copies snapshots to shared memory, NULL if not kept
+  struct LazyStruct *lazy;         // member lines not made into members yet, NULL unless loading lazily
+  struct RollupStruct *rollups[ SALE_SHARDS ]; // recent sales, live group only
+  ItemRanks *topItems[ SALE_SHARDS ];          // item leaderboards, live group only
+};
+typedef struct GroupStruct Group;
+
+/**
+ * This function dynamically allocates storage for the Group, initializes its 
+ * fields (to store the two resizable arrays) and returns a pointer to the new 
+ * Group. It’s kind of like a constructor in Java.
+ * 
+ * @return pointer to Group Struct
+ */
+Group *makeGroup();
+
+/**
+ * This function frees the memory used to store the given Group, including 
+ * freeing space for all the Items, Members, and Member SaleItem lists, freeing 
+ * the resizable arrays of pointers and freeing space for the Group struct itself.
+ * 
+ * @param group group containing all memory to be freed
+ */
+void freeGroup( Group *group );
+
+/** 
+ * This function reads all the items from an item file with the given name. 
+ * 
+ * It makes an instance of the Item struct for an item in the file and stores a 
+ * pointer to that Item in the resizable item array in group. Big files are
+ * parsed in chunks on several threads, then added in file order.
+ * 
+ * Prints a message to stderr and fails if criteria for file are not met:
+ *     - name longer than 30
+ *     - ID or cost missing or not a non-negative number
+ *     - missing a field
+ *     - two IDs are the same
+ * 
+ * @param filename is the name of the group file passed to the function
+ * @param group is the pointer to the group that the file will read the item into
+ * @return false if the file can't be opened or is invalid
+ */
+bool readItems( char const *filename, Group *group );
+
+/** 
+ * This function reads all the members from a member file with the given name.
+ * 
+ * Makes an instance of the Member struct for a member in the file and stores a 
+ * pointer to that Member in the resizable member array in group. Big files are
+ * parsed in chunks on several threads, then added in file order, with the
+ * IDs and then the names interned in one batch each.
+ * 
+ * If the group's lazy field is set, the lines are only checked and indexed
+ * by ID, and nothing is interned or made yet: each member's place in the
+ * array is left NULL and the file is kept, so the member can be made from
+ * its line when it's first needed. The group must have no members yet.
+ * 
+ * Prints a message to stderr and fails if:
+ *     - name longer than 30
+ *     - ID longer than 8
+ *     - missing a field
+ *     - two IDs are the same
+ * 
+ * @param filename string for the member file name
+ * @param group pointer to group this will populate
+ * @return false if the file can't be opened or is invalid
+ */
+bool readMembers( char const *filename, Group *group );
+
+/**
+ * Parses one line of an item file: an ID, a cost and a name.
+ *
+ * @param line the line to parse
+ * @return a new Item, or NULL if the line is invalid
+ */
+void *parseItemLine( char *line );
+
+/**
+ * Checks one line of a member file, an ID and a name, and rewrites it in
+ * place as the ID and then the name, each ended by a nul. Members are made
+ * from these once the IDs and names are interned, so no record is
+ * allocated here.
+ *
+ * @param line the line to parse
+ * @return the start of the rewritten line, or NULL if the line is invalid
+ */
+void *parseMemberLine( char *line );
+
+/**
+ * Makes a member that hasn't sold anything yet.
+ *
+ * @param id handle of its ID, which is also its index
+ * @param name handle of its name
+ * @return the new Member
+ */
+Member *makeMember( StrHandle id, StrHandle name );
+
+/**
+ * Finds the position of the item with the given ID in the group.
+ *
+ * @param group the group to search
+ * @param id item ID to look for
+ * @return index into iList, or -1 if there is no such item
+ */
+int findItem( Group *group, int id );
+
+/**
+ * Returns the text of a member's ID.
+ *
+ * @param group the group the member belongs to
+ * @param member the member
+ * @return the member's ID
+ */
+char const *memberId( Group const *group, Member const *member );
+
+/**
+ * Returns the text of a member's name.
+ *
+ * @param group the group the member belongs to
+ * @param member the member
+ * @return the member's name
+ */
+char const *memberName( Group const *group, Member const *member );
+
+/**
+ * Finds the position of the member with the given ID in the live group.
+ * Every ID in the pool is a member's, and its handle is the member's
+ * index, so the ID is only hashed once. A lazily loaded member that
+ * hasn't been made yet is found in the lazy index instead. Not for sorted
+ * read views.
+ *
+ * @param group the live group to search
+ * @param id member ID to look for
+ * @return index into mList, or -1 if there is no such member
+ */
+int findMember( Group *group, char const *id );
+
+/**
+ * Records a sale of numSold of the given item by the given member.
+ *
+ * Updates the item's and member's counts and the group totals in place and
+ * marks both records as changed, so the next published snapshot picks them up.
+ * The sale is also added to the group's history, if it keeps one, and
+ * counted towards the next copy published to shared memory, if there is one.
+ *
+ * Sales are recorded on the group's shared side, so sales from many threads
+ * run at once: the counts are bumped with atomic adds, and no lock is
+ * shared by every sale. The member's record lock is held while its sale
+ * list changes, and the lock of one of the item's seller shards, picked by
+ * the member's index, while the member is moved up the item's sellers. The
+ * sale is added to the recent sales and item leaderboards of the calling
+ * thread's own shard, under that shard's lock, so threads selling at once
+ * rarely wait. A group that keeps a top sellers sketch also takes the
+ * sketch's lock, just long enough to add the sale to it. A group that
+ * keeps a history adds the sale to the calling thread's own stage of it,
+ * and only takes the history's lock to hand over a full stage, every
+ * HISTORY_STAGE_ROWS sales.
+ *
+ * @param group the live group the sale is recorded in
+ * @param memberId ID of the member who made the sale
+ * @param itemId ID of the item that was sold
+ * @param numSold how many were sold
+ * @return false if the member or item doesn't exist or numSold isn't positive
+ */
+bool recordSale( Group *group, char const *memberId, int itemId, int numSold );
+
+/** 
+ * This function sorts the items in the given group based on input from user.
+ * 
+ * Used in conjunction with qsort(). Only call this on a read view from
+ * openView(), since the live group's lists are indexed by snapshots.
+ * 
+ * @param group the group with the items that will be sorted
+ * @param compare the function that will handle the sorting
+ */
+void sortItems( Group *group, int (* compare) (void const *va, void const *vb ));
+
+/** 
+ * This function sorts the members in the given group based on input from user.
+ * 
+ * Used in conjunction with qsort(). Only call this on a read view from
+ * openView(), since the live group's lists are indexed by snapshots.
+ * While it runs, compare can get the group from sortingGroup() to read
+ * member IDs and names.
+ * 
+ * @param group the group with the items that will be sorted
+ * @param compare the function that will handle the sorting
+ */
+void sortMembers( Group *group, int (* compare) (void const *va, void const *vb ));
+
+/**
+ * Returns the group sortMembers() is sorting on this thread.
+ *
+ * @return the group being sorted, or NULL outside of sortMembers()
+ */
+Group const *sortingGroup();
+
+/** 
+ * This function prints all or some of the items based on test and str from user input. 
+ * 
+ * The matching items are put in order by compare and only the rows on the
+ * page are printed. When the page is only part of the report, the items
+ * before it are never sorted among themselves, only separated from it.
+ * The TOTAL row is for every matching item; with no test it's the group's
+ * own totals, so nothing has to be added up.
+ * 
+ * Only call this on a read view from openView(), since its list is reordered.
+ * 
+ * @param group from which the items will be printed
+ * @param test function to handle determining if an item should be printed or not, or NULL for every item
+ * @param str basis upon which items are or are not printed
+ * @param compare the order the items are printed in, for qsort()
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listItems( Group *group, bool (*test)( Item const *item, char const *str ), char const *str,
+                int (* compare) (void const *va, void const *vb ), Page page, FILE *out );
+
+/** 
+ * This function prints all or some of the members based on test and str from user input. 
+ * 
+ * Works like listItems(). While the members are sorted, compare can get
+ * the group from sortingGroup() to read member IDs and names.
+ * 
+ * @param group from which the members will be printed
+ * @param test function to handle determining if an item should be printed or not, or NULL for every member
+ * @param str basis upon which members are or are not printed
+ * @param compare the order the members are printed in, for qsort()
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listMembers( Group *group, bool (*test)( Group const *group, Member const *member, char const *str ),
+                  char const *str, int (* compare) (void const *va, void const *vb ), Page page, FILE *out );
+
+/**
+ * This function prints every item the given member has sold, in order of
+ * item ID, with the member's own count for each item. The TOTAL row is for
+ * every item the member has sold, not just the ones on the page.
+ *
+ * @param member whose sales are printed
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listSaleItems( Member const *member, Page page, FILE *out );
+
+/**
+ * Moves an item to its place in the revenue rankings of every shard for
+ * its cost now. Must be called with the write lock held, whenever a
+ * reload changes an item's cost.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ */
+void rescoreItem( Group *group, int idx );
+
+/**
+ * Prints the items that have brought in the most, or sold the most units,
+ * best first. Every sale moves its item up the rankings of the shard it
+ * was recorded in, so the leaders are merged from the fronts of the
+ * shards' rankings: each shard is locked in turn just long enough to copy
+ * its first rows, reading deeper only until no item further down any of
+ * them could make the page. Only a page that reaches items with nothing
+ * sold looks at every item. The TOTAL row is for the whole group.
+ *
+ * @param group the live group
+ * @param byUnits true to rank by units sold rather than by revenue
+ * @param count most rows to print
+ * @param page which of the ranked rows to start from, and any further limit
+ * @param out stream the report is written to
+ */
+void listTopItems( Group *group, bool byUnits, int count, Page page, FILE *out );
+
+/**
+ * Prints the members who have sold the most of one item, best first, read
+ * off the item's seller ranking. The TOTAL row is for the item.
+ *
+ * @param group the live group
+ * @param itemId ID of the item
+ * @param count most rows to print
+ * @param page which of the ranked rows to start from, and any further limit
+ * @param out stream the report is written to
+ * @return false if there is no such item
+ */
+bool listTopSellers( Group *group, int itemId, int count, Page page, FILE *out );
+
+/**
+ * Prints the top sellers as estimated by the group's sketch, best first.
+ * Each row shows the most the member can have sold, in sales, and by how
+ * much that can be over, so the true figure is between the two. The TOTAL
+ * row is every sale the sketch has seen.
+ *
+ * @param group the live group, which must keep a sketch
+ * @param count most rows to print
+ * @param page which of the estimated rows to start from, and any further limit
+ * @param out stream the report is written to
+ */
+void listApproxSellers( Group *group, int count, Page page, FILE *out );
+
+/**
+ * Prints how well the group's sketch finds the top sellers, checked
+ * against every member's exact sales: how many of its top count are in
+ * the exact top count, how many it can vouch for, and how far its
+ * estimates are off. The sketch values a sale at the cost when it was
+ * made, so after a reload changes costs the two drift apart.
+ *
+ * @param group the live group, which must keep a sketch
+ * @param count how many top sellers to check
+ * @param out stream the report is written to
+ */
+void printSketchAccuracy( Group *group, int count, FILE *out );
+
+#endif
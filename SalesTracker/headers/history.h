@@ -0,0 +1,206 @@
+/**
+ * @file history.h
+ * @author Luke Early
+ * Header file with function prototypes for history.c.
+ *
+ * The history is an append-only file with every sale ever recorded: when
+ * it happened, who made it, the item ID and how many were sold. Sales are
+ * collected in memory and written out in blocks by a thread of the
+ * history's own, once HISTORY_BLOCK_ROWS have been collected or the
+ * oldest has waited flushMs milliseconds, so a sale never waits on the
+ * disk and a crash loses at most the sales of the last flushMs and any
+ * block being written. Each thread adding sales collects them in a stage
+ * of its own, under a lock only the writer shares, and hands them to the
+ * block being collected HISTORY_STAGE_ROWS at a time, so threads selling
+ * at once rarely wait for each other. Rows from different threads can be
+ * stored out of time order. Each block stores its four columns one after the
+ * other, as varints, with the time and member columns delta encoded, and
+ * starts with a header giving the smallest and largest value of each
+ * column. Scans use the headers to skip blocks that can't hold a match.
+ *
+ * Members are stored as codes numbering their IDs in the order the file
+ * first saw them. The block that first uses a code also holds its ID, so
+ * the file can be read back whatever order the member file is in. Headers
+ * are written in the machine's own byte order, so a history file is only
+ * read back on the kind of machine that wrote it.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "intern.h"
+
+/** Most sales in one block */
+#define HISTORY_BLOCK_ROWS 4096
+
+/** Most sales a thread collects before handing them to the block being collected */
+#define HISTORY_STAGE_ROWS 256
+
+/** Default milliseconds a sale can wait before its block is written */
+#define HISTORY_FLUSH_MS 1000
+
+/** Marks the start of every block in the file */
+#define HISTORY_MAGIC 0x43485453u
+
+/** Block summaries per page of the block index, as a power of two */
+#define HISTORY_PAGE_SHIFT 10
+#define HISTORY_PAGE_SIZE ( 1 << HISTORY_PAGE_SHIFT )
+#define HISTORY_MAX_PAGES 65536
+
+/** Columns of a block, in the order they're stored */
+#define COLUMN_TIME 0
+#define COLUMN_MEMBER 1
+#define COLUMN_ITEM 2
+#define COLUMN_QTY 3
+#define COLUMN_COUNT 4
+
+/**
+ * Header written before the columns of each block.
+ */
+struct BlockHeaderStruct {
+  unsigned int magic;
+  unsigned int rows;
+  unsigned int firstId;               // code of the first member ID stored in the block
+  unsigned int newIds;                // member IDs stored in the block, before its columns
+  unsigned int idBytes;               // their encoded size
+  unsigned int bytes[ COLUMN_COUNT ]; // encoded size of each column
+  long long minTime;
+  long long maxTime;
+  unsigned int minMember;
+  unsigned int maxMember;
+  int minItem;
+  int maxItem;
+};
+typedef struct BlockHeaderStruct BlockHeader;
+
+/**
+ * Where a block is in the file, and its header.
+ */
+struct BlockInfoStruct {
+  long offset; // of the header
+  BlockHeader header;
+};
+typedef struct BlockInfoStruct BlockInfo;
+
+/**
+ * Sales collected for one block.
+ */
+struct HistoryRowsStruct {
+  int count;
+  long long times[ HISTORY_BLOCK_ROWS ];
+  unsigned int members[ HISTORY_BLOCK_ROWS ]; // member codes
+  int items[ HISTORY_BLOCK_ROWS ];
+  int qtys[ HISTORY_BLOCK_ROWS ];
+};
+typedef struct HistoryRowsStruct HistoryRows;
+
+/**
+ * Sales collected by one thread, not handed to the writer yet.
+ */
+struct HistoryStageStruct {
+  pthread_mutex_t lock;  // held by its thread while adding a sale, and while rows are taken from it
+  pthread_t owner;       // the thread adding to it
+  int count;
+  long long times[ HISTORY_STAGE_ROWS ];
+  unsigned int members[ HISTORY_STAGE_ROWS ];
+  int items[ HISTORY_STAGE_ROWS ];
+  int qtys[ HISTORY_STAGE_ROWS ];
+  struct HistoryStageStruct *next;
+};
+typedef struct HistoryStageStruct HistoryStage;
+
+struct HistoryStruct {
+  pthread_mutex_t lock;  // held while rows are handed to the writer, taken before any stage's lock
+  pthread_cond_t wake;   // wakes an idle writer for a first sale, or for a full block
+  pthread_cond_t room;   // wakes sales waiting for the writer to take a full block
+  int fd;
+  long end;              // where the next block goes, only used by the writer
+  StrPool *ids;          // member IDs, handles are their codes in the file
+  unsigned int writtenIds; // codes whose IDs are in the file, only used by the writer
+  int flushMs;
+  BlockInfo *pages[ HISTORY_MAX_PAGES ];
+  int blockCount;        // published with a release store once a block is written
+  HistoryRows buffers[ 2 ];
+  HistoryRows *open;     // the buffer sales are added to
+  HistoryRows *writing;  // the buffer being written, or NULL
+  HistoryStage *stages;  // one per thread that has added a sale
+  bool idle;             // the writer is waiting for a first sale
+  unsigned long serial;  // tells this history from any opened before it
+  bool stopping;
+  pthread_t thread;
+};
+typedef struct HistoryStruct History;
+
+/**
+ * What a history scan found.
+ */
+struct HistoryTotalsStruct {
+  long sales;   // matching sale events
+  long sold;    // total quantity of them
+  int blocks;   // blocks in the history
+  int scanned;  // blocks that had to be decoded
+};
+typedef struct HistoryTotalsStruct HistoryTotals;
+
+/**
+ * Opens the history file with the given name, creating it if it doesn't
+ * exist, and starts the thread that writes its blocks. The headers and
+ * member IDs of the blocks already in it are read into memory; a block
+ * left half written by a crash is cut off.
+ *
+ * @param filename name of the history file
+ * @param flushMs most milliseconds a sale waits before its block is written
+ * @return the history, or NULL if the file can't be opened or isn't a history file
+ */
+History *openHistory( char const *filename, int flushMs );
+
+/**
+ * Stops the writer once it has written out every sale not in a block yet,
+ * closes the file and frees the history.
+ *
+ * @param history the history to close
+ */
+void closeHistory( History *history );
+
+/**
+ * Adds one sale to the calling thread's stage of the history. Only when
+ * the stage is full is the history's lock taken, to hand its rows to the
+ * block being collected, and only then does it wait if sales have filled
+ * a block while the writer is still writing the one before. An idle
+ * writer is woken for the first sale.
+ *
+ * @param history the history
+ * @param time when the sale happened, in seconds since the epoch
+ * @param member ID of the member who made it
+ * @param item ID of the item sold
+ * @param qty how many were sold
+ */
+void addHistory( History *history, long long time, char const *member, int item, int qty );
+
+/**
+ * Finds the code a member's sales are stored under.
+ *
+ * @param history the history
+ * @param member ID of the member
+ * @return the member's code, or NO_HANDLE if the history has no sales by them
+ */
+StrHandle historyMember( History *history, char const *member );
+
+/**
+ * Totals up the sales of one item, or by one member, in a range of times.
+ *
+ * @param history the history
+ * @param column COLUMN_ITEM or COLUMN_MEMBER
+ * @param value the item ID or member code to look for
+ * @param from earliest time to include
+ * @param to latest time to include
+ * @param totals set to what was found
+ */
+void scanHistory( History *history, int column, long long value, long long from, long long to,
+                  HistoryTotals *totals );
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @file intern.h
+ * @author Luke Early
+ * Header file with function prototypes for intern.c.
+ *
+ * A StrPool stores each distinct string once and hands out dense 32-bit
+ * handles for them, starting at 0 in the order strings are first added.
+ * Strings and handles never move once added, so looking a string up or
+ * reading one back needs no lock, even while another thread adds more.
+ *
+ * Handles can also be set aside ahead of their strings, with
+ * reserveStrings(), and given their strings later with placeStrings().
+ * Until then a reserved handle's string can't be found or read back.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+/** Handle for a string in a StrPool */
+typedef unsigned int StrHandle;
+
+/** Returned by findString() when the string isn't in the pool */
+#define NO_HANDLE 0xffffffffu
+
+/** Characters per storage block, as a power of two */
+#define POOL_BLOCK_SHIFT 20
+#define POOL_BLOCK_SIZE ( 1 << POOL_BLOCK_SHIFT )
+#define POOL_MAX_BLOCKS 4096
+
+/** Handles per page of string offsets, as a power of two */
+#define POOL_PAGE_SHIFT 12
+#define POOL_PAGE_SIZE ( 1 << POOL_PAGE_SHIFT )
+#define POOL_MAX_PAGES 65536
+
+/** Most hash tables a pool can outgrow in its life */
+#define POOL_MAX_TABLES 32
+
+/**
+ * Open addressing hash table of handles. Each slot holds handle + 1, or 0
+ * if it's empty.
+ */
+struct StrTableStruct {
+  unsigned int size;
+  unsigned int slots[];
+};
+typedef struct StrTableStruct StrTable;
+
+struct StrPoolStruct {
+  pthread_mutex_t lock;             // held while adding strings
+  char *blocks[ POOL_MAX_BLOCKS ];
+  int blockCount;
+  int blockUsed;                    // characters used in the last block
+  unsigned int *pages[ POOL_MAX_PAGES ]; // handle -> block << POOL_BLOCK_SHIFT | position
+  unsigned int count;                // handles handed out, reserved or not
+  unsigned int stored;               // strings in the table
+  StrTable *table;
+  StrTable *oldTables[ POOL_MAX_TABLES ]; // kept for readers still using them
+  int oldTableCount;
+};
+typedef struct StrPoolStruct StrPool;
+
+/**
+ * Makes a new, empty string pool.
+ *
+ * @return pointer to the new pool
+ */
+StrPool *makePool();
+
+/**
+ * Frees a string pool and every string in it.
+ *
+ * @param pool the pool to free
+ */
+void freePool( StrPool *pool );
+
+/**
+ * Adds a string to the pool if it isn't already there.
+ *
+ * @param pool the pool to add to
+ * @param str the string
+ * @return the string's handle
+ */
+StrHandle internString( StrPool *pool, char const *str );
+
+/**
+ * Adds many strings to the pool at once, as if each were passed to
+ * internString() in turn, but quicker for a big batch.
+ *
+ * @param pool the pool to add to
+ * @param strs the strings
+ * @param count how many there are
+ * @param handles set to the handle of each string
+ */
+void internStrings( StrPool *pool, char const *const *strs, int count, StrHandle *handles );
+
+/**
+ * Sets aside the next count handles for strings that are added later with
+ * placeStrings(). Strings added in the meantime get the handles after them.
+ *
+ * @param pool the pool to reserve handles in
+ * @param count how many handles to reserve
+ * @return the first reserved handle; the rest follow it
+ */
+StrHandle reserveStrings( StrPool *pool, int count );
+
+/**
+ * Gives reserved handles their strings. A handle that already has its
+ * string is left as it is. None of the strings may be in the pool under
+ * another handle.
+ *
+ * @param pool the pool the handles were reserved in
+ * @param handles the reserved handles
+ * @param strs the string for each handle
+ * @param count how many there are
+ */
+void placeStrings( StrPool *pool, StrHandle const *handles, char const *const *strs, int count );
+
+/**
+ * Looks up a string without adding it.
+ *
+ * @param pool the pool to search
+ * @param str the string
+ * @return the string's handle, or NO_HANDLE if it isn't in the pool
+ */
+StrHandle findString( StrPool *pool, char const *str );
+
+/**
+ * Returns the text of the string with the given handle.
+ *
+ * @param pool the pool the handle came from
+ * @param handle the handle
+ * @return the string, which stays valid until the pool is freed
+ */
+char const *poolString( StrPool const *pool, StrHandle handle );
+
+#endif
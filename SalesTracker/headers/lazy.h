@@ -0,0 +1,124 @@
+/**
+ * @file lazy.h
+ * @author Luke Early
+ * Header file with function prototypes for lazy.c.
+ *
+ * A group can load its member file lazily. The file is still read and
+ * checked line by line, so a bad or duplicate line still fails the load,
+ * but each line is only cut into its ID and name in place: nothing is
+ * copied or interned and no Member record is made. The group keeps the
+ * file as loaded with a hash index from each ID to its line, sets aside
+ * each member's ID handle in the pool, and leaves its place in mList
+ * empty. A member is made from its line the first time something needs
+ * it, such as a sale or a report on that member, which is when its ID
+ * and name are interned, and reports on every member make all the rest
+ * at once.
+ *
+ * Members that haven't been made have sold nothing, so leaving them out of
+ * snapshots changes no totals; they go into the next snapshot once made.
+ */
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "group.h"
+
+/**
+ * Slot of the hash index of a lazily loaded member file's IDs. The hash
+ * is kept with the index, so a probe only reads the lines of IDs whose
+ * hashes match.
+ */
+struct LazySlotStruct {
+  unsigned int hash;
+  int member; // index of the member + 1, or 0 for an empty slot
+};
+typedef struct LazySlotStruct LazySlot;
+
+struct LazyStruct {
+  char *buffer;         // the member file as loaded, with a nul after each ID and name
+  char **lines;         // each member's ID in buffer, by index; its name follows the ID
+  LazySlot *index;      // hash index of the IDs
+  int indexSize;        // slots in index, a power of two
+  int count;            // members loaded from the file, made or not
+  int made;             // how many of them have been made
+  pthread_mutex_t lock; // held while members are made
+};
+typedef struct LazyStruct Lazy;
+
+/**
+ * Makes the state for loading a member file lazily. Set it as the group's
+ * lazy field before calling readMembers().
+ *
+ * @return the new state, with no members
+ */
+Lazy *makeLazy();
+
+/**
+ * Frees the lazy loading state and the file it kept. Members made from it
+ * belong to the group.
+ *
+ * @param lazy the state to free, or NULL
+ */
+void freeLazy( Lazy *lazy );
+
+/**
+ * Builds the index of a lazily loaded member file's IDs. Each line has
+ * been cut into its ID and name, and the member on lines[ i ] gets index
+ * i. Only for a group with no members yet.
+ *
+ * @param group the live group, with its lazy field set
+ * @param lines each member's ID, in file order; kept by the lazy state if
+ *              the index is built
+ * @param count how many members there are
+ * @return false if two lines have the same ID
+ */
+bool indexMembers( Group *group, char **lines, int count );
+
+/**
+ * Finds a member of a lazily loaded member file by its ID, whether it's
+ * been made or not. Needs no lock, since the index doesn't change once
+ * it's built.
+ *
+ * @param lazy the lazy loading state
+ * @param id the member's ID
+ * @return index of the member in mList, or -1 if the file didn't list it
+ */
+int findLazyMember( Lazy const *lazy, char const *id );
+
+/**
+ * Returns the live member at the given index, making it from its line of
+ * the member file first if it hasn't been made yet. Works on any live
+ * group, lazily loaded or not. Must be called on the shared side or with
+ * the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ * @return the member
+ */
+Member *loadMember( Group *group, int idx );
+
+/**
+ * Makes every member of a lazily loaded group that hasn't been made yet,
+ * interning their IDs and names in one go, so the next snapshot holds
+ * every member. Does nothing if they've all been made. Must be called off
+ * the shared side, like openView().
+ *
+ * @param group the live group
+ */
+void loadAllMembers( Group *group );
+
+/**
+ * Returns the name of the live member at the given index, read from its
+ * line of the member file if it hasn't been made yet, so it can be checked
+ * without making it.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ * @return the member's name
+ */
+char const *liveMemberName( Group *group, int idx );
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file loader.h
+ * @author Luke Early
+ * Header file with function prototypes for loader.c.
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Files smaller than this per thread are parsed on fewer threads, by default */
+#define MIN_CHUNK_BYTES ( 1 << 20 )
+
+/** Most threads a single file is parsed on */
+#define MAX_LOAD_THREADS 64
+
+/**
+ * Parses one line of a file into a newly allocated record.
+ *
+ * @param line the line, nul terminated, without its newline
+ * @return the record, or NULL if the line isn't valid
+ */
+typedef void *(*LineParser)( char *line );
+
+/**
+ * How much of a file was loaded and a hash of it, so a later load can tell
+ * whether the file has only had lines added to the end since.
+ */
+struct FileMarkStruct {
+  size_t length;
+  unsigned long long hash;
+};
+typedef struct FileMarkStruct FileMark;
+
+/**
+ * The records parsed from one run of whole lines of a file.
+ */
+struct ChunkStruct {
+  char *start;
+  char *end;
+  LineParser parse;
+  void **records;
+  int count;
+  int cap;
+  bool invalid; // some line in the chunk didn't parse
+};
+typedef struct ChunkStruct Chunk;
+
+/**
+ * A whole file split into chunks, in file order.
+ */
+struct LoadStruct {
+  char *buffer;
+  bool appended; // only the lines added after the old mark were parsed
+  int chunkCount;
+  Chunk chunks[ MAX_LOAD_THREADS ];
+};
+typedef struct LoadStruct Load;
+
+/**
+ * Changes how files are split for loading, so a small file can be split
+ * the way a big one is. Meant for tests; must be called before any file
+ * is loaded, not during a load.
+ *
+ * @param threads most threads a file is parsed on, up to MAX_LOAD_THREADS,
+ *                or 0 for one per core
+ * @param minChunkBytes files smaller than this per thread are parsed on
+ *                      fewer threads
+ */
+void setLoadSplit( int threads, size_t minChunkBytes );
+
+/**
+ * Reads the whole named file, splits it on line boundaries into one chunk
+ * per thread, and parses every chunk in parallel with the given parser.
+ *
+ * Each chunk keeps its records in the order they appear in the file, so
+ * reading the chunks in order gives every record in file order.
+ *
+ * If the file still starts with the whole lines mark describes, only the
+ * lines after them are parsed and the load is marked appended. Either way,
+ * mark is updated to describe the file as it is now.
+ *
+ * @param filename name of the file to load
+ * @param parse turns one line into a record
+ * @param mark what was loaded last time, all zero for a first load
+ * @return the parsed chunks, or NULL if the file can't be opened
+ */
+Load *loadFile( char const *filename, LineParser parse, FileMark *mark );
+
+/**
+ * Tells whether any line of the loaded file failed to parse.
+ *
+ * @param load the loaded file
+ * @return true if some chunk had an invalid line
+ */
+bool loadInvalid( Load const *load );
+
+/**
+ * Returns the total number of records parsed from the file.
+ *
+ * @param load the loaded file
+ * @return the record count
+ */
+int loadCount( Load const *load );
+
+/**
+ * Frees the file buffer and the chunk record arrays. The records
+ * themselves belong to whoever took them out of the chunks.
+ *
+ * @param load the loaded file
+ */
+void freeLoad( Load *load );
+
+#endif
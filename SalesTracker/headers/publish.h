@@ -0,0 +1,240 @@
+/**
+ * @file publish.h
+ * @author Luke Early
+ * Header file with function prototypes for publish.c.
+ *
+ * A group can publish copies of its snapshots into a POSIX shared-memory
+ * segment, so other processes can read the items, the member totals and
+ * what each member sold without going through the command language. A
+ * background thread copies the newest snapshot in after a number of sales
+ * or a number of milliseconds, whichever comes first, so sales never wait
+ * for it.
+ *
+ * The segment holds two buffers. Each copy goes into the one readers
+ * aren't being sent to, then readers are sent to it. Each buffer has a
+ * sequence number that is odd while it's being written, so a reader reads
+ * in place and then checks that the number didn't change; only a reader
+ * that takes longer than two copies has to start again. If the group
+ * outgrows the segment, a bigger one is filled under another name and
+ * renamed over it, and the old one is marked moved, so readers know to map
+ * it again.
+ *
+ * Records are written in the machine's own byte order, so a segment is
+ * only read on the machine that wrote it.
+ */
+
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "group.h"
+
+/** Marks the start of every segment */
+#define PUBLISH_MAGIC 0x50425453u
+
+/** Bumped whenever the layout of a segment changes */
+#define PUBLISH_LAYOUT 1
+
+/** Sales between copies, unless the command line says otherwise */
+#define PUBLISH_SALES 1000
+
+/** Milliseconds between copies, unless the command line says otherwise */
+#define PUBLISH_MS 1000
+
+/** Longest segment name, including the leading slash */
+#define PUBLISH_NAME_MAX 255
+
+/** Permissions of a segment; only the publishing user can read it */
+#define PUBLISH_MODE 0600
+
+/**
+ * One item, as published.
+ */
+struct PubItemStruct {
+  int id;
+  int cost;
+  int sold;
+  char name[ NAME_MAX + 1 ];
+};
+typedef struct PubItemStruct PubItem;
+
+/**
+ * One member's totals, as published. Its sales are count entries of the
+ * buffer's sales, starting at first.
+ */
+struct PubMemberStruct {
+  char id[ ID_MAX + 1 ];
+  char name[ NAME_MAX + 1 ];
+  int sold;
+  int sales;
+  int first;
+  int count;
+};
+typedef struct PubMemberStruct PubMember;
+
+/**
+ * How many of one item a member sold, as published.
+ */
+struct PubSaleStruct {
+  int itemId;
+  int sold;
+};
+typedef struct PubSaleStruct PubSale;
+
+/**
+ * One of the two copies of the group in a segment. Its items, members and
+ * sales follow it, at the offsets given in the segment's header.
+ */
+struct PubBufferStruct {
+  unsigned long seq; // odd while the buffer is being written
+  long epoch;        // of the snapshot it was copied from
+  long long time;    // when it was copied, in seconds since the epoch
+  int iCount;
+  int mCount;
+  int saleCount;
+  int totalSold;
+  int totalSales;
+};
+typedef struct PubBufferStruct PubBuffer;
+
+/**
+ * Start of a segment. Everything after it is the two buffers.
+ */
+struct PubHeaderStruct {
+  unsigned int magic;
+  unsigned int layout;
+  int itemCap;       // room in each buffer
+  int memberCap;
+  int saleCap;
+  long itemOffset;   // of the items, from the start of a buffer
+  long memberOffset;
+  long saleOffset;
+  long bufferBytes;  // size of each buffer
+  int current;       // buffer readers should read, 0 or 1
+  int moved;         // set once a bigger segment has replaced this one
+};
+typedef struct PubHeaderStruct PubHeader;
+
+struct PublisherStruct {
+  Group *group;
+  char name[ PUBLISH_NAME_MAX + 1 ];
+  int everySales;          // sales between copies
+  int everyMs;             // milliseconds between copies
+  PubHeader *header;       // the mapped segment
+  long bytes;              // its size
+  long epoch;              // of the snapshot last copied, 0 before the first
+  bool failing;            // the last copy couldn't be made, only used by the thread
+  pthread_mutex_t lock;    // guards the fields below, which wake the thread
+  pthread_cond_t wake;
+  int pending;             // sales since the last copy
+  bool stopping;
+  pthread_t thread;
+};
+typedef struct PublisherStruct Publisher;
+
+/**
+ * A segment mapped read-only by a reader.
+ */
+struct PubMapStruct {
+  char name[ PUBLISH_NAME_MAX + 1 ];
+  PubHeader const *header;
+  long bytes;
+};
+typedef struct PubMapStruct PubMap;
+
+/**
+ * Makes the shared-memory segment with the given name, copies the group's
+ * newest snapshot into it, and starts the thread that keeps it up to date.
+ *
+ * @param group the live group
+ * @param name name of the segment, with or without its leading slash
+ * @param everySales copy after this many sales
+ * @param everyMs copy after this many milliseconds, if anything changed
+ * @return the publisher, or NULL if the segment can't be made
+ */
+Publisher *openPublisher( Group *group, char const *name, int everySales, int everyMs );
+
+/**
+ * Stops the publisher's thread, copies the group in one last time and
+ * removes the segment's name. Readers that have it mapped can still read
+ * the last copy.
+ *
+ * @param publisher the publisher to close
+ */
+void closePublisher( Publisher *publisher );
+
+/**
+ * Counts a sale towards the next copy, waking the publisher's thread once
+ * enough have been made.
+ *
+ * @param publisher the publisher
+ */
+void notePublishSale( Publisher *publisher );
+
+/**
+ * Maps the segment with the given name read-only.
+ *
+ * @param name name of the segment, with or without its leading slash
+ * @return the mapping, or NULL if there's no such segment or it isn't one
+ *         a group published
+ */
+PubMap *openPubMap( char const *name );
+
+/**
+ * Unmaps a segment mapped with openPubMap().
+ *
+ * @param map the mapping
+ */
+void closePubMap( PubMap *map );
+
+/**
+ * Starts reading the newest copy in a segment, mapping it again first if
+ * it has moved. The buffer's records can be read in place until
+ * endPubRead() says whether they were all from one copy.
+ *
+ * @param map the mapping
+ * @param seq set to the buffer's sequence number, to pass to endPubRead()
+ * @return the buffer to read, or NULL if the segment has gone
+ */
+PubBuffer const *beginPubRead( PubMap *map, unsigned long *seq );
+
+/**
+ * Finishes reading a buffer started with beginPubRead().
+ *
+ * @param buffer the buffer
+ * @param seq the sequence number beginPubRead() gave
+ * @return false if the buffer was written while it was read, so the read
+ *         has to start again
+ */
+bool endPubRead( PubBuffer const *buffer, unsigned long seq );
+
+/**
+ * Returns the items of a buffer.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its items
+ */
+PubItem const *pubItems( PubMap const *map, PubBuffer const *buffer );
+
+/**
+ * Returns the members of a buffer, in the order they were loaded.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its members
+ */
+PubMember const *pubMembers( PubMap const *map, PubBuffer const *buffer );
+
+/**
+ * Returns the sales of a buffer, each member's after the one before's.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its sales
+ */
+PubSale const *pubSales( PubMap const *map, PubBuffer const *buffer );
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file ranking.h
+ * @author Luke Early
+ * Header file with function prototypes for ranking.c.
+ *
+ * A Ranking keeps records in order by score, largest first, as sales come
+ * in, so a leaderboard can be read off the front without sorting. It's a
+ * skip list: a sorted linked list where each node also skips ahead on a
+ * few higher levels, so a node is moved to its new place in O(log n).
+ * Each node stays with the record it ranks, so a sale finds its node
+ * without searching. A Ranking has no lock of its own; whoever owns it
+ * says which lock guards it.
+ */
+
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <stdbool.h>
+
+/** Most levels a node can be on, enough for 4^16 nodes */
+#define RANK_LEVELS 16
+
+/**
+ * One record's place in a ranking.
+ */
+struct RankNodeStruct {
+  int key;    // breaks ties in score, smallest first
+  int idx;    // index of the record it ranks
+  int sold;   // how many the record has sold
+  int score;  // what the ranking is ordered by, largest first
+  int height; // levels the node is on
+  struct RankNodeStruct *next[]; // next node on each level
+};
+typedef struct RankNodeStruct RankNode;
+
+struct RankingStruct {
+  int height;     // levels any node is on
+  RankNode *head; // holds no record, only the first node on each level
+};
+typedef struct RankingStruct Ranking;
+
+/**
+ * Makes an empty ranking.
+ *
+ * @return pointer to the new Ranking
+ */
+Ranking *makeRanking();
+
+/**
+ * Frees a ranking and every node in it.
+ *
+ * @param ranking to free, or NULL
+ */
+void freeRanking( Ranking *ranking );
+
+/**
+ * Makes a node for a record and adds it to a ranking with nothing sold.
+ * Its height comes from a hash of key, so it's the same from run to run.
+ *
+ * @param ranking the ranking
+ * @param key breaks ties between records with the same score
+ * @param idx index of the record
+ * @return the new node
+ */
+RankNode *addRanked( Ranking *ranking, int key, int idx );
+
+/**
+ * Moves a node to its place for a new score.
+ *
+ * @param ranking the ranking holding the node
+ * @param node the node
+ * @param sold how many its record has now sold
+ * @param score its new score
+ */
+void updateRanked( Ranking *ranking, RankNode *node, int sold, int score );
+
+/**
+ * Returns the node at the given rank, counting from 0, by walking the
+ * bottom level.
+ *
+ * @param ranking the ranking
+ * @param rank the rank
+ * @return the node, or NULL if the ranking is shorter than that
+ */
+RankNode *rankedAt( Ranking const *ranking, int rank );
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file reload.h
+ * @author Luke Early
+ * Header file with function prototypes for reload.c.
+ *
+ * A reload reads the item and member files the group was loaded from
+ * again on a background thread. New records are added and records whose
+ * name or cost changed are updated in place, so sales already recorded
+ * are kept. Records missing from the files are left alone. If either file
+ * is invalid nothing is changed. When a file has only had lines added to
+ * its end, just those lines are parsed.
+ */
+
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "group.h"
+
+/** Longest message describing how a reload went */
+#define RESULT_MAX 200
+
+struct ReloadStruct {
+  pthread_mutex_t apply; // held while a plan is applied, and while reloads are held off
+  pthread_mutex_t lock; // guards everything below
+  pthread_t thread;
+  bool started;         // a thread was started and hasn't been joined
+  bool running;
+  int count;            // reloads finished so far
+  char result[ RESULT_MAX + 1 ];
+};
+typedef struct ReloadStruct Reload;
+
+/**
+ * Makes the reload state for a group, with no reload running.
+ *
+ * @return pointer to the new Reload
+ */
+Reload *makeReload();
+
+/**
+ * Waits for any reload still running, then frees the reload state.
+ *
+ * @param reload to free
+ */
+void freeReload( Reload *reload );
+
+/**
+ * Starts reloading the group's item and member files on a background
+ * thread. Parsing, validation and working out what changed all happen on
+ * that thread; the changes are then applied under the group's write lock
+ * as a single new group version.
+ *
+ * @param group the live group
+ * @return false if a reload is already running
+ */
+bool startReload( Group *group );
+
+/**
+ * Holds off applying any reload until releaseReloads() is called. A reload
+ * that finishes planning in the meantime waits, so everything read while
+ * reloads are held off comes from the same records.
+ *
+ * @param group the live group
+ */
+void holdReloads( Group *group );
+
+/**
+ * Lets a reload held off by holdReloads() apply its changes.
+ *
+ * @param group the live group
+ */
+void releaseReloads( Group *group );
+
+/**
+ * Prints whether a reload is running, or how the last one went.
+ *
+ * @param group the live group
+ * @param out stream the status is written to
+ */
+void reloadStatus( Group *group, FILE *out );
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file rollup.h
+ * @author Luke Early
+ * Header file with function prototypes for rollup.c.
+ *
+ * A group keeps what was sold in each of the last few minutes, hours and
+ * days in SALE_SHARDS Rollups, each thread adding its sales to its own
+ * shard. Each level of a rollup is a ring of buckets, one per minute, hour
+ * or day, that is reused once it's older than the ring reaches back. A
+ * bucket tallies its sales by member and item, so a windowed report such
+ * as "sales in the last 3 hours" adds up the tallies in the 3 buckets of
+ * each shard, however many items and members there are, and never looks
+ * at a record that sold nothing in the window. Buckets line up with whole
+ * minutes, hours and days (UTC), so the last 3 hours means this hour so
+ * far and the 2 before it.
+ *
+ * Like the all-time reports, sales in a window are valued at the items'
+ * costs now, for items and members alike, so a reload that changes a
+ * cost changes the windows that hold its sales too.
+ */
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdbool.h>
+
+#include "group.h"
+
+/** Levels of a rollup, finest first */
+#define LEVEL_MINUTE 0
+#define LEVEL_HOUR 1
+#define LEVEL_DAY 2
+#define ROLLUP_LEVELS 3
+
+/** Buckets kept at each level */
+#define MINUTE_BUCKETS 60
+#define HOUR_BUCKETS 24
+#define DAY_BUCKETS 7
+#define ROLLUP_BUCKETS ( MINUTE_BUCKETS + HOUR_BUCKETS + DAY_BUCKETS )
+
+/**
+ * How many of one item one member sold in one bucket. When tallies are
+ * added up for a report, sales is what they're worth at the item's cost.
+ */
+struct TallyStruct {
+  int member; // index of the member, or -1 for an empty slot
+  int item;   // index of the item
+  int sold;
+  int sales;
+};
+typedef struct TallyStruct Tally;
+
+/**
+ * Tallies kept by member and item, in an open addressed hash table.
+ */
+struct TallyTableStruct {
+  Tally *slots; // NULL until the first tally
+  int cap;      // a power of two
+  int count;
+};
+typedef struct TallyTableStruct TallyTable;
+
+/**
+ * What was sold in one minute, hour or day.
+ */
+struct BucketStruct {
+  long long number; // which minute, hour or day since the epoch it holds, -1 for none yet
+  int sold;
+  TallyTable tallies;
+};
+typedef struct BucketStruct Bucket;
+
+/**
+ * One shard of a group's recent sales. A Rollup has no lock of its own;
+ * the group's shard locks guard its rollups.
+ */
+struct RollupStruct {
+  Bucket buckets[ ROLLUP_BUCKETS ]; // the minute ring, then the hour ring, then the day ring
+};
+typedef struct RollupStruct Rollup;
+
+/**
+ * The stretch of time a windowed report covers: the count most recent
+ * buckets of one level, up to and including the one holding now.
+ */
+struct WindowStruct {
+  int level;
+  int count;
+  long long now; // in seconds since the epoch
+};
+typedef struct WindowStruct Window;
+
+/**
+ * Makes an empty rollup.
+ *
+ * @return pointer to the new Rollup
+ */
+Rollup *makeRollup();
+
+/**
+ * Frees a rollup and the tallies in it.
+ *
+ * @param rollup to free, or NULL
+ */
+void freeRollup( Rollup *rollup );
+
+/**
+ * Adds a sale to the bucket holding its time at every level, clearing
+ * out a bucket that held an older minute, hour or day first.
+ *
+ * @param rollup the rollup
+ * @param time when the sale happened, in seconds since the epoch
+ * @param member index of the member who made it
+ * @param item index of the item sold
+ * @param sold how many were sold
+ */
+void addRollup( Rollup *rollup, long long time, int member, int item, int sold );
+
+/**
+ * Adds up how many were sold in a window.
+ *
+ * @param rollup the rollup
+ * @param window the window
+ * @return how many were sold in it
+ */
+int sumRollup( Rollup const *rollup, Window const *window );
+
+/**
+ * Adds every tally in a window to a table, by member and item, valuing
+ * them at the costs of the given items. Tallies of items or members past
+ * the given counts, added after the caller looked, are left out.
+ *
+ * @param rollup the rollup
+ * @param window the window
+ * @param items the items, by index
+ * @param itemCount how many items there are
+ * @param memberCount how many members to count
+ * @param table where the tallies are added
+ */
+void tallyRollup( Rollup const *rollup, Window const *window, Item *const *items, int itemCount, int memberCount,
+                  TallyTable *table );
+
+/**
+ * Adds sold and sales to the tally for a member and item in a table,
+ * making it if it isn't there.
+ *
+ * @param table the table
+ * @param member index of the member
+ * @param item index of the item
+ * @param sold how many were sold
+ * @param sales what they were worth
+ */
+void addTally( TallyTable *table, int member, int item, int sold, int sales );
+
+/**
+ * Frees the slots of a tally table, leaving it empty.
+ *
+ * @param table the table
+ */
+void clearTallies( TallyTable *table );
+
+/**
+ * Parses the window at the end of a windowed report, such as
+ * "last 3 hours". The unit may be minute, hour or day, or their plurals.
+ *
+ * @param count how many units
+ * @param unit the unit
+ * @param now when the window ends, in seconds since the epoch
+ * @param window set to the window ending at now
+ * @return false if the unit is unknown or count isn't from 1 up to the
+ *         number of buckets kept for it
+ */
+bool parseWindow( int count, char const *unit, long long now, Window *window );
+
+/**
+ * Makes a read view of the items holding only what was sold in a window,
+ * from the group's rollups. Each item in it is a copy whose count sold is
+ * its count in the window, so its sales are that count times its cost.
+ * The group totals are for the window, so the view can be listed like any
+ * other view.
+ *
+ * @param group the live group
+ * @param view a read view from openView()
+ * @param window the window
+ * @return the windowed view, with no members
+ */
+Group *openItemWindow( Group *group, Group const *view, Window const *window );
+
+/**
+ * Makes a read view of the members holding only what they sold in a
+ * window, the way openItemWindow() does for items. A member's sales in a
+ * window are what it sold of each item times the item's cost.
+ *
+ * @param group the live group
+ * @param view a read view from openView(); its members are taken from
+ *             its snapshot, so it only needs them if soldOnly is false
+ * @param window the window
+ * @param soldOnly true to leave out the members who sold nothing in the
+ *                 window, so the view is made without looking at them
+ * @return the windowed view, with no items
+ */
+Group *openMemberWindow( Group *group, Group const *view, Window const *window, bool soldOnly );
+
+/**
+ * Frees a view made by openItemWindow() or openMemberWindow().
+ *
+ * @param window the windowed view
+ */
+void closeWindowView( Group *window );
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file salestracker.h
+ * @author Luke Early
+ * Public C interface of libsalestracker, for programs that record and
+ * query sales in process instead of through the fundraiser program.
+ *
+ * Every function can be called from any number of threads at once. Sales
+ * don't take a lock for the whole group: counters are updated with atomic
+ * adds, the selling member's record lock is held while its sale list
+ * changes, and the item's seller ranking is split into shards by member,
+ * each with its own lock. The item's own record lock is only held while
+ * the sale is added to its recent totals. Groups opened here keep no
+ * sales history, so there's no history lock either; fundraiser --history
+ * collects each thread's sales apart and hands them to the history's
+ * writer a few hundred at a time. Queries read the live counts the same
+ * way, so they never wait for a snapshot to be published.
+ */
+
+#ifndef SALESTRACKER_H
+#define SALESTRACKER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/** Longest item or member name */
+#define ST_NAME_MAX 30
+
+/** Longest member ID */
+#define ST_ID_MAX 8
+
+/** A group of items and members, loaded from an item file and a member file */
+typedef struct GroupStruct StGroup;
+
+/**
+ * Totals for one item.
+ */
+struct StItemInfoStruct {
+  int id;
+  char name[ ST_NAME_MAX + 1 ];
+  int cost;
+  int sold;  // how many have been sold
+  int sales; // sold times cost
+};
+typedef struct StItemInfoStruct StItemInfo;
+
+/**
+ * Totals for one member.
+ */
+struct StMemberInfoStruct {
+  char id[ ST_ID_MAX + 1 ];
+  char name[ ST_NAME_MAX + 1 ];
+  int sold;  // how many items the member has sold
+  int sales; // what they were worth
+};
+typedef struct StMemberInfoStruct StMemberInfo;
+
+/**
+ * Loads a group from an item file and a member file. If either file can't
+ * be opened or is invalid, a message is printed to stderr.
+ *
+ * @param itemFile name of the item file
+ * @param memberFile name of the member file
+ * @return the new group, or NULL if it couldn't be loaded
+ */
+StGroup *st_open( char const *itemFile, char const *memberFile );
+
+/**
+ * Frees a group. No other thread may still be using it.
+ *
+ * @param group the group to free
+ */
+void st_close( StGroup *group );
+
+/**
+ * Records a sale of qty of the given item by the given member.
+ *
+ * @param group the group
+ * @param memberId ID of the member who made the sale
+ * @param itemId ID of the item that was sold
+ * @param qty how many were sold
+ * @return false if the member or item doesn't exist or qty isn't positive
+ */
+bool st_record_sale( StGroup *group, char const *memberId, int itemId, int qty );
+
+/**
+ * Gets the current totals for one item.
+ *
+ * @param group the group
+ * @param itemId ID of the item
+ * @param info set to the item's totals
+ * @return false if there is no such item
+ */
+bool st_query_item( StGroup *group, int itemId, StItemInfo *info );
+
+/**
+ * Gets the current totals for one member.
+ *
+ * @param group the group
+ * @param memberId ID of the member
+ * @param info set to the member's totals
+ * @return false if there is no such member
+ */
+bool st_query_member( StGroup *group, char const *memberId, StMemberInfo *info );
+
+/**
+ * Gets the current totals for the whole group.
+ *
+ * @param group the group
+ * @param sold set to how many items have been sold
+ * @param sales set to what they were worth
+ */
+void st_query_totals( StGroup *group, int *sold, int *sales );
+
+/**
+ * Runs one line of the fundraiser command language, such as
+ * "list topsellers", writing its output to out.
+ *
+ * @param group the group
+ * @param command the command line, without its trailing newline
+ * @param out stream the command's output is written to
+ * @return false if the command was quit, true otherwise
+ */
+bool st_run_command( StGroup *group, char const *command, FILE *out );
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file server.h
+ * @author Luke Early
+ * Header file with function prototypes for server.c.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "group.h"
+
+/** Size of each read from a client socket */
+#define READ_CHUNK 4096
+
+/** Longest command line a client may send before it is disconnected */
+#define LINE_MAX_LEN 4096
+
+/** Unsent output a connection may build up before its input stops being read */
+#define OUT_HIGH_WATER ( 256 * 1024 )
+
+/** Most events handled by one call to epoll_wait() */
+#define MAX_EVENTS 64
+
+/**
+ * Serves the command language to any number of clients connected to a Unix
+ * domain socket at the given path.
+ *
+ * Runs a single epoll event loop with non-blocking sockets. Each connection
+ * keeps its own input and output buffer, so a slow reader never holds up
+ * the other terminals. Every newline terminated line a client sends is run
+ * as one command against group, and its output is sent back on the same
+ * connection. A client's quit closes only that connection.
+ *
+ * Returns once the process gets SIGINT or SIGTERM, closing every connection
+ * and removing the socket file.
+ *
+ * @param group the group shared by every connection
+ * @param path file system path of the socket to listen on
+ * @return EXIT_SUCCESS on a clean shutdown, EXIT_FAILURE if the socket can't be set up
+ */
+int serveGroup( Group *group, char const *path );
+
+#endif
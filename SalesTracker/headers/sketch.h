@@ -0,0 +1,97 @@
+/**
+ * @file sketch.h
+ * @author Luke Early
+ * Header file with function prototypes for sketch.c.
+ *
+ * A Sketch estimates who the top sellers are in a fixed amount of memory,
+ * however many members there are. It's the Space-Saving algorithm: a
+ * fixed number of counters, each following one member. A sale by a member
+ * with a counter adds to it. Otherwise the smallest counter is handed over
+ * to that member, keeping its count as an error bound, so a member's true
+ * sales are between its count minus its error and its count. Any member
+ * whose sales are more than the total divided by the number of counters is
+ * sure to have one. The counters are kept in a heap, smallest first, with
+ * a hash table from member to counter, so a sale costs one probe and one
+ * sift through the heap: O(log counters), however many members there are.
+ * The stream summary Space-Saving is usually paired with, buckets of equal
+ * counts, only gets that down to constant time when every update adds one,
+ * and a sale adds what it was worth.
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+/**
+ * One counter, following one member.
+ */
+struct SketchCounterStruct {
+  int key;   // ID handle of the member it follows
+  int count; // most the member can have sold, in sales
+  int error; // most of count that may have been sold by members it followed before
+  int slot;  // where its key is in the hash table
+};
+typedef struct SketchCounterStruct SketchCounter;
+
+struct SketchStruct {
+  int capacity;          // counters it can hold
+  int used;              // counters following a member
+  long long total;       // sales ever added
+  SketchCounter *heap;   // the counters, smallest count first
+  int *slots;            // hash table of heap positions, -1 where empty
+  int slotCount;         // size of the hash table, a power of two
+};
+typedef struct SketchStruct Sketch;
+
+/**
+ * Makes an empty sketch with the given number of counters.
+ *
+ * @param capacity how many counters it keeps
+ * @return pointer to the new Sketch
+ */
+Sketch *makeSketch( int capacity );
+
+/**
+ * Frees a sketch.
+ *
+ * @param sketch to free, or NULL
+ */
+void freeSketch( Sketch *sketch );
+
+/**
+ * Adds a sale to the counter of the member who made it, taking over the
+ * smallest counter if the member doesn't have one and they're all in use.
+ * Takes time logarithmic in the sketch's capacity.
+ *
+ * @param sketch the sketch
+ * @param key ID handle of the member
+ * @param amount what the sale was worth
+ */
+void addSketch( Sketch *sketch, int key, int amount );
+
+/**
+ * Copies the counters in use, in no particular order, so they can be
+ * sorted after the lock guarding the sketch is released.
+ *
+ * @param sketch the sketch
+ * @param rows set to a new array of the counters
+ * @return how many counters were copied
+ */
+int copySketch( Sketch const *sketch, SketchCounter **rows );
+
+/**
+ * Sorts copied counters, largest count first, then smallest key.
+ *
+ * @param rows the counters
+ * @param count how many there are
+ */
+void sortCounters( SketchCounter *rows, int count );
+
+/**
+ * Tells how many bytes a sketch holds, however many members it has seen.
+ *
+ * @param sketch the sketch
+ * @return its size in bytes
+ */
+long sketchBytes( Sketch const *sketch );
+
+#endif
@@ -0,0 +1,360 @@
+/**
+ * @file snapshot.h
+ * @author Luke Early
+ * Header file with function prototypes for snapshot.c.
+ *
+ * Sales change a live Group from inside its shared side, which any number
+ * of threads can be in at once: counters are bumped with atomic adds and a
+ * member's or item's lists are guarded by one of a set of striped record
+ * locks. Everything else (reloads, publishing) takes the group's write
+ * lock, which waits for every thread on the shared side to leave. Readers
+ * never look at the live group directly, they pin an immutable Snapshot
+ * of every item and member instead. Publishing a snapshot copies only the records that have
+ * changed since the last one (and the pages of pointers holding them), so
+ * unchanged records are shared by every snapshot that contains them.
+ * Records replaced by a new snapshot are retired and freed once no reader
+ * is pinned to an epoch that can still see them.
+ *
+ * Every change also gets a new group version, and records are kept in the
+ * order they last changed, so the records changed since any version can be
+ * found without looking at the ones that didn't.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <pthread.h>
+
+#include "group.h"
+
+/** Records per page of snapshot pointers, as a power of two */
+#define PAGE_SHIFT 8
+#define PAGE_SIZE ( 1 << PAGE_SHIFT )
+#define PAGE_MASK ( PAGE_SIZE - 1 )
+
+/** Most readers that can hold a snapshot at the same time */
+#define MAX_READERS 64
+
+/** Slots counting the threads on a group's shared side, one cache line each */
+#define SHARED_SLOTS 64
+
+/** Locks shared out between a group's members, and between its items */
+#define RECORD_LOCKS 256
+
+/** Kinds of memory waiting on the retired list */
+#define RETIRED_ITEM 0
+#define RETIRED_MEMBER 1
+#define RETIRED_PAGE 2
+#define RETIRED_SNAPSHOT 3
+
+struct SnapshotStruct {
+  long epoch;
+  int iCount;
+  Item ***iPages;
+  int mCount;
+  Member ***mPages;
+  int totalSold;
+  int totalSales;
+};
+typedef struct SnapshotStruct Snapshot;
+
+/**
+ * Records of one kind in the order they last changed, least recent first,
+ * as a linked list threaded through arrays indexed like the group's list.
+ */
+struct ChangeListStruct {
+  long *stamp;  // version of each record's last change, 0 if it never changed
+  long *latest; // version of its newest change, linked in at the next publish
+  int *prev;   // record that changed just before it, or -1
+  int *next;   // record that changed just after it, or -1
+  int cap;
+  int head;    // least recently changed record, or -1
+  int tail;    // most recently changed record, or -1
+};
+typedef struct ChangeListStruct ChangeList;
+
+/**
+ * Count of threads on the shared side that got this slot, alone on its
+ * cache line so threads in different slots don't slow each other down.
+ */
+struct SharedSlotStruct {
+  int active;
+  char pad[ 64 - sizeof( int ) ];
+};
+typedef struct SharedSlotStruct SharedSlot;
+
+struct RetiredStruct {
+  void *ptr;
+  int kind;
+  long epoch; // can be freed once every reader has pinned this epoch or later
+  struct RetiredStruct *next;
+};
+typedef struct RetiredStruct Retired;
+
+struct VersionsStruct {
+  pthread_mutex_t lock;      // held by writers and while publishing
+  int exclusive;             // set while a writer waits for or holds the group
+  SharedSlot shared[ SHARED_SLOTS ];
+  pthread_mutex_t memberLocks[ RECORD_LOCKS ];
+  pthread_mutex_t sellerLocks[ RECORD_LOCKS ];
+  pthread_mutex_t shardLocks[ SALE_SHARDS ]; // guard the group's rollups
+  pthread_mutex_t sketchLock; // guards the group's sketch
+  Snapshot *current;
+  long epoch;                // epoch of current
+  long readers[ MAX_READERS ]; // epoch each reader pinned, 0 for a free slot
+  bool stale;                // records changed since current was published
+  int *dirtyItems;           // room for every item, so sales can add with an atomic add
+  int dirtyItemCount;
+  int dirtyItemCap;
+  int *dirtyMembers;
+  int dirtyMemberCount;
+  int dirtyMemberCap;
+  long version;              // bumped by every change, never goes back
+  ChangeList itemChanges;
+  ChangeList memberChanges;
+  Retired *retired;
+};
+typedef struct VersionsStruct Versions;
+
+/**
+ * Makes the version bookkeeping for a live group. Nothing is published
+ * until the first reader asks for a snapshot.
+ *
+ * @return pointer to the new Versions
+ */
+Versions *makeVersions();
+
+/**
+ * Frees the current snapshot, everything on the retired list, and the
+ * Versions itself. No reader may still be pinned.
+ *
+ * @param versions to free
+ */
+void freeVersions( Versions *versions );
+
+/**
+ * Makes room in the change bookkeeping for every record the group has
+ * space for. Must be called, with the write lock held or before the group
+ * is shared, whenever iList or mList grows.
+ *
+ * @param group the live group
+ */
+void reserveVersions( Group *group );
+
+/**
+ * Takes the group's write lock, waiting for every thread on the shared
+ * side to leave. Changes other than sales must be made while holding it.
+ *
+ * @param group the live group
+ */
+void lockGroup( Group *group );
+
+/**
+ * Releases the group's write lock.
+ *
+ * @param group the live group
+ */
+void unlockGroup( Group *group );
+
+/**
+ * Enters the group's shared side, where sales are recorded. Any number of
+ * threads can be inside at once; it only waits while a writer holds the
+ * write lock.
+ *
+ * @param group the live group
+ */
+void enterGroup( Group *group );
+
+/**
+ * Leaves the group's shared side.
+ *
+ * @param group the live group
+ */
+void leaveGroup( Group *group );
+
+/**
+ * Takes the lock guarding the sale list of the member at the given index,
+ * one of RECORD_LOCKS shared out between all the members. Only used on the
+ * shared side.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void lockMember( Group *group, int idx );
+
+/**
+ * Releases the lock taken by lockMember().
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void unlockMember( Group *group, int idx );
+
+/**
+ * Takes the lock guarding one shard of the seller ranking of the item at
+ * the given index, one of RECORD_LOCKS shared out between the shards of
+ * all the items. Members selling the same item at once only wait for each
+ * other when their shards share a lock. Taken after any member lock,
+ * never before.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param shard the shard, from 0 up to SELLER_SHARDS
+ */
+void lockSellers( Group *group, int idx, int shard );
+
+/**
+ * Releases the lock taken by lockSellers().
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param shard the shard
+ */
+void unlockSellers( Group *group, int idx, int shard );
+
+/**
+ * Tells which of the group's SALE_SHARDS shards of recent sales the
+ * calling thread adds its sales to. Threads are handed shards in turn the
+ * first time they ask, so threads selling at once rarely share one.
+ *
+ * @return the thread's shard
+ */
+int saleShard();
+
+/**
+ * Takes the lock guarding one of the group's rollups. Taken after any
+ * member or seller lock, never before.
+ *
+ * @param group the live group
+ * @param shard the shard, from 0 up to SALE_SHARDS
+ */
+void lockShard( Group *group, int shard );
+
+/**
+ * Releases the lock taken by lockShard().
+ *
+ * @param group the live group
+ * @param shard the shard
+ */
+void unlockShard( Group *group, int shard );
+
+/**
+ * Takes the lock guarding the group's top sellers sketch. Taken after any
+ * member, seller or shard lock, never before.
+ *
+ * @param group the live group
+ */
+void lockSketch( Group *group );
+
+/**
+ * Releases the lock taken by lockSketch().
+ *
+ * @param group the live group
+ */
+void unlockSketch( Group *group );
+
+/**
+ * Starts a new group version for a change about to be made. Records marked
+ * changed after this are stamped with the new version. Must be called on
+ * the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @return the new version
+ */
+long newVersion( Group *group );
+
+/**
+ * Notes that the item at the given index changed, so the next snapshot
+ * gets a fresh copy of it and it shows up as changed in the current group
+ * version. Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ */
+void markItemChanged( Group *group, int idx );
+
+/**
+ * Notes that the member at the given index changed, so the next snapshot
+ * gets a fresh copy of it and it shows up as changed in the current group
+ * version. Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void markMemberChanged( Group *group, int idx );
+
+/**
+ * Notes that the member at the given index was just made from its line of
+ * a lazily loaded member file, so the next snapshot gets a copy of it. It
+ * hasn't changed, so unlike markMemberChanged() this gives it no version.
+ * Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void markMemberLoaded( Group *group, int idx );
+
+/**
+ * Retires a live item that has been replaced in iList. Members in earlier
+ * snapshots still point at it, so it is only freed once no reader can see
+ * those snapshots. Must be called with the write lock held.
+ *
+ * @param group the live group
+ * @param item the replaced item, with its sellers already moved off it
+ */
+void retireItem( Group *group, Item *item );
+
+/**
+ * Pins the newest snapshot of the group, publishing one first if any
+ * records have changed. The snapshot stays valid until it is unpinned.
+ *
+ * @param group the live group
+ * @param slot set to the reader slot to pass to unpinSnapshot()
+ * @return the pinned snapshot
+ */
+Snapshot *pinSnapshot( Group *group, int *slot );
+
+/**
+ * Releases a snapshot pinned with pinSnapshot(), freeing any retired
+ * records nobody can see anymore.
+ *
+ * @param group the live group
+ * @param slot the reader slot the snapshot was pinned with
+ */
+void unpinSnapshot( Group *group, int slot );
+
+/**
+ * Opens a read view of the group: a Group whose lists hold the records of a
+ * pinned snapshot. The view's lists belong to the caller, so they can be
+ * sorted freely without disturbing the live group or other readers. A view
+ * for an item report leaves its member list empty; for a view with
+ * members, any members of a lazily loaded group not made yet are made
+ * first.
+ *
+ * @param group the live group
+ * @param members true if the view needs the members, not just the items
+ * @return the read view, to be released with closeView()
+ */
+Group *openView( Group *group, bool members );
+
+/**
+ * Opens a read view holding only the records changed after the given group
+ * version. The work done is proportional to the number of changed records,
+ * not to the size of the group.
+ *
+ * @param group the live group
+ * @param since only records changed after this version are included
+ * @param version set to the group version the view is up to date with
+ * @return the read view, to be released with closeView()
+ */
+Group *openChangedView( Group *group, long since, long *version );
+
+/**
+ * Releases a read view opened with openView() or openChangedView().
+ *
+ * @param group the live group the view was opened on
+ * @param view the view to release
+ */
+void closeView( Group *group, Group *view );
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file trace.h
+ * @author Luke Early
+ * Header file with function prototypes for trace.c.
+ *
+ * When tracing is on, the start and end of each command and of the phases
+ * inside it (reading the line, opening a view, lookups, sorting, filtering
+ * and rendering) are recorded as Chrome trace events, which a trace viewer
+ * such as chrome://tracing or Perfetto shows as a timeline. Each thread
+ * records into its own ring buffer without taking a lock. A ring is written
+ * out to the trace file when it fills, and every ring when tracing stops.
+ * With tracing off, recording an event is a single check of a flag.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/** Events held by each thread's ring before it's written out */
+#define TRACE_RING_SIZE 4096
+
+/** Longest piece of detail, such as the command line, kept with an event */
+#define TRACE_DETAIL_MAX 63
+
+/**
+ * One begin or end event.
+ */
+struct TraceEventStruct {
+  long long time;   // nanoseconds on the monotonic clock
+  char const *name; // a string literal
+  char phase;       // 'B' for begin, 'E' for end
+  char detail[ TRACE_DETAIL_MAX + 1 ];
+};
+typedef struct TraceEventStruct TraceEvent;
+
+/**
+ * The events one thread has recorded and not written out yet.
+ */
+struct TraceRingStruct {
+  int tid;    // thread number shown in the trace
+  long head;  // events ever recorded, only advanced by the owning thread
+  long tail;  // events ever written out, only advanced under the file lock
+  TraceEvent events[ TRACE_RING_SIZE ];
+  struct TraceRingStruct *next; // next ring of any thread
+};
+typedef struct TraceRingStruct TraceRing;
+
+/**
+ * Starts tracing to the file with the given name.
+ *
+ * @param filename name of the trace file
+ * @return false if the file can't be opened
+ */
+bool openTrace( char const *filename );
+
+/**
+ * Writes out every thread's events, finishes the trace file and closes
+ * it. No other thread may still be recording events.
+ */
+void closeTrace();
+
+/**
+ * Records the start of a command or phase on this thread.
+ *
+ * @param name what's starting; must be a string literal
+ * @param detail extra text shown with the event, such as the command line, or NULL
+ */
+void traceBegin( char const *name, char const *detail );
+
+/**
+ * Records the end of a command or phase started with traceBegin().
+ *
+ * @param name what's ending, the same name it began with
+ */
+void traceEnd( char const *name );
+
+#endif
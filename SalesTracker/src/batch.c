@@ -0,0 +1,152 @@
+/**
+ * @file batch.c
+ * @author Luke Early
+ * Source file for running batches of read-only commands on a thread pool.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "command.h"
+#include "reload.h"
+#include "trace.h"
+
+/**
+ * Takes commands from the pool's batch and runs them until none are left.
+ * Must be called holding the pool's lock, which is released while each
+ * command runs.
+ *
+ * @param pool the pool
+ */
+static void runCommands( BatchPool *pool )
+{
+  while ( pool->next < pool->count ) {
+    int idx = pool->next++;
+    pthread_mutex_unlock( &pool->lock );
+
+    FILE *buffer = open_memstream( &pool->outputs[ idx ], &pool->lengths[ idx ] );
+    runCommand( pool->group, pool->cmds[ idx ], buffer );
+    fclose( buffer );
+
+    pthread_mutex_lock( &pool->lock );
+    if ( ++pool->finished == pool->count ) {
+      pthread_cond_signal( &pool->done );
+    }
+  }
+}
+
+/**
+ * Body of each pool thread: waits for a batch and helps run it.
+ *
+ * @param arg the pool
+ * @return NULL
+ */
+static void *poolThread( void *arg )
+{
+  BatchPool *pool = ( BatchPool *)arg;
+
+  pthread_mutex_lock( &pool->lock );
+  while ( !pool->stop ) {
+    if ( pool->next < pool->count ) {
+      runCommands( pool );
+    } else {
+      pthread_cond_wait( &pool->work, &pool->lock );
+    }
+  }
+  pthread_mutex_unlock( &pool->lock );
+  return NULL;
+}
+
+/**
+ * Starts a pool of threads for running batches. The thread that runs a
+ * batch works on it too, so a pool of one thread starts no others.
+ *
+ * @param threads how many threads run each batch, up to BATCH_THREADS_MAX
+ * @return pointer to the new BatchPool
+ */
+BatchPool *makeBatchPool( int threads )
+{
+  BatchPool *pool = ( BatchPool *)calloc( 1, sizeof( BatchPool ) );
+  pthread_mutex_init( &pool->lock, NULL );
+  pthread_cond_init( &pool->work, NULL );
+  pthread_cond_init( &pool->done, NULL );
+
+  if ( threads > BATCH_THREADS_MAX ) {
+    threads = BATCH_THREADS_MAX;
+  }
+  for ( int i = 0; i < threads - 1; i++ ) {
+    if ( pthread_create( &pool->threads[ i ], NULL, poolThread, pool ) != 0 ) {
+      break;
+    }
+    pool->threadCount++;
+  }
+  return pool;
+}
+
+/**
+ * Stops the pool's threads and frees it.
+ *
+ * @param pool to free
+ */
+void freeBatchPool( BatchPool *pool )
+{
+  pthread_mutex_lock( &pool->lock );
+  pool->stop = true;
+  pthread_cond_broadcast( &pool->work );
+  pthread_mutex_unlock( &pool->lock );
+
+  for ( int i = 0; i < pool->threadCount; i++ ) {
+    pthread_join( pool->threads[ i ], NULL );
+  }
+  pthread_mutex_destroy( &pool->lock );
+  pthread_cond_destroy( &pool->work );
+  pthread_cond_destroy( &pool->done );
+  free( pool );
+}
+
+/**
+ * Runs a batch of read-only commands at the same time, then writes the
+ * output of each to out in the order they were given, each followed by
+ * separator. No reload is applied while the batch runs, and no sale may
+ * be recorded by another thread.
+ *
+ * @param pool the pool to run them on
+ * @param group the live group
+ * @param cmds the command lines, all passing readOnlyCommand()
+ * @param count number of commands, up to BATCH_MAX
+ * @param separator written after each command's output, such as a prompt
+ * @param out stream the output is written to
+ */
+void runBatch( BatchPool *pool, Group *group, char **cmds, int count, char const *separator, FILE *out )
+{
+  char *outputs[ BATCH_MAX ];
+  size_t lengths[ BATCH_MAX ];
+
+  traceBegin( "batch", NULL );
+  holdReloads( group );
+  pthread_mutex_lock( &pool->lock );
+  pool->group = group;
+  pool->cmds = cmds;
+  pool->outputs = outputs;
+  pool->lengths = lengths;
+  pool->count = count;
+  pool->next = 0;
+  pool->finished = 0;
+  pthread_cond_broadcast( &pool->work );
+
+  runCommands( pool );
+  while ( pool->finished < pool->count ) {
+    pthread_cond_wait( &pool->done, &pool->lock );
+  }
+  pool->count = 0;
+  pool->next = 0;
+  pthread_mutex_unlock( &pool->lock );
+  releaseReloads( group );
+
+  for ( int i = 0; i < count; i++ ) {
+    fwrite( outputs[ i ], 1, lengths[ i ], out );
+    fputs( separator, out );
+    free( outputs[ i ] );
+  }
+  traceEnd( "batch" );
+}
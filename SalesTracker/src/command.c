@@ -0,0 +1,769 @@
+/**
+ * @file command.c
+ * @author Luke Early
+ * Source file for the command language shared by the terminal and the server.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "command.h"
+#include "snapshot.h"
+#include "export.h"
+#include "reload.h"
+#include "history.h"
+#include "rollup.h"
+#include "lazy.h"
+#include "trace.h"
+
+/**
+ * Returns true for all items
+ * 
+ * @param item to test
+ * @param str by which to test item
+ * 
+ * @return true for every item
+ * 
+ */
+bool testItems( Item const *item, char const *str ) {
+  return true;
+}
+
+/**
+ * Returns true for all members
+ * 
+ * @param group the member belongs to
+ * @param member to test
+ * @param str by which to test member
+ * 
+ * @return true for every member
+ * 
+ */
+bool testMembers( Group const *group, Member const *member, char const *str ) {
+  return true;
+}
+
+/**
+ * Searches for items based off of strings (case sensitive)
+ * 
+ * @param item to test
+ * @param str by which to test item's name
+ * 
+ * @return true if item name contains str, false else
+ * 
+ */
+bool searchForItemByString( Item const *item, char const *str ) {
+  return strstr( item->name, str ) != NULL;
+}
+
+/**
+ * Searches for members based off of strings (case sensitive)
+ * 
+ * @param group the member belongs to
+ * @param member to test
+ * @param str by which to test members's name
+ * 
+ * @return true if member name contains str, false else
+ * 
+ */
+bool searchForMembersByString( Group const *group, Member const *member, char const *str ) {
+  return strstr( memberName( group, member ), str ) != NULL;
+}
+
+/**
+ * Compares the name of one item to the name
+ * of another.
+ * 
+ * @param va void pointer to item
+ * @param vb void pointer to item
+ * @return integer based on item names:
+ *         - less than 0 if va comes before vb
+ *         - zero if va is the same as vb
+ *         - more than 0 if va comes after vb
+ */
+int compareItemName( void const *va, void const *vb ) {
+  Item **a = ( Item **) va;
+  Item **b = ( Item **) vb;
+
+  return( strncmp( (*a)->name, (*b)->name, NAME_MAX ) );
+}
+
+/**
+ * Compares the id of one item to another.
+ * 
+ * @param va void pointer to item
+ * @param vb void pointer to item
+ * @return integer based on item names:
+ *         - less than 0 if va comes before vb
+ *         - zero if va is the same as vb
+ *         - more than 0 if va comes after vb
+ */
+int compareItemId( void const *va, void const *vb ) {
+  Item **a = ( Item **) va;
+  Item **b = ( Item **) vb;
+
+  if ( (*a)->id > (*b)->id ) {
+    return 1;
+  } else if ( (*a)->id < (*b)->id ) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+/**
+ * Compares the name of one member to another.
+ * 
+ * @param va void pointer to member
+ * @param vb void pointer to member
+ * @return integer based on item names:
+ *         - less than 0 if va comes before vb
+ *         - zero if va is the same as vb
+ *         - more than 0 if va comes after vb
+ */
+int compareMemberName( void const *va, void const *vb ) {
+  Member **a = ( Member **) va;
+  Member **b = ( Member **) vb;
+  Group const *group = sortingGroup();
+
+  return( strncmp( memberName( group, *a ), memberName( group, *b ), NAME_MAX ) );
+}
+
+/**
+ * Compares the sales of one member to another.
+ * 
+ * @param va void pointer to member
+ * @param vb void pointer to member
+ * @return integer based on item names:
+ *         - less than 0 if va comes before vb
+ *         - zero if va is the same as vb
+ *         - more than 0 if va comes after vb
+ */
+int compareMemberSales( void const *va, void const *vb ) {
+  Member **a = ( Member **) va;
+  Member **b = ( Member **) vb;
+  int aTotSales = (*a)->sales;
+  int bTotSales = (*b)->sales;
+
+  if ( aTotSales > bTotSales ) {
+    return -1;
+  } else if ( aTotSales < bTotSales ) {
+    return 1;
+  } else {
+    Group const *group = sortingGroup();
+    return strncmp( memberId( group, *a ), memberId( group, *b ), ID_MAX );
+  }
+}
+
+/**
+ * Compares the ID of one member to another.
+ * 
+ * @param va void pointer to member
+ * @param vb void pointer to member
+ * @return integer based on item names:
+ *         - less than 0 if va comes before vb
+ *         - zero if va is the same as vb
+ *         - more than 0 if va comes after vb
+ */
+int compareMemberID( void const *va, void const *vb ) {
+  Member **a = ( Member **) va;
+  Member **b = ( Member **) vb;
+  Group const *group = sortingGroup();
+
+  return( strncmp( memberId( group, *a ), memberId( group, *b ), ID_MAX ) );
+}
+
+
+/**
+ * Prints the column headings of an item report.
+ *
+ * @param out stream the report is written to
+ */
+static void printItemHeader( FILE *out )
+{
+  fprintf( out, "%-3s %-30s %6s %6s %6s\n", "ID", "Name", "Cost", "Sold", "Total" );
+}
+
+/**
+ * Prints the column headings of a member report.
+ *
+ * @param out stream the report is written to
+ */
+static void printMemberHeader( FILE *out )
+{
+  fprintf( out, "%-8s %-30s %6s %6s\n", "ID", "Name", "Sold", "Total" );
+}
+
+/**
+ * Prints the column headings of an approximate top sellers report.
+ *
+ * @param out stream the report is written to
+ */
+static void printSketchHeader( FILE *out )
+{
+  fprintf( out, "%-8s %-30s %6s %6s\n", "ID", "Name", "Total", "Error" );
+}
+
+/**
+ * Finds the last word of a string, skipping any blanks after it.
+ *
+ * @param str the string
+ * @param end where to look back from, set to just past the word
+ * @return where the word starts
+ */
+static int lastWord( char const *str, int *end )
+{
+  while ( *end > 0 && isspace( ( unsigned char ) str[ *end - 1 ] ) ) {
+    ( *end )--;
+  }
+  int start = *end;
+  while ( start > 0 && !isspace( ( unsigned char ) str[ start - 1 ] ) ) {
+    start--;
+  }
+  return start;
+}
+
+/**
+ * Takes limit and offset modifiers off the end of a list or search
+ * command's arguments. Either or both may be given, in either order.
+ *
+ * @param args the arguments, cut short in place before the modifiers
+ * @param page set to the page they ask for, or every row if there are none
+ * @return false if a modifier isn't followed by a non-negative number
+ */
+static bool cutPage( char *args, Page *page )
+{
+  *page = ALL_ROWS;
+  bool haveLimit = false;
+  bool haveOffset = false;
+
+  while ( true ) {
+    int valueEnd = strlen( args );
+    int valueStart = lastWord( args, &valueEnd );
+    int keyEnd = valueStart;
+    int keyStart = lastWord( args, &keyEnd );
+
+    bool isLimit = !haveLimit && keyEnd - keyStart == 5 && strncmp( args + keyStart, "limit", 5 ) == 0;
+    bool isOffset = !haveOffset && keyEnd - keyStart == 6 && strncmp( args + keyStart, "offset", 6 ) == 0;
+    if ( !isLimit && !isOffset ) {
+      return true;
+    }
+
+    int value = 0;
+    if ( valueEnd - valueStart > 9 || valueEnd == valueStart ) {
+      return false;
+    }
+    for ( int i = valueStart; i < valueEnd; i++ ) {
+      if ( !isdigit( ( unsigned char ) args[ i ] ) ) {
+        return false;
+      }
+      value = value * 10 + ( args[ i ] - '0' );
+    }
+
+    if ( isLimit ) {
+      page->limit = value;
+      haveLimit = true;
+    } else {
+      page->offset = value;
+      haveOffset = true;
+    }
+    args[ keyStart ] = '\0';
+  }
+}
+
+/**
+ * Parses the optional row count at the end of a leaderboard command.
+ *
+ * @param str what's left of the command after its words
+ * @param count set to the count, or TOP_ROWS if there isn't one
+ * @return false if there's anything else there
+ */
+static bool parseTopCount( char const *str, int *count )
+{
+  int end = 0;
+  *count = TOP_ROWS;
+  if ( sscanf( str, " %n", &end ) == 0 && str[ end ] == '\0' ) {
+    return true;
+  }
+  end = 0;
+  return sscanf( str, "%d %n", count, &end ) == 1 && end > 0 && str[ end ] == '\0' && *count >= 0;
+}
+
+/**
+ * Lists only the items or members changed after a group version, followed
+ * by the version the report is up to date with. Passing that version to
+ * the next call picks up exactly the changes made in between.
+ *
+ * @param group the live group
+ * @param kind items or members
+ * @param since only records changed after this version are listed
+ * @param page which rows to print
+ * @param out stream the report is written to
+ * @return false if kind isn't items or members
+ */
+static bool runChanges( Group *group, char const *kind, long since, Page page, FILE *out )
+{
+  // the totals are for the changed records, so they're added up as they're tested
+  long version = 0;
+  if ( strcmp( kind, "items" ) == 0 ) {
+    Group *view = openChangedView( group, since, &version );
+    printItemHeader( out );
+    listItems( view, testItems, NULL, compareItemId, page, out );
+    closeView( group, view );
+  } else if ( strcmp( kind, "members" ) == 0 ) {
+    Group *view = openChangedView( group, since, &version );
+    printMemberHeader( out );
+    listMembers( view, testMembers, NULL, compareMemberID, page, out );
+    closeView( group, view );
+  } else {
+    return false;
+  }
+
+  fprintf( out, "VERSION %ld\n", version );
+  return true;
+}
+
+/**
+ * Lists what the items or members sold in a recent window of time, from
+ * the group's rollups rather than their all-time totals. A page of top
+ * sellers that the members who sold in the window can fill is made from
+ * those members alone.
+ *
+ * @param group the live group
+ * @param kind items, members or topsellers
+ * @param window the window
+ * @param page which rows to print
+ * @param out stream the report is written to
+ * @return false if kind isn't one of those
+ */
+static bool runWindow( Group *group, char const *kind, Window const *window, Page page, FILE *out )
+{
+  if ( strcmp( kind, "items" ) == 0 ) {
+    Group *view = openView( group, false );
+    Group *windowed = openItemWindow( group, view, window );
+    printItemHeader( out );
+    listItems( windowed, NULL, NULL, compareItemId, page, out );
+    closeWindowView( windowed );
+    closeView( group, view );
+  } else if ( strcmp( kind, "members" ) == 0 ) {
+    Group *view = openView( group, true );
+    Group *windowed = openMemberWindow( group, view, window, false );
+    printMemberHeader( out );
+    listMembers( windowed, NULL, NULL, compareMemberID, page, out );
+    closeWindowView( windowed );
+    closeView( group, view );
+  } else if ( strcmp( kind, "topsellers" ) == 0 ) {
+    Group *view = openView( group, false );
+    Group *windowed = openMemberWindow( group, view, window, true );
+    if ( page.limit < 0 || page.offset + page.limit > windowed->mCount ) {
+      // the page runs into members who sold nothing, so they're listed too
+      closeWindowView( windowed );
+      closeView( group, view );
+      view = openView( group, true );
+      windowed = openMemberWindow( group, view, window, false );
+    }
+    printMemberHeader( out );
+    listMembers( windowed, NULL, NULL, compareMemberSales, page, out );
+    closeWindowView( windowed );
+    closeView( group, view );
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Runs one of the list reports that isn't a list of changes.
+ *
+ * @param group the live group
+ * @param args the command line after the word list, without any page modifiers
+ * @param page which rows to print
+ * @param out stream the report is written to
+ * @return false if the command is invalid
+ */
+static bool runReport( Group *group, char const *args, Page page, FILE *out )
+{
+  char secondCommand[ WORD_MAX + 1 ] = "";
+  char thirdCommand[ WORD_MAX + 1 ] = "";
+  int words = sscanf( args, " %30s %30s", secondCommand, thirdCommand );
+
+  // with no test, the TOTAL row comes from the snapshot's totals
+  if ( words == 1 && strcmp( secondCommand, "items" ) == 0 ) {
+    Group *view = openView( group, false );
+    printItemHeader( out );
+    listItems( view, NULL, NULL, compareItemId, page, out );
+    closeView( group, view );
+  } else if ( words == 2 && strcmp( secondCommand, "item" ) == 0
+              && strcmp( thirdCommand, "names" ) == 0 ) {
+    Group *view = openView( group, false );
+    printItemHeader( out );
+    listItems( view, NULL, NULL, compareItemName, page, out );
+    closeView( group, view );
+  } else if ( words == 1 && strcmp( secondCommand, "members" ) == 0 ) {
+    Group *view = openView( group, true );
+    printMemberHeader( out );
+    listMembers( view, NULL, NULL, compareMemberID, page, out );
+    closeView( group, view );
+  } else if ( words == 2 && strcmp( secondCommand, "member" ) == 0
+              && strcmp( thirdCommand, "names" ) == 0 ) {
+    Group *view = openView( group, true );
+    printMemberHeader( out );
+    listMembers( view, NULL, NULL, compareMemberName, page, out );
+    closeView( group, view );
+  } else if ( words == 2 && strcmp( secondCommand, "member" ) == 0 ) {
+    // one member needs only its own record, not a view of every member;
+    // its ID handle is its index in the snapshot. A lazily loaded member is
+    // made first, so the snapshot has it
+    if ( group->lazy != NULL ) {
+      enterGroup( group );
+      int idx = findMember( group, thirdCommand );
+      if ( idx >= 0 ) {
+        loadMember( group, idx );
+      }
+      leaveGroup( group );
+    }
+    int slot = 0;
+    Snapshot *snap = pinSnapshot( group, &slot );
+    traceBegin( "lookup", NULL );
+    StrHandle handle = findString( group->ids, thirdCommand );
+    traceEnd( "lookup" );
+    if ( handle == NO_HANDLE || handle >= snap->mCount ) {
+      unpinSnapshot( group, slot );
+      return false;
+    }
+    printItemHeader( out );
+    listSaleItems( snap->mPages[ handle >> PAGE_SHIFT ][ handle & PAGE_MASK ], page, out );
+    unpinSnapshot( group, slot );
+  } else if ( words == 1 && strcmp( secondCommand, "topsellers" ) == 0 ) {
+    Group *view = openView( group, true );
+    printMemberHeader( out );
+    listMembers( view, NULL, NULL, compareMemberSales, page, out );
+    closeView( group, view );
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Runs a list command. Reports are made from a read view, so they see one
+ * consistent snapshot and never reorder the live group. Items, members and
+ * topsellers can be limited to a recent window, such as "last 3 hours".
+ * The topitems leaderboard, by revenue or by units, is merged from the
+ * shards' item rankings, and the per-item topsellers one from the item's
+ * seller rankings, so neither needs a view. If the group keeps a sketch, topsellers
+ * approx estimates the top sellers from it and topsellers accuracy checks
+ * the estimate against the exact figures.
+ * Any list can be cut down to one page with limit and offset at the end.
+ *
+ * @param group the live group
+ * @param command the command line after the word list
+ * @param out stream the report is written to
+ * @return false if the command is invalid
+ */
+static bool runList( Group *group, char const *command, FILE *out )
+{
+  char secondCommand[ WORD_MAX + 1 ] = "";
+  char unit[ WORD_MAX + 1 ] = "";
+  long since = 0;
+  int count = 0;
+  int itemId = 0;
+  int end = 0;
+  int itemEnd = 0;
+
+  char *args = strdup( command );
+  Page page;
+  Window window;
+  bool valid = cutPage( args, &page );
+
+  if ( !valid ) {
+    // not a page anyone can ask for
+  } else if ( sscanf( args, " %30s changed since %ld %n", secondCommand, &since, &end ) == 2
+              && end > 0 && args[ end ] == '\0' ) {
+    valid = since >= 0 && runChanges( group, secondCommand, since, page, out );
+  } else if ( sscanf( args, " %30s last %d %30s %n", secondCommand, &count, unit, &end ) == 3
+              && end > 0 && args[ end ] == '\0' ) {
+    valid = parseWindow( count, unit, time( NULL ), &window ) && runWindow( group, secondCommand, &window, page, out );
+  } else if ( sscanf( args, " %30s %n", secondCommand, &end ) == 1 && strcmp( secondCommand, "topitems" ) == 0 ) {
+    // only the rows up to the end of the page are merged, so there's no view to sort
+    int unitsEnd = 0;
+    bool byUnits = sscanf( args + end, "%30s %n", unit, &unitsEnd ) == 1 && strcmp( unit, "units" ) == 0;
+    valid = parseTopCount( args + end + ( byUnits ? unitsEnd : 0 ), &count );
+    if ( valid ) {
+      printItemHeader( out );
+      listTopItems( group, byUnits, count, page, out );
+    }
+  } else if ( sscanf( args, " topsellers %30s %n", secondCommand, &end ) == 1
+              && ( strcmp( secondCommand, "approx" ) == 0 || strcmp( secondCommand, "accuracy" ) == 0 ) ) {
+    // only a group started with a sketch can estimate its top sellers
+    valid = group->sketch != NULL && parseTopCount( args + end, &count );
+    if ( valid && strcmp( secondCommand, "approx" ) == 0 ) {
+      printSketchHeader( out );
+      listApproxSellers( group, count, page, out );
+    } else if ( valid && page.offset == 0 && page.limit < 0 ) {
+      printSketchAccuracy( group, count, out );
+    } else {
+      valid = false;
+    }
+  } else if ( sscanf( args, " topsellers item %d%n", &itemId, &itemEnd ) == 1 && itemEnd > 0
+              && parseTopCount( args + itemEnd, &count ) ) {
+    // items are never removed, so one that's there now is still there to list
+    enterGroup( group );
+    valid = findItem( group, itemId ) >= 0;
+    leaveGroup( group );
+    if ( valid ) {
+      printMemberHeader( out );
+      listTopSellers( group, itemId, count, page, out );
+    }
+  } else {
+    valid = runReport( group, args, page, out );
+  }
+
+  free( args );
+  return valid;
+}
+
+/**
+ * Runs a search command against a read view of the group. The matches can
+ * be cut down to one page with limit and offset at the end.
+ *
+ * @param group the live group
+ * @param command the command line after the word search
+ * @param out stream the report is written to
+ * @return false if the command is invalid
+ */
+static bool runSearch( Group *group, char const *command, FILE *out )
+{
+  char secondCommand[ WORD_MAX + 1 ] = "";
+  char searchParam[ WORD_MAX + 1 ] = "";
+  char *args = strdup( command );
+  Page page;
+  int end = 0;
+  bool valid = cutPage( args, &page ) && sscanf( args, " %30s %30s %n", secondCommand, searchParam, &end ) == 2
+               && end > 0 && args[ end ] == '\0';
+
+  if ( valid && strcmp( secondCommand, "item" ) == 0 ) {
+    Group *view = openView( group, false );
+    printItemHeader( out );
+    listItems( view, searchForItemByString, searchParam, compareItemId, page, out );
+    closeView( group, view );
+  } else if ( valid && strcmp( secondCommand, "member" ) == 0 ) {
+    Group *view = openView( group, true );
+    printMemberHeader( out );
+    listMembers( view, searchForMembersByString, searchParam, compareMemberID, page, out );
+    closeView( group, view );
+  } else {
+    valid = false;
+  }
+
+  free( args );
+  return valid;
+}
+
+/**
+ * Runs a sale command, recording it in the live group.
+ *
+ * @param group the live group
+ * @param args the command line after the word sale
+ * @return false if the command is invalid
+ */
+static bool runSale( Group *group, char const *args )
+{
+  char sellersId[ ID_MAX + 1 ] = "";
+  int itemId = 0;
+  int numSold = 0;
+  int end = 0;
+
+  if ( sscanf( args, " %8s %d %d %n", sellersId, &itemId, &numSold, &end ) != 3
+       || end == 0 || args[ end ] != '\0' ) {
+    return false;
+  }
+
+  return recordSale( group, sellersId, itemId, numSold );
+}
+
+/**
+ * Runs an export command, writing a report to a file.
+ *
+ * @param group the live group
+ * @param args the command line after the word export
+ * @param out stream the result is written to
+ * @return false if the command is invalid
+ */
+static bool runExport( Group *group, char const *args, FILE *out )
+{
+  char report[ WORD_MAX + 1 ] = "";
+  char format[ WORD_MAX + 1 ] = "";
+  int offset = 0;
+  if ( sscanf( args, " %30s %30s %n", report, format, &offset ) != 2 || offset == 0 ) {
+    return false;
+  }
+
+  // the file name is the rest of the line, without trailing blanks
+  char const *filename = args + offset;
+  int len = strlen( filename );
+  while ( len > 0 && isspace( ( unsigned char ) filename[ len - 1 ] ) ) {
+    len--;
+  }
+  if ( len == 0 ) {
+    return false;
+  }
+
+  char *name = ( char *)malloc( len + 1 );
+  memcpy( name, filename, len );
+  name[ len ] = '\0';
+  bool valid = exportReport( group, report, format, name, out );
+  free( name );
+  return valid;
+}
+
+/**
+ * Runs a reload command. A plain reload starts reloading the item and
+ * member files in the background; reload status tells how it went.
+ *
+ * @param group the live group
+ * @param args the command line after the word reload
+ * @param out stream the result is written to
+ * @return false if the command is invalid
+ */
+static bool runReload( Group *group, char const *args, FILE *out )
+{
+  char secondCommand[ WORD_MAX + 1 ] = "";
+  int end = 0;
+  int words = sscanf( args, " %30s %n", secondCommand, &end );
+
+  if ( words == 1 && ( end == 0 || args[ end ] != '\0' ) ) {
+    // nothing may follow reload status
+    return false;
+  } else if ( words <= 0 ) {
+    if ( startReload( group ) ) {
+      fprintf( out, "Reload started\n" );
+    } else {
+      fprintf( out, "Reload already running\n" );
+    }
+  } else if ( strcmp( secondCommand, "status" ) == 0 ) {
+    reloadStatus( group, out );
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Runs a history command, totalling the sales of an item or by a member
+ * between two times, given in seconds since the epoch.
+ *
+ * @param group the live group
+ * @param args the command line after the word history
+ * @param out stream the result is written to
+ * @return false if the command is invalid
+ */
+static bool runHistory( Group *group, char const *args, FILE *out )
+{
+  char secondCommand[ WORD_MAX + 1 ] = "";
+  char key[ WORD_MAX + 1 ] = "";
+  long long from = 0;
+  long long to = 0;
+  int end = 0;
+  if ( sscanf( args, " %30s %30s %lld %lld %n", secondCommand, key, &from, &to, &end ) != 4
+       || end == 0 || args[ end ] != '\0' || group->history == NULL ) {
+    return false;
+  }
+
+  HistoryTotals totals;
+  if ( strcmp( secondCommand, "item" ) == 0 ) {
+    int itemId = 0;
+    char extra = '\0';
+    if ( sscanf( key, "%d%c", &itemId, &extra ) != 1 ) {
+      return false;
+    }
+    scanHistory( group->history, COLUMN_ITEM, itemId, from, to, &totals );
+  } else if ( strcmp( secondCommand, "member" ) == 0 ) {
+    if ( findMember( group, key ) < 0 ) {
+      return false;
+    }
+
+    // a member with no sales in the history has no code, which no block holds
+    StrHandle code = historyMember( group->history, key );
+    scanHistory( group->history, COLUMN_MEMBER, code, from, to, &totals );
+  } else {
+    return false;
+  }
+
+  fprintf( out, "%ld sales, %ld sold\n", totals.sales, totals.sold );
+  fprintf( out, "Scanned %d of %d blocks\n", totals.scanned, totals.blocks );
+  return true;
+}
+
+/**
+ * Tells whether a command line only reads the group, so it can run at the
+ * same time as other such commands.
+ *
+ * @param cmd the raw command line
+ * @return true for list, search and history commands
+ */
+bool readOnlyCommand( char const *cmd )
+{
+  char firstCommand[ WORD_MAX + 1 ] = "";
+  sscanf( cmd, "%30s", firstCommand );
+
+  return strcmp( firstCommand, "list" ) == 0 || strcmp( firstCommand, "search" ) == 0
+         || strcmp( firstCommand, "history" ) == 0;
+}
+
+/**
+ * Runs a single line of the command language against the given group.
+ *
+ * All output for the command (including the echoed command line) is written
+ * to out, so the same commands can be served to the terminal or to a socket.
+ *
+ * @param group the group the command operates on
+ * @param cmd the raw command line, without its trailing newline
+ * @param out stream the command's output is written to
+ * @return false if the command was quit, true otherwise
+ */
+bool runCommand( Group *group, char const *cmd, FILE *out )
+{
+  char firstCommand[ WORD_MAX + 1 ] = "";
+  int offset = 0;
+
+  traceBegin( "command", cmd );
+  traceBegin( "parse", NULL );
+  sscanf( cmd, "%30s%n", firstCommand, &offset );
+  traceEnd( "parse" );
+  fprintf( out, "%s\n", cmd );
+
+  if ( strcmp( firstCommand, "quit" ) == 0 ) {
+    traceEnd( "command" );
+    return false;
+  }
+
+  bool valid = false;
+  if ( strcmp( firstCommand, "list" ) == 0 ) {
+    valid = runList( group, cmd + offset, out );
+  } else if ( strcmp( firstCommand, "search" ) == 0 ) {
+    valid = runSearch( group, cmd + offset, out );
+  } else if ( strcmp( firstCommand, "sale" ) == 0 ) {
+    valid = runSale( group, cmd + offset );
+  } else if ( strcmp( firstCommand, "export" ) == 0 ) {
+    valid = runExport( group, cmd + offset, out );
+  } else if ( strcmp( firstCommand, "reload" ) == 0 ) {
+    valid = runReload( group, cmd + offset, out );
+  } else if ( strcmp( firstCommand, "history" ) == 0 ) {
+    valid = runHistory( group, cmd + offset, out );
+  }
+
+  if ( !valid ) {
+    fprintf( out, "Invalid command\n" );
+  }
+  fprintf( out, "\n" );
+
+  traceEnd( "command" );
+  return true;
+}
@@ -0,0 +1,340 @@
+/**
+ * @file export.c
+ * @author Luke Early
+ * Source file for exporting reports as CSV or JSON Lines.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "export.h"
+#include "snapshot.h"
+
+/** Which report is being exported */
+#define REPORT_ITEMS 0
+#define REPORT_MEMBERS 1
+#define REPORT_SALES 2
+
+/**
+ * An export file being written through a buffer.
+ */
+struct ExportStruct {
+  int fd;
+  char *buffer;
+  int used;
+  bool json;    // JSON Lines rather than CSV
+  bool failed;  // a write failed, so nothing more is written
+  int rows;
+  int totalRows;
+  FILE *out;    // where progress goes
+};
+typedef struct ExportStruct Export;
+
+/**
+ * Writes everything in the buffer to the file and empties it.
+ *
+ * @param exp the export
+ */
+static void flushExport( Export *exp )
+{
+  char *pos = exp->buffer;
+  while ( !exp->failed && pos < exp->buffer + exp->used ) {
+    ssize_t len = write( exp->fd, pos, exp->buffer + exp->used - pos );
+    if ( len < 0 && errno != EINTR ) {
+      exp->failed = true;
+    } else if ( len > 0 ) {
+      pos += len;
+    }
+  }
+  exp->used = 0;
+}
+
+/**
+ * Finishes a row, writing the buffer out if another row might not fit and
+ * reporting progress every EXPORT_PROGRESS_ROWS rows.
+ *
+ * @param exp the export
+ */
+static void endRow( Export *exp )
+{
+  exp->buffer[ exp->used++ ] = '\n';
+  if ( exp->used + EXPORT_ROW_MAX > EXPORT_BUFFER_SIZE ) {
+    flushExport( exp );
+  }
+
+  exp->rows++;
+  if ( exp->rows % EXPORT_PROGRESS_ROWS == 0 ) {
+    fprintf( exp->out, "Exported %d of %d rows\n", exp->rows, exp->totalRows );
+    fflush( exp->out );
+  }
+}
+
+/**
+ * Adds text to the current row.
+ *
+ * @param exp the export
+ * @param str the text, added as is
+ */
+static void putText( Export *exp, char const *str )
+{
+  int len = strlen( str );
+  memcpy( exp->buffer + exp->used, str, len );
+  exp->used += len;
+}
+
+/**
+ * Adds a number to the current row.
+ *
+ * @param exp the export
+ * @param value the number
+ */
+static void putInt( Export *exp, int value )
+{
+  char digits[ 12 ];
+  int count = 0;
+  unsigned int rest = value < 0 ? -( unsigned int ) value : ( unsigned int ) value;
+  do {
+    digits[ count++ ] = '0' + rest % 10;
+    rest /= 10;
+  } while ( rest > 0 );
+
+  if ( value < 0 ) {
+    exp->buffer[ exp->used++ ] = '-';
+  }
+  while ( count > 0 ) {
+    exp->buffer[ exp->used++ ] = digits[ --count ];
+  }
+}
+
+/**
+ * Adds a string to the current row, quoted and escaped for the format.
+ * CSV fields are only quoted if they need to be.
+ *
+ * @param exp the export
+ * @param str the string
+ */
+static void putString( Export *exp, char const *str )
+{
+  char *buf = exp->buffer;
+  if ( exp->json ) {
+    buf[ exp->used++ ] = '"';
+    for ( ; *str != '\0'; str++ ) {
+      unsigned char ch = *str;
+      if ( ch == '"' || ch == '\\' ) {
+        buf[ exp->used++ ] = '\\';
+        buf[ exp->used++ ] = ch;
+      } else if ( ch < ' ' ) {
+        exp->used += sprintf( buf + exp->used, "\\u%04x", ch );
+      } else {
+        buf[ exp->used++ ] = ch;
+      }
+    }
+    buf[ exp->used++ ] = '"';
+  } else if ( strpbrk( str, ",\"\r\n" ) == NULL ) {
+    putText( exp, str );
+  } else {
+    buf[ exp->used++ ] = '"';
+    for ( ; *str != '\0'; str++ ) {
+      if ( *str == '"' ) {
+        buf[ exp->used++ ] = '"';
+      }
+      buf[ exp->used++ ] = *str;
+    }
+    buf[ exp->used++ ] = '"';
+  }
+}
+
+/**
+ * Adds the key of the next JSON field, or the comma before the next CSV field.
+ *
+ * @param exp the export
+ * @param key name of the field
+ * @param first true for the first field of a row
+ */
+static void putKey( Export *exp, char const *key, bool first )
+{
+  if ( exp->json ) {
+    putText( exp, first ? "{\"" : ",\"" );
+    putText( exp, key );
+    putText( exp, "\":" );
+  } else if ( !first ) {
+    exp->buffer[ exp->used++ ] = ',';
+  }
+}
+
+/**
+ * Ends the fields of a row, closing the object for JSON.
+ *
+ * @param exp the export
+ */
+static void putEnd( Export *exp )
+{
+  if ( exp->json ) {
+    exp->buffer[ exp->used++ ] = '}';
+  }
+  endRow( exp );
+}
+
+/**
+ * Writes every item, as ID, name, cost, number sold and sales total.
+ *
+ * @param exp the export
+ * @param view read view of the group
+ */
+static void exportItems( Export *exp, Group *view )
+{
+  if ( !exp->json ) {
+    putText( exp, "id,name,cost,sold,total\n" );
+  }
+
+  for ( int i = 0; i < view->iCount && !exp->failed; i++ ) {
+    Item const *item = view->iList[ i ];
+    putKey( exp, "id", true );
+    putInt( exp, item->id );
+    putKey( exp, "name", false );
+    putString( exp, item->name );
+    putKey( exp, "cost", false );
+    putInt( exp, item->cost );
+    putKey( exp, "sold", false );
+    putInt( exp, item->numSold );
+    putKey( exp, "total", false );
+    putInt( exp, item->numSold * item->cost );
+    putEnd( exp );
+  }
+}
+
+/**
+ * Writes every member, as ID, name, number sold and sales total.
+ *
+ * @param exp the export
+ * @param view read view of the group
+ */
+static void exportMembers( Export *exp, Group *view )
+{
+  if ( !exp->json ) {
+    putText( exp, "id,name,sold,total\n" );
+  }
+
+  for ( int i = 0; i < view->mCount && !exp->failed; i++ ) {
+    Member const *member = view->mList[ i ];
+
+    putKey( exp, "id", true );
+    putString( exp, memberId( view, member ) );
+    putKey( exp, "name", false );
+    putString( exp, memberName( view, member ) );
+    putKey( exp, "sold", false );
+    putInt( exp, member->sold );
+    putKey( exp, "total", false );
+    putInt( exp, member->sales );
+    putEnd( exp );
+  }
+}
+
+/**
+ * Writes one row for each item each member has sold, as member ID, item
+ * ID, number sold and sales total.
+ *
+ * @param exp the export
+ * @param view read view of the group
+ */
+static void exportSales( Export *exp, Group *view )
+{
+  if ( !exp->json ) {
+    putText( exp, "member,item,sold,total\n" );
+  }
+
+  for ( int i = 0; i < view->mCount && !exp->failed; i++ ) {
+    Member const *member = view->mList[ i ];
+    char const *id = memberId( view, member );
+    for ( int j = 0; j < member->count; j++ ) {
+      SaleItem const *sale = member->list[ j ];
+      putKey( exp, "member", true );
+      putString( exp, id );
+      putKey( exp, "item", false );
+      putInt( exp, sale->itemPtr->id );
+      putKey( exp, "sold", false );
+      putInt( exp, sale->numSold );
+      putKey( exp, "total", false );
+      putInt( exp, sale->numSold * sale->itemPtr->cost );
+      putEnd( exp );
+    }
+  }
+}
+
+/**
+ * Writes one report of a group to a file as CSV or JSON Lines, straight
+ * from a read view of the group.
+ *
+ * The report is items, members or sales (one row for each item a member
+ * has sold), in the order they were loaded. Rows are formatted directly
+ * into a large buffer that is written out whenever it fills, so no
+ * intermediate strings are built. A line saying how many rows were
+ * written, and a progress line every EXPORT_PROGRESS_ROWS rows of a big
+ * export, go to out.
+ *
+ * @param group the live group
+ * @param report items, members or sales
+ * @param format csv or jsonl
+ * @param filename name of the file to write
+ * @param out stream progress and the result are written to
+ * @return false if the report or format isn't known
+ */
+bool exportReport( Group *group, char const *report, char const *format, char const *filename, FILE *out )
+{
+  int kind;
+  if ( strcmp( report, "items" ) == 0 ) {
+    kind = REPORT_ITEMS;
+  } else if ( strcmp( report, "members" ) == 0 ) {
+    kind = REPORT_MEMBERS;
+  } else if ( strcmp( report, "sales" ) == 0 ) {
+    kind = REPORT_SALES;
+  } else {
+    return false;
+  }
+
+  Export exp = { .json = false };
+  if ( strcmp( format, "jsonl" ) == 0 ) {
+    exp.json = true;
+  } else if ( strcmp( format, "csv" ) != 0 ) {
+    return false;
+  }
+
+  exp.fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+  if ( exp.fd < 0 ) {
+    fprintf( out, "Can't open file: %s\n", filename );
+    return true;
+  }
+  exp.buffer = ( char *)malloc( EXPORT_BUFFER_SIZE );
+  exp.out = out;
+
+  Group *view = openView( group, kind != REPORT_ITEMS );
+  if ( kind == REPORT_ITEMS ) {
+    exp.totalRows = view->iCount;
+    exportItems( &exp, view );
+  } else if ( kind == REPORT_MEMBERS ) {
+    exp.totalRows = view->mCount;
+    exportMembers( &exp, view );
+  } else {
+    for ( int i = 0; i < view->mCount; i++ ) {
+      exp.totalRows += view->mList[ i ]->count;
+    }
+    exportSales( &exp, view );
+  }
+  closeView( group, view );
+
+  flushExport( &exp );
+  if ( close( exp.fd ) != 0 ) {
+    exp.failed = true;
+  }
+  free( exp.buffer );
+
+  if ( exp.failed ) {
+    fprintf( out, "Can't write file: %s\n", filename );
+  } else {
+    fprintf( out, "Exported %d rows to %s\n", exp.rows, filename );
+  }
+  return true;
+}
@@ -1,316 +1,1640 @@
-/**
- * @file group.c
- * @author Luke Early
- * Source file for group component.
- */
-
-#include "group.h"
-#include "input.h"
-
-/**
- * This function dynamically allocates storage for the Group, initializes its 
- * fields (to store the two resizable arrays) and returns a pointer to the new 
- * Group. It’s kind of like a constructor in Java.
- * 
- * @return pointer to Group Struct
- */
-Group *makeGroup()
-{
-  Group *g1 = ( Group *)malloc( sizeof( Group ) ); // pointer to new group
-  
-  /* Pointer to a list of pointers to Item Structs */
-  Item **itemList = ( Item **)malloc( INIT_CAPACITY * sizeof( Item ) );
-  g1->iList = itemList;
-  g1->iCap = INIT_CAPACITY;
-  g1->iCount = 0;
-
-  /* Pointer to a list of pointers to Member Structs */
-  Member **memberList = ( Member **)malloc( INIT_CAPACITY * sizeof( Member ) );
-  g1->mList = memberList;
-  g1->mCap = INIT_CAPACITY;
-  g1->mCount = 0;
-
-  return g1;
-}
-
-/**
- * This function frees the memory used to store the given Group, including 
- * freeing space for all the Items, Members, and Member SaleItem lists, freeing 
- * the resizable arrays of pointers and freeing space for the Group struct itself.
- * 
- * @param group group containing all memory to be freed
- */
-void freeGroup( Group *group )
-{
-  free( group->iList );
-  free( group->mList );
-  for ( int i = 0; i < group->mCount; i++ ){
-    free( group->iList[ i ]->mList );
-  }
-  free( group );
-}
-
-/** 
- * This function reads all the items from an item file with the given name. 
- * 
- * It makes an instance of the Item struct for an item in the file and stores a 
- * pointer to that Item in the resizable item array in group.
- * 
- * Exits unsuccessful if criteria for file are not met.
- * 
- * @param filename is the name of the group file passed to the function
- * @param group is the pointer to the group that the file will read the item into
- */
-void readItems( char const *filename, Group *group )
-{
-  // validate and open file
-  FILE *itemFilePtr = fopen( filename, "r" );
-  if ( itemFilePtr == NULL ) {
-    printf( "Can't open file: %s\n", filename );
-    exit( EXIT_FAILURE );
-  }
-
-  // first line to process
-  char *itemLine = readLine( itemFilePtr );
-
-  // continue process until EOF
-  while ( itemLine != NULL ) {
-    // dynalloc Item struct
-    Item *itemPtr = ( Item *)malloc( sizeof( Item ) );
-
-    int fieldCountTracker = 0;
-    int offset = 0;
-    int nextOffset = 0;
-
-    int itemId = 0;
-    int itemCost = 0;
-    char itemName[ NAME_MAX ] = "";
-
-
-    if ( sscanf( itemLine, " %d%n", &itemId, &offset ) == 1 ) {
-      fieldCountTracker++;
-    } else {
-      printf( "Invalid item file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    if ( sscanf( itemLine + offset, " %d%n", &itemCost, &nextOffset ) == 1 ) {
-      fieldCountTracker++;
-      offset = offset + nextOffset;
-    } else {
-      printf( "Invalid item file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    if ( sscanf( itemLine + offset, " %30c%n", itemName, &nextOffset ) == 1 ) {
-      fieldCountTracker++;
-    } else {
-      printf( "Invalid item file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    itemName[ strlen( itemName ) ] = '\0';
-    itemPtr->id = itemId;
-    itemPtr->cost = itemCost;
-    strncpy( itemPtr->name, itemName, NAME_MAX );
-    
-    itemPtr->mList = (char**)malloc( INIT_CAPACITY*sizeof( char* ) );
-    for ( int i = 0; i < INIT_CAPACITY; i++ ) {
-      itemPtr->mList[ i ] = (char*)malloc( ID_MAX * sizeof( char ) );
-    }
-    itemPtr->mCap = INIT_CAPACITY;
-    itemPtr->mCount = 0;
-
-    group->iList[ group->iCount++ ] = itemPtr;
-
-    itemLine = readLine( itemFilePtr );
-  }
-}
-
-/** 
- * This function reads all the members from a member file with the given name.
- * 
- * Makes an instance of the Member struct for a member in the file and stores a 
- * pointer to that Member in the resizable member array in group.
- * 
- * Exits unsuccessful if:
- *     - name longer than 30
- *     - ID longer than 8
- *     - missing a field
- *     - two IDs are the same
- * 
- * @param filename string for the member file name
- * @param group pointer to group this will populate
- */
-void readMembers( char const *filename, Group *group )
-{
-  // validate and open file
-  FILE *memberFilePtr = fopen( filename, "r" );
-  if ( memberFilePtr == NULL ) {
-    printf( "Can't open file: %s\n", filename );
-    exit( EXIT_FAILURE );
-  }
-
-  // first line to process
-  char *memberLine = readLine( memberFilePtr );
-
-  // continue process until EOF
-  while ( memberLine != NULL ) {
-    // dynalloc Item struct
-    Member *memberPtr = ( Member *)malloc( sizeof( Member ) );
-
-    int fieldCountTracker = 0;
-
-    int offset = 0;
-    int nextOffset = 0;
-    
-    char memberId[ ID_MAX ] = "";
-    char memberName[ NAME_MAX ] = "";
-
-    if ( sscanf( memberLine, "%8s%n", memberId, &offset ) == 1 ) {
-      fieldCountTracker++;
-    } else {
-      printf( "Invalid member file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    if ( sscanf( memberLine + offset, " %30c%n", memberName, &nextOffset ) == 1 ) {
-      fieldCountTracker++;
-    } else {
-      printf( "Invalid member file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    if ( fieldCountTracker != 2 ) {
-      printf( "Invalid member file: %s\n", filename );
-      exit( EXIT_FAILURE );
-    }
-
-    for ( int i = 0; i < group->mCount; i++ ) {
-      if ( strncmp( memberId, group->mList[ i ]->id, ID_MAX ) == 0 ) {
-        printf( "Invalid member file: %s\n", filename );
-        exit( EXIT_FAILURE );
-      }
-    }
-
-    // init group member
-    memberName[ strlen( memberName ) ] = '\0';
-    strncpy( memberPtr->id, memberId, ID_MAX );
-    strncpy( memberPtr->name, memberName, NAME_MAX );
-    memberPtr->list = ( SaleItem **)malloc( INIT_CAPACITY * sizeof( SaleItem ) );
-    for ( int i = 0; i < INIT_CAPACITY; i++ ) {
-      memberPtr->list[ i ] = ( SaleItem *)malloc( sizeof( SaleItem ) );
-      memberPtr->list[ i ]->itemPtr = ( Item *)malloc( sizeof( Item ) );
-      memberPtr->list[ i ]->numSold = 0;
-    }
-    memberPtr->count = 0;
-    memberPtr->capacity = INIT_CAPACITY;
-
-    if ( group->mCount + 1 > group->mCap ) {
-      group->mCap = group->mCap * 2;
-      group->mList = ( Member**)realloc( group->mList, group->mCap * sizeof( Member ) );
-    }
-
-    group->mList[ group->mCount++ ] = memberPtr;
-
-    memberLine = readLine( memberFilePtr );
-  }
-}
-
-/** 
- * This function sorts the items in the given group based on input from user.
- * 
- * Used in conjunction with qsort()
- * 
- * @param group the group with the items that will be sorted
- * @param compare the function that will handle the sorting
- */
-void sortItems( Group *group, int (* compare) (void const *va, void const *vb ))
-{
-  qsort( group->iList, group->iCount, sizeof( Item* ), compare );
-}
-
-/** 
- * This function sorts the members in the given group based on input from user.
- * 
- * Used in conjunction with qsort()
- * 
- * @param group the group with the items that will be sorted
- * @param compare the function that will handle the sorting
- */
-void sortMembers( Group *group, int (* compare) (void const *va, void const *vb ))
-{
-  qsort( group->mList, group->mCount, sizeof( Member* ), compare );
-}
-
-/** 
- * This function prints all or some of the items based on test and str from user input. 
- * 
- * @param group from which the items will be printed
- * @param test function to handle determining if an item should be printed or not
- * @param str basis upon which items are or are not printed
- */
-void listItems( Group *group, bool (*test)( Item const *item, char const *str ), char const *str )
-{
-  int totalMoneyMade = 0;
-  int totalNumSold = 0;
-
-  for ( int i = 0; i < group->iCount; i++ ) {
-    if ( test( group->iList[ i ], str ) ) {
-      printf( "%3d %-30s %6d %6d %6d", 
-              group->iList[ i ]->id, 
-              group->iList[ i ]->name, 
-              group->iList[ i ]->cost, 
-              group->iList[ i ]->numSold, 
-              group->iList[ i ]->numSold * group->iList[ i ]->cost );
-      printf( "\n" );
-    }
-
-    totalMoneyMade = totalMoneyMade + ( group->iList[ i ]->numSold * group->iList[ i ]->cost );
-    totalNumSold = totalNumSold + group->iList[ i ]->numSold;
-  }
-
-  printf( "%-41s %6d %6d\n", "TOTAL", totalNumSold, totalMoneyMade  );
-  printf( "\n" );
-}
-
-/** 
- * This function prints all or some of the members based on test and str from user input. 
- * 
- * @param group from which the members will be printed
- * @param test function to handle determining if an item should be printed or not
- * @param str basis upon which members are or are not printed
- */
-void listMembers( Group *group, bool (*test)( Member const *member, char const *str ), char const *str )
-{
-  int totalMoneyMade = 0;
-  int totalNumSold = 0;
-
-  for ( int i = 0; i < group->mCount; i++ ) {
-    int memberItemsSold = 0;
-    int memberSales = 0;
-
-    if ( test( group->mList[ i ], str ) ) {
-      for ( int j = 0; j < group->mList[ i ]->count; j++ ) {
-        int currItemSold = group->mList[ i ]->list[ j ]->numSold;
-        int currItemCost = group->mList[ i ]->list[ j ]->itemPtr->cost;
-
-        memberItemsSold = memberItemsSold + currItemSold;
-        memberSales = memberSales + ( currItemSold * currItemCost );
-      }
-      printf( "%-8s %-30s %6d %6d", 
-              group->mList[ i ]->id, 
-              group->mList[ i ]->name,
-              memberItemsSold,
-              memberSales );
-      printf( "\n" );
-
-    }
-    
-    totalMoneyMade = totalMoneyMade + memberSales;
-    totalNumSold = totalNumSold + memberItemsSold;
-  }
-
-  printf( "%-39s %6d %6d\n", "TOTAL", totalNumSold, totalMoneyMade  );
-  printf( "\n" );
-}
+/**
+ * @file group.c
+ * @author Luke Early
+ * Source file for group component.
+ */
+
+#include <time.h>
+
+#include "group.h"
+#include "input.h"
+#include "snapshot.h"
+#include "loader.h"
+#include "reload.h"
+#include "history.h"
+#include "rollup.h"
+#include "ranking.h"
+#include "sketch.h"
+#include "publish.h"
+#include "lazy.h"
+#include "trace.h"
+
+/**
+ * This function dynamically allocates storage for the Group, initializes its 
+ * fields (to store the two resizable arrays) and returns a pointer to the new 
+ * Group. It’s kind of like a constructor in Java.
+ * 
+ * @return pointer to Group Struct
+ */
+Group *makeGroup()
+{
+  Group *g1 = ( Group *)malloc( sizeof( Group ) ); // pointer to new group
+  
+  /* Pointer to a list of pointers to Item Structs */
+  Item **itemList = ( Item **)malloc( INIT_CAPACITY * sizeof( Item ) );
+  g1->iList = itemList;
+  g1->iCap = INIT_CAPACITY;
+  g1->iCount = 0;
+
+  /* Pointer to a list of pointers to Member Structs */
+  Member **memberList = ( Member **)malloc( INIT_CAPACITY * sizeof( Member ) );
+  g1->mList = memberList;
+  g1->mCap = INIT_CAPACITY;
+  g1->mCount = 0;
+
+  g1->ids = makePool();
+  g1->names = makePool();
+  g1->totalSold = 0;
+  g1->totalSales = 0;
+  g1->versions = makeVersions();
+  g1->snapshot = NULL;
+  g1->pin = -1;
+  g1->itemFile = NULL;
+  g1->memberFile = NULL;
+  g1->itemMark = ( FileMark ) { 0, 0 };
+  g1->memberMark = ( FileMark ) { 0, 0 };
+  g1->reload = makeReload();
+  g1->history = NULL;
+  g1->windowRecords = NULL;
+  g1->sketch = NULL;
+  g1->publisher = NULL;
+  g1->lazy = NULL;
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    g1->rollups[ i ] = makeRollup();
+    g1->topItems[ i ] = ( ItemRanks *)calloc( 1, sizeof( ItemRanks ) );
+    g1->topItems[ i ]->byRevenue = makeRanking();
+    g1->topItems[ i ]->byUnits = makeRanking();
+  }
+
+  return g1;
+}
+
+/**
+ * Frees the seller rankings of an item.
+ *
+ * @param sellers its SELLER_SHARDS rankings, or NULL for an item that hasn't been sold
+ */
+static void freeSellers( Ranking **sellers )
+{
+  if ( sellers == NULL ) {
+    return;
+  }
+  for ( int i = 0; i < SELLER_SHARDS; i++ ) {
+    freeRanking( sellers[ i ] );
+  }
+  free( sellers );
+}
+
+/**
+ * This function frees the memory used to store the given Group, including 
+ * freeing space for all the Items, Members, and Member SaleItem lists, freeing 
+ * the resizable arrays of pointers and freeing space for the Group struct itself.
+ * 
+ * @param group group containing all memory to be freed
+ */
+void freeGroup( Group *group )
+{
+  // a reload still running would be changing the group
+  freeReload( group->reload );
+  if ( group->publisher != NULL ) {
+    closePublisher( group->publisher );
+  }
+  if ( group->history != NULL ) {
+    closeHistory( group->history );
+  }
+
+  for ( int i = 0; i < group->iCount; i++ ) {
+    freeSellers( group->iList[ i ]->sellers );
+    free( group->iList[ i ] );
+  }
+
+  for ( int i = 0; i < group->mCount; i++ ) {
+    if ( group->mList[ i ] == NULL ) {
+      continue;
+    }
+    for ( int j = 0; j < group->mList[ i ]->capacity; j++ ) {
+      free( group->mList[ i ]->list[ j ] );
+    }
+    free( group->mList[ i ]->list );
+    free( group->mList[ i ] );
+  }
+  freeLazy( group->lazy );
+
+  freeSketch( group->sketch );
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    freeRollup( group->rollups[ i ] );
+    freeRanking( group->topItems[ i ]->byRevenue );
+    freeRanking( group->topItems[ i ]->byUnits );
+    free( group->topItems[ i ]->revenue );
+    free( group->topItems[ i ]->units );
+    free( group->topItems[ i ] );
+  }
+  freeVersions( group->versions );
+  freePool( group->ids );
+  freePool( group->names );
+  free( group->itemFile );
+  free( group->memberFile );
+  free( group->iList );
+  free( group->mList );
+  free( group );
+}
+
+/**
+ * Skips spaces and tabs.
+ *
+ * @param str where to start
+ * @return the first character that isn't a space or tab
+ */
+static char *skipBlanks( char *str )
+{
+  while ( *str == ' ' || *str == '\t' ) {
+    str++;
+  }
+  return str;
+}
+
+/**
+ * Reads a non-negative whole number of at most nine digits.
+ *
+ * @param str where the number starts, moved past it
+ * @param value set to the number
+ * @return false if there's no number there or it's too long
+ */
+static bool parseCount( char **str, int *value )
+{
+  int digits = 0;
+  *value = 0;
+  while ( isdigit( ( unsigned char ) **str ) ) {
+    if ( ++digits > 9 ) {
+      return false;
+    }
+    *value = *value * 10 + ( **str - '0' );
+    ( *str )++;
+  }
+  return digits > 0;
+}
+
+/**
+ * Takes the rest of a line as a name, cutting off the blanks after it in place.
+ *
+ * @param str where the name starts
+ * @return the start of the name, or NULL if it's empty or longer than NAME_MAX
+ */
+static char *trimName( char *str )
+{
+  str = skipBlanks( str );
+  int len = strlen( str );
+  while ( len > 0 && ( str[ len - 1 ] == ' ' || str[ len - 1 ] == '\t' ) ) {
+    len--;
+  }
+  if ( len == 0 || len > NAME_MAX ) {
+    return NULL;
+  }
+  str[ len ] = '\0';
+  return str;
+}
+
+/**
+ * Parses one line of an item file: an ID, a cost and a name.
+ *
+ * @param line the line to parse
+ * @return a new Item, or NULL if the line is invalid
+ */
+void *parseItemLine( char *line )
+{
+  Item item;
+  char *pos = skipBlanks( line );
+
+  if ( !parseCount( &pos, &item.id ) || ( *pos != ' ' && *pos != '\t' ) ) {
+    return NULL;
+  }
+  pos = skipBlanks( pos );
+  if ( !parseCount( &pos, &item.cost ) || ( *pos != ' ' && *pos != '\t' ) ) {
+    return NULL;
+  }
+  char *name = trimName( pos );
+  if ( name == NULL ) {
+    return NULL;
+  }
+  strcpy( item.name, name );
+
+  Item *itemPtr = ( Item *)malloc( sizeof( Item ) );
+  *itemPtr = item;
+  itemPtr->numSold = 0;
+  itemPtr->version = 0;
+  itemPtr->sellers = NULL;
+  return itemPtr;
+}
+
+/**
+ * Checks one line of a member file, an ID and a name, and rewrites it in
+ * place as the ID and then the name, each ended by a nul. Members are made
+ * from these once the IDs and names are interned, so no record is
+ * allocated here.
+ *
+ * @param line the line to parse
+ * @return the start of the rewritten line, or NULL if the line is invalid
+ */
+void *parseMemberLine( char *line )
+{
+  char *pos = skipBlanks( line );
+
+  int len = 0;
+  while ( pos[ len ] != '\0' && pos[ len ] != ' ' && pos[ len ] != '\t' ) {
+    len++;
+  }
+  if ( len == 0 || len > ID_MAX ) {
+    return NULL;
+  }
+
+  char *name = trimName( pos + len );
+  if ( name == NULL ) {
+    return NULL;
+  }
+  pos[ len ] = '\0';
+  memmove( pos + len + 1, name, strlen( name ) + 1 );
+  return pos;
+}
+
+/**
+ * Checks one line of a member file the way parseMemberLine() does, but
+ * only puts a nul after the ID and after the name, moving nothing, so a
+ * lazily loaded file can be indexed by ID as it is.
+ *
+ * @param line the line to check
+ * @return the start of the ID, or NULL if the line is invalid
+ */
+static void *indexMemberLine( char *line )
+{
+  char *pos = skipBlanks( line );
+
+  int len = 0;
+  while ( pos[ len ] != '\0' && pos[ len ] != ' ' && pos[ len ] != '\t' ) {
+    len++;
+  }
+  if ( len == 0 || len > ID_MAX || trimName( pos + len ) == NULL ) {
+    return NULL;
+  }
+  pos[ len ] = '\0';
+  return pos;
+}
+
+/**
+ * Returns a power of two table size with room for count entries at no
+ * more than half full.
+ *
+ * @param count number of entries
+ * @return table size
+ */
+static int tableSize( int count )
+{
+  int size = 16;
+  while ( size < count * 2 ) {
+    size *= 2;
+  }
+  return size;
+}
+
+/**
+ * Checks the group for two items with the same ID, using an open
+ * addressing hash set so the check is linear in the number of items.
+ *
+ * @param group the group to check
+ * @return true if some ID appears twice
+ */
+static bool hasDuplicateItems( Group *group )
+{
+  int size = tableSize( group->iCount );
+  int *table = ( int *)calloc( size, sizeof( int ) ); // index + 1, 0 if empty
+  bool duplicate = false;
+
+  for ( int i = 0; i < group->iCount && !duplicate; i++ ) {
+    unsigned int slot = ( unsigned int ) group->iList[ i ]->id * 2654435761u & ( size - 1 );
+    while ( table[ slot ] != 0 ) {
+      if ( group->iList[ table[ slot ] - 1 ]->id == group->iList[ i ]->id ) {
+        duplicate = true;
+        break;
+      }
+      slot = ( slot + 1 ) & ( size - 1 );
+    }
+    table[ slot ] = i + 1;
+  }
+
+  free( table );
+  return duplicate;
+}
+
+/** 
+ * This function reads all the items from an item file with the given name. 
+ * 
+ * It makes an instance of the Item struct for an item in the file and stores a 
+ * pointer to that Item in the resizable item array in group. Big files are
+ * parsed in chunks on several threads, then added in file order.
+ * 
+ * Prints a message to stderr and fails if criteria for file are not met:
+ *     - name longer than 30
+ *     - ID or cost missing or not a non-negative number
+ *     - missing a field
+ *     - two IDs are the same
+ * 
+ * @param filename is the name of the group file passed to the function
+ * @param group is the pointer to the group that the file will read the item into
+ * @return false if the file can't be opened or is invalid
+ */
+bool readItems( char const *filename, Group *group )
+{
+  Load *load = loadFile( filename, parseItemLine, &group->itemMark );
+  if ( load == NULL ) {
+    fprintf( stderr, "Can't open file: %s\n", filename );
+    return false;
+  }
+  if ( loadInvalid( load ) ) {
+    fprintf( stderr, "Invalid item file: %s\n", filename );
+    for ( int c = 0; c < load->chunkCount; c++ ) {
+      for ( int i = 0; i < load->chunks[ c ].count; i++ ) {
+        free( load->chunks[ c ].records[ i ] );
+      }
+    }
+    freeLoad( load );
+    return false;
+  }
+
+  int needed = group->iCount + loadCount( load );
+  if ( needed > group->iCap ) {
+    group->iCap = needed;
+    group->iList = ( Item **)realloc( group->iList, group->iCap * sizeof( Item * ) );
+  }
+  reserveVersions( group );
+
+  for ( int c = 0; c < load->chunkCount; c++ ) {
+    memcpy( group->iList + group->iCount, load->chunks[ c ].records,
+            load->chunks[ c ].count * sizeof( Item * ) );
+    group->iCount += load->chunks[ c ].count;
+  }
+  freeLoad( load );
+
+  if ( hasDuplicateItems( group ) ) {
+    fprintf( stderr, "Invalid item file: %s\n", filename );
+    return false;
+  }
+
+  free( group->itemFile );
+  group->itemFile = strdup( filename );
+  return true;
+}
+
+/**
+ * Makes a member from each line of a member file and adds them to the
+ * group in file order, interning the IDs and then the names in one batch
+ * each.
+ *
+ * @param group the live group
+ * @param lines each line, cut into its ID and then its name, in file order
+ * @param count how many lines there are
+ * @return false if an ID is already taken, by another line or a member
+ */
+static bool addMembers( Group *group, char const **lines, int count )
+{
+  // every ID handed out is a member's, so a new ID gets the next index
+  // and one that was seen before is a duplicate
+  StrHandle *ids = ( StrHandle *)malloc( ( count + 1 ) * sizeof( StrHandle ) );
+  internStrings( group->ids, lines, count, ids );
+  for ( int i = 0; i < count; i++ ) {
+    if ( ids[ i ] != group->mCount + i ) {
+      free( ids );
+      return false;
+    }
+  }
+
+  char const **names = ( char const **)malloc( ( count + 1 ) * sizeof( char * ) );
+  for ( int i = 0; i < count; i++ ) {
+    names[ i ] = lines[ i ] + strlen( lines[ i ] ) + 1;
+  }
+  StrHandle *nameHandles = ( StrHandle *)malloc( ( count + 1 ) * sizeof( StrHandle ) );
+  internStrings( group->names, names, count, nameHandles );
+  for ( int i = 0; i < count; i++ ) {
+    group->mList[ group->mCount++ ] = makeMember( ids[ i ], nameHandles[ i ] );
+  }
+  free( names );
+  free( nameHandles );
+  free( ids );
+  return true;
+}
+
+/** 
+ * This function reads all the members from a member file with the given name.
+ * 
+ * Makes an instance of the Member struct for a member in the file and stores a 
+ * pointer to that Member in the resizable member array in group. Big files are
+ * parsed in chunks on several threads, then added in file order, with the
+ * IDs and then the names interned in one batch each.
+ * 
+ * If the group's lazy field is set, the lines are only checked and indexed
+ * by ID, and nothing is interned or made yet: each member's place in the
+ * array is left NULL and the file is kept, so the member can be made from
+ * its line when it's first needed. The group must have no members yet.
+ * 
+ * Prints a message to stderr and fails if:
+ *     - name longer than 30
+ *     - ID longer than 8
+ *     - missing a field
+ *     - two IDs are the same
+ * 
+ * @param filename string for the member file name
+ * @param group pointer to group this will populate
+ * @return false if the file can't be opened or is invalid
+ */
+bool readMembers( char const *filename, Group *group )
+{
+  LineParser parse = group->lazy != NULL ? indexMemberLine : parseMemberLine;
+  Load *load = loadFile( filename, parse, &group->memberMark );
+  if ( load == NULL ) {
+    fprintf( stderr, "Can't open file: %s\n", filename );
+    return false;
+  }
+  if ( loadInvalid( load ) ) {
+    fprintf( stderr, "Invalid member file: %s\n", filename );
+    freeLoad( load );
+    return false;
+  }
+
+  int count = loadCount( load );
+  int needed = group->mCount + count;
+  if ( needed > group->mCap ) {
+    group->mCap = needed;
+    group->mList = ( Member **)realloc( group->mList, group->mCap * sizeof( Member * ) );
+  }
+  reserveVersions( group );
+
+  // every line in file order, each cut into its ID and then its name
+  char const **lines = ( char const **)malloc( ( count + 1 ) * sizeof( char * ) );
+  int lineCount = 0;
+  for ( int c = 0; c < load->chunkCount; c++ ) {
+    for ( int i = 0; i < load->chunks[ c ].count; i++ ) {
+      lines[ lineCount++ ] = load->chunks[ c ].records[ i ];
+    }
+  }
+
+  bool valid = group->lazy != NULL ? indexMembers( group, ( char **) lines, count )
+                                    : addMembers( group, lines, count );
+  if ( !valid ) {
+    fprintf( stderr, "Invalid member file: %s\n", filename );
+    free( lines );
+    freeLoad( load );
+    return false;
+  }
+
+  if ( group->lazy != NULL ) {
+    // the members are made from their lines when they're first needed, with
+    // the ID handles they'll get, which are their indexes, set aside now
+    reserveStrings( group->ids, count );
+    for ( int i = 0; i < count; i++ ) {
+      group->mList[ group->mCount++ ] = NULL;
+    }
+    group->lazy->buffer = load->buffer;
+    load->buffer = NULL;
+  } else {
+    free( lines );
+  }
+  freeLoad( load );
+
+  free( group->memberFile );
+  group->memberFile = strdup( filename );
+  return true;
+}
+
+/**
+ * Makes a member that hasn't sold anything yet.
+ *
+ * @param id handle of its ID, which is also its index
+ * @param name handle of its name
+ * @return the new Member
+ */
+Member *makeMember( StrHandle id, StrHandle name )
+{
+  Member *member = ( Member *)malloc( sizeof( Member ) );
+  member->id = id;
+  member->name = name;
+  member->list = NULL;
+  member->count = 0;
+  member->capacity = 0;
+  member->sold = 0;
+  member->sales = 0;
+  member->version = 0;
+  return member;
+}
+
+/**
+ * Finds the position of the item with the given ID in the group.
+ *
+ * @param group the group to search
+ * @param id item ID to look for
+ * @return index into iList, or -1 if there is no such item
+ */
+int findItem( Group *group, int id )
+{
+  for ( int i = 0; i < group->iCount; i++ ) {
+    if ( group->iList[ i ]->id == id ) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Returns the text of a member's ID.
+ *
+ * @param group the group the member belongs to
+ * @param member the member
+ * @return the member's ID
+ */
+char const *memberId( Group const *group, Member const *member )
+{
+  return poolString( group->ids, member->id );
+}
+
+/**
+ * Returns the text of a member's name.
+ *
+ * @param group the group the member belongs to
+ * @param member the member
+ * @return the member's name
+ */
+char const *memberName( Group const *group, Member const *member )
+{
+  return poolString( group->names, member->name );
+}
+
+/**
+ * Finds the position of the member with the given ID in the live group.
+ * Every ID in the pool is a member's, and its handle is the member's
+ * index, so the ID is only hashed once. A lazily loaded member that
+ * hasn't been made yet is found in the lazy index instead. Not for sorted
+ * read views.
+ *
+ * @param group the live group to search
+ * @param id member ID to look for
+ * @return index into mList, or -1 if there is no such member
+ */
+int findMember( Group *group, char const *id )
+{
+  StrHandle handle = findString( group->ids, id );
+
+  // a lazily loaded member's ID isn't in the pool until it's made
+  if ( handle == NO_HANDLE && group->lazy != NULL ) {
+    return findLazyMember( group->lazy, id );
+  }
+
+  // IDs from a member file that turned out invalid were interned but never added
+  if ( handle == NO_HANDLE || handle >= ( StrHandle ) group->mCount ) {
+    return -1;
+  }
+  return handle;
+}
+
+/**
+ * Returns an item's seller rankings, making them on its first sale. Other
+ * threads may be making them for the same item at once, so they're put
+ * in place with a compare and swap, and a thread that loses frees its own.
+ *
+ * @param item the item that was sold
+ * @return its SELLER_SHARDS rankings
+ */
+static Ranking **sellerRankings( Item *item )
+{
+  Ranking **sellers = __atomic_load_n( &item->sellers, __ATOMIC_ACQUIRE );
+  if ( sellers != NULL ) {
+    return sellers;
+  }
+
+  Ranking **made = ( Ranking **)malloc( SELLER_SHARDS * sizeof( Ranking * ) );
+  for ( int i = 0; i < SELLER_SHARDS; i++ ) {
+    made[ i ] = makeRanking();
+  }
+  if ( __atomic_compare_exchange_n( &item->sellers, &sellers, made, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+    return made;
+  }
+  freeSellers( made );
+  return sellers;
+}
+
+/**
+ * Finds the member's SaleItem for the given item, adding a new one if the
+ * member hasn't sold that item before. Must be called holding the member's
+ * record lock. A new SaleItem isn't in the item's seller ranking yet;
+ * that's left to the caller, under the lock of the member's seller shard.
+ *
+ * @param member the member who made the sale
+ * @param item the item that was sold
+ * @return the member's SaleItem for item, with no rank if it's new
+ */
+static SaleItem *findSaleItem( Member *member, Item *item )
+{
+  for ( int i = 0; i < member->count; i++ ) {
+    if ( member->list[ i ]->itemPtr == item ) {
+      return member->list[ i ];
+    }
+  }
+
+  if ( member->count + 1 > member->capacity ) {
+    int newCap = member->capacity == 0 ? INIT_CAPACITY : member->capacity * 2;
+    member->list = ( SaleItem **)realloc( member->list, newCap * sizeof( SaleItem * ) );
+    for ( int i = member->capacity; i < newCap; i++ ) {
+      member->list[ i ] = ( SaleItem *)malloc( sizeof( SaleItem ) );
+      member->list[ i ]->itemPtr = NULL;
+      member->list[ i ]->numSold = 0;
+      member->list[ i ]->rank = NULL;
+    }
+    member->capacity = newCap;
+  }
+
+  SaleItem *saleItem = member->list[ member->count++ ];
+  saleItem->itemPtr = item;
+  saleItem->numSold = 0;
+  return saleItem;
+}
+
+/**
+ * Moves an item up a shard's leaderboards for a sale, adding it to them
+ * the first time it sells in the shard. Must be called holding the
+ * shard's lock.
+ *
+ * @param ranks the shard's leaderboards
+ * @param item the item sold
+ * @param idx index of the item in iList
+ * @param numSold how many were sold
+ */
+static void rankItemSale( ItemRanks *ranks, Item const *item, int idx, int numSold )
+{
+  if ( idx >= ranks->cap ) {
+    int cap = ranks->cap == 0 ? INIT_CAPACITY : ranks->cap;
+    while ( cap <= idx ) {
+      cap *= 2;
+    }
+    ranks->revenue = ( RankNode **)realloc( ranks->revenue, cap * sizeof( RankNode * ) );
+    ranks->units = ( RankNode **)realloc( ranks->units, cap * sizeof( RankNode * ) );
+    for ( int i = ranks->cap; i < cap; i++ ) {
+      ranks->revenue[ i ] = NULL;
+      ranks->units[ i ] = NULL;
+    }
+    ranks->cap = cap;
+  }
+  if ( ranks->units[ idx ] == NULL ) {
+    ranks->revenue[ idx ] = addRanked( ranks->byRevenue, item->id, idx );
+    ranks->units[ idx ] = addRanked( ranks->byUnits, item->id, idx );
+  }
+  int sold = ranks->units[ idx ]->sold + numSold;
+  updateRanked( ranks->byRevenue, ranks->revenue[ idx ], sold, sold * item->cost );
+  updateRanked( ranks->byUnits, ranks->units[ idx ], sold, sold );
+}
+
+/**
+ * Records a sale of numSold of the given item by the given member.
+ *
+ * Updates the item's and member's counts and the group totals in place and
+ * marks both records as changed, so the next published snapshot picks them up.
+ * The sale is also added to the group's history, if it keeps one, and
+ * counted towards the next copy published to shared memory, if there is one.
+ *
+ * Sales are recorded on the group's shared side, so sales from many threads
+ * run at once: the counts are bumped with atomic adds, and no lock is
+ * shared by every sale. The member's record lock is held while its sale
+ * list changes, and the lock of one of the item's seller shards, picked by
+ * the member's index, while the member is moved up the item's sellers. The
+ * sale is added to the recent sales and item leaderboards of the calling
+ * thread's own shard, under that shard's lock, so threads selling at once
+ * rarely wait. A group that keeps a top sellers sketch also takes the
+ * sketch's lock, just long enough to add the sale to it. A group that
+ * keeps a history adds the sale to the calling thread's own stage of it,
+ * and only takes the history's lock to hand over a full stage, every
+ * HISTORY_STAGE_ROWS sales.
+ *
+ * @param group the live group the sale is recorded in
+ * @param memberId ID of the member who made the sale
+ * @param itemId ID of the item that was sold
+ * @param numSold how many were sold
+ * @return false if the member or item doesn't exist or numSold isn't positive
+ */
+bool recordSale( Group *group, char const *memberId, int itemId, int numSold )
+{
+  if ( numSold <= 0 ) {
+    return false;
+  }
+
+  enterGroup( group );
+  traceBegin( "lookup", NULL );
+  int memberIdx = findMember( group, memberId );
+  int itemIdx = findItem( group, itemId );
+  traceEnd( "lookup" );
+  if ( memberIdx < 0 || itemIdx < 0 ) {
+    leaveGroup( group );
+    return false;
+  }
+
+  Member *member = loadMember( group, memberIdx );
+  Item *item = group->iList[ itemIdx ];
+  long long now = time( NULL );
+
+  newVersion( group );
+  lockMember( group, memberIdx );
+  SaleItem *saleItem = findSaleItem( member, item );
+  saleItem->numSold += numSold;
+  member->sold += numSold;
+  member->sales += numSold * item->cost;
+
+  // the member's place among the item's sellers is in the shard for its index
+  int shard = memberIdx % SELLER_SHARDS;
+  Ranking *sellers = sellerRankings( item )[ shard ];
+  lockSellers( group, itemIdx, shard );
+  if ( saleItem->rank == NULL ) {
+    saleItem->rank = addRanked( sellers, member->id, member->id );
+  }
+  updateRanked( sellers, saleItem->rank, saleItem->numSold, saleItem->numSold );
+  unlockSellers( group, itemIdx, shard );
+  unlockMember( group, memberIdx );
+
+  int rollupShard = saleShard();
+  lockShard( group, rollupShard );
+  addRollup( group->rollups[ rollupShard ], now, memberIdx, itemIdx, numSold );
+  rankItemSale( group->topItems[ rollupShard ], item, itemIdx, numSold );
+  unlockShard( group, rollupShard );
+  __atomic_fetch_add( &item->numSold, numSold, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &group->totalSold, numSold, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &group->totalSales, numSold * item->cost, __ATOMIC_RELAXED );
+
+  if ( group->sketch != NULL ) {
+    lockSketch( group );
+    addSketch( group->sketch, member->id, numSold * item->cost );
+    unlockSketch( group );
+  }
+
+  markItemChanged( group, itemIdx );
+  markMemberChanged( group, memberIdx );
+  if ( group->history != NULL ) {
+    addHistory( group->history, now, poolString( group->ids, member->id ), itemId, numSold );
+  }
+  if ( group->publisher != NULL ) {
+    notePublishSale( group->publisher );
+  }
+  leaveGroup( group );
+  return true;
+}
+
+/** 
+ * This function sorts the items in the given group based on input from user.
+ * 
+ * Used in conjunction with qsort(). Only call this on a read view from
+ * openView(), since the live group's lists are indexed by snapshots.
+ * 
+ * @param group the group with the items that will be sorted
+ * @param compare the function that will handle the sorting
+ */
+void sortItems( Group *group, int (* compare) (void const *va, void const *vb ))
+{
+  traceBegin( "sort", NULL );
+  qsort( group->iList, group->iCount, sizeof( Item* ), compare );
+  traceEnd( "sort" );
+}
+
+/** Group being sorted by sortMembers() on this thread */
+static __thread Group const *sorting = NULL;
+
+/** 
+ * This function sorts the members in the given group based on input from user.
+ * 
+ * Used in conjunction with qsort(). Only call this on a read view from
+ * openView(), since the live group's lists are indexed by snapshots.
+ * While it runs, compare can get the group from sortingGroup() to read
+ * member IDs and names.
+ * 
+ * @param group the group with the items that will be sorted
+ * @param compare the function that will handle the sorting
+ */
+void sortMembers( Group *group, int (* compare) (void const *va, void const *vb ))
+{
+  traceBegin( "sort", NULL );
+  sorting = group;
+  qsort( group->mList, group->mCount, sizeof( Member* ), compare );
+  sorting = NULL;
+  traceEnd( "sort" );
+}
+
+/**
+ * Returns the group sortMembers() is sorting on this thread.
+ *
+ * @return the group being sorted, or NULL outside of sortMembers()
+ */
+Group const *sortingGroup()
+{
+  return sorting;
+}
+
+/**
+ * A report row being put in order, with where it started so that rows the
+ * compare function finds equal keep their original order.
+ */
+struct RankedStruct {
+  void *row;
+  int pos;
+};
+typedef struct RankedStruct Ranked;
+
+/**
+ * Compares two ranked rows, by compare and then by original position.
+ *
+ * @param a the first row
+ * @param b the second row
+ * @param compare the report's order, for qsort()
+ * @return negative, zero or positive as a comes before, is or comes after b
+ */
+static int compareRanked( Ranked const *a, Ranked const *b, int (* compare) (void const *va, void const *vb ) )
+{
+  int result = compare( &a->row, &b->row );
+  return result != 0 ? result : a->pos - b->pos;
+}
+
+/**
+ * Swaps two ranked rows.
+ *
+ * @param a the first row
+ * @param b the second row
+ */
+static void swapRanked( Ranked *a, Ranked *b )
+{
+  Ranked temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+/**
+ * Puts the rows that belong at positions from to to - 1 there, in order,
+ * with a quicksort that only goes into the parts of the list holding some
+ * of those positions.
+ *
+ * @param rows the rows
+ * @param lo first position of the part being sorted
+ * @param hi one past its last position
+ * @param compare the report's order, for qsort()
+ * @param from first position wanted
+ * @param to one past the last position wanted
+ */
+static void sortRange( Ranked *rows, int lo, int hi, int (* compare) (void const *va, void const *vb ),
+                       int from, int to )
+{
+  while ( hi - lo > SORT_RANGE_SMALL ) {
+    // median of three as the pivot, moved out of the way to the end
+    int mid = lo + ( hi - lo ) / 2;
+    if ( compareRanked( &rows[ mid ], &rows[ lo ], compare ) < 0 ) {
+      swapRanked( &rows[ mid ], &rows[ lo ] );
+    }
+    if ( compareRanked( &rows[ hi - 1 ], &rows[ lo ], compare ) < 0 ) {
+      swapRanked( &rows[ hi - 1 ], &rows[ lo ] );
+    }
+    if ( compareRanked( &rows[ mid ], &rows[ hi - 1 ], compare ) < 0 ) {
+      swapRanked( &rows[ mid ], &rows[ hi - 1 ] );
+    }
+
+    int store = lo;
+    for ( int i = lo; i < hi - 1; i++ ) {
+      if ( compareRanked( &rows[ i ], &rows[ hi - 1 ], compare ) < 0 ) {
+        swapRanked( &rows[ i ], &rows[ store++ ] );
+      }
+    }
+    swapRanked( &rows[ store ], &rows[ hi - 1 ] );
+
+    bool left = from < store;
+    bool right = to > store + 1;
+    if ( left && right ) {
+      // recurse into the smaller part and loop on the larger, so the stack
+      // stays O(log n) deep even when the pivots are poor
+      if ( store - lo < hi - store - 1 ) {
+        sortRange( rows, lo, store, compare, from, to );
+        lo = store + 1;
+      } else {
+        sortRange( rows, store + 1, hi, compare, from, to );
+        hi = store;
+      }
+    } else if ( left ) {
+      hi = store;
+    } else if ( right ) {
+      lo = store + 1;
+    } else {
+      return;
+    }
+  }
+
+  for ( int i = lo + 1; i < hi; i++ ) {
+    for ( int j = i; j > lo && compareRanked( &rows[ j ], &rows[ j - 1 ], compare ) < 0; j-- ) {
+      swapRanked( &rows[ j ], &rows[ j - 1 ] );
+    }
+  }
+}
+
+/**
+ * Puts the rows of a report on the given page in order, leaving the rest
+ * in no particular order, and works out which rows the page holds.
+ *
+ * @param rows the report's rows
+ * @param count number of rows
+ * @param compare the report's order, for qsort()
+ * @param page the page wanted
+ * @param first set to the first row on the page
+ * @param last set to one past the last row on the page
+ */
+static void sortPage( void **rows, int count, int (* compare) (void const *va, void const *vb ),
+                      Page page, int *first, int *last )
+{
+  *first = page.offset < count ? page.offset : count;
+  *last = page.limit < 0 || page.limit > count - *first ? count : *first + page.limit;
+
+  // rows that compare equal keep their order, so pages agree with the full report
+  if ( *first == *last ) {
+    return;
+  }
+
+  Ranked *ranked = ( Ranked *)malloc( count * sizeof( Ranked ) );
+  for ( int i = 0; i < count; i++ ) {
+    ranked[ i ].row = rows[ i ];
+    ranked[ i ].pos = i;
+  }
+  sortRange( ranked, 0, count, compare, *first, *last );
+  for ( int i = *first; i < *last; i++ ) {
+    rows[ i ] = ranked[ i ].row;
+  }
+  free( ranked );
+}
+
+/** 
+ * This function prints all or some of the items based on test and str from user input. 
+ * 
+ * The matching items are put in order by compare and only the rows on the
+ * page are printed. When the page is only part of the report, the items
+ * before it are never sorted among themselves, only separated from it.
+ * The TOTAL row is for every matching item; with no test it's the group's
+ * own totals, so nothing has to be added up.
+ * 
+ * Only call this on a read view from openView(), since its list is reordered.
+ * 
+ * @param group from which the items will be printed
+ * @param test function to handle determining if an item should be printed or not, or NULL for every item
+ * @param str basis upon which items are or are not printed
+ * @param compare the order the items are printed in, for qsort()
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listItems( Group *group, bool (*test)( Item const *item, char const *str ), char const *str,
+                int (* compare) (void const *va, void const *vb ), Page page, FILE *out )
+{
+  int totalMoneyMade = group->totalSales;
+  int totalNumSold = group->totalSold;
+  Item **matches = group->iList;
+  int matchCount = group->iCount;
+
+  if ( test != NULL ) {
+    traceBegin( "filter", NULL );
+    totalMoneyMade = 0;
+    totalNumSold = 0;
+    matches = ( Item **)malloc( ( group->iCount + 1 ) * sizeof( Item * ) );
+    matchCount = 0;
+    for ( int i = 0; i < group->iCount; i++ ) {
+      if ( test( group->iList[ i ], str ) ) {
+        matches[ matchCount++ ] = group->iList[ i ];
+        totalMoneyMade = totalMoneyMade + ( group->iList[ i ]->numSold * group->iList[ i ]->cost );
+        totalNumSold = totalNumSold + group->iList[ i ]->numSold;
+      }
+    }
+    traceEnd( "filter" );
+  }
+
+  int first = 0;
+  int last = 0;
+  traceBegin( "sort", NULL );
+  sortPage( ( void **) matches, matchCount, compare, page, &first, &last );
+  traceEnd( "sort" );
+
+  traceBegin( "render", NULL );
+  for ( int i = first; i < last; i++ ) {
+    fprintf( out, "%3d %-30s %6d %6d %6d", 
+            matches[ i ]->id, 
+            matches[ i ]->name, 
+            matches[ i ]->cost, 
+            matches[ i ]->numSold, 
+            matches[ i ]->numSold * matches[ i ]->cost );
+    fprintf( out, "\n" );
+  }
+  if ( matches != group->iList ) {
+    free( matches );
+  }
+
+  fprintf( out, "%-41s %6d %6d\n", "TOTAL", totalNumSold, totalMoneyMade  );
+  traceEnd( "render" );
+}
+
+/** 
+ * This function prints all or some of the members based on test and str from user input. 
+ * 
+ * Works like listItems(). While the members are sorted, compare can get
+ * the group from sortingGroup() to read member IDs and names.
+ * 
+ * @param group from which the members will be printed
+ * @param test function to handle determining if an item should be printed or not, or NULL for every member
+ * @param str basis upon which members are or are not printed
+ * @param compare the order the members are printed in, for qsort()
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listMembers( Group *group, bool (*test)( Group const *group, Member const *member, char const *str ),
+                  char const *str, int (* compare) (void const *va, void const *vb ), Page page, FILE *out )
+{
+  int totalMoneyMade = group->totalSales;
+  int totalNumSold = group->totalSold;
+  Member **matches = group->mList;
+  int matchCount = group->mCount;
+
+  if ( test != NULL ) {
+    traceBegin( "filter", NULL );
+    totalMoneyMade = 0;
+    totalNumSold = 0;
+    matches = ( Member **)malloc( ( group->mCount + 1 ) * sizeof( Member * ) );
+    matchCount = 0;
+    for ( int i = 0; i < group->mCount; i++ ) {
+      if ( test( group, group->mList[ i ], str ) ) {
+        matches[ matchCount++ ] = group->mList[ i ];
+        totalMoneyMade = totalMoneyMade + group->mList[ i ]->sales;
+        totalNumSold = totalNumSold + group->mList[ i ]->sold;
+      }
+    }
+    traceEnd( "filter" );
+  }
+
+  int first = 0;
+  int last = 0;
+  traceBegin( "sort", NULL );
+  sorting = group;
+  sortPage( ( void **) matches, matchCount, compare, page, &first, &last );
+  sorting = NULL;
+  traceEnd( "sort" );
+
+  traceBegin( "render", NULL );
+  for ( int i = first; i < last; i++ ) {
+    fprintf( out, "%-8s %-30s %6d %6d", 
+            memberId( group, matches[ i ] ), 
+            memberName( group, matches[ i ] ),
+            matches[ i ]->sold,
+            matches[ i ]->sales );
+    fprintf( out, "\n" );
+  }
+  if ( matches != group->mList ) {
+    free( matches );
+  }
+
+  fprintf( out, "%-39s %6d %6d\n", "TOTAL", totalNumSold, totalMoneyMade  );
+  traceEnd( "render" );
+}
+
+/**
+ * Compares the items of two SaleItems by ID, for qsort().
+ *
+ * @param va void pointer to a SaleItem pointer
+ * @param vb void pointer to a SaleItem pointer
+ * @return negative, zero or positive as va's item ID is less, equal or greater
+ */
+static int compareSaleItemId( void const *va, void const *vb )
+{
+  SaleItem **a = ( SaleItem **) va;
+  SaleItem **b = ( SaleItem **) vb;
+
+  return ( (*a)->itemPtr->id > (*b)->itemPtr->id ) - ( (*a)->itemPtr->id < (*b)->itemPtr->id );
+}
+
+/**
+ * This function prints every item the given member has sold, in order of
+ * item ID, with the member's own count for each item. The TOTAL row is for
+ * every item the member has sold, not just the ones on the page.
+ *
+ * @param member whose sales are printed
+ * @param page which rows to print
+ * @param out stream the report is written to
+ */
+void listSaleItems( Member const *member, Page page, FILE *out )
+{
+  SaleItem **sorted = ( SaleItem **)malloc( ( member->count + 1 ) * sizeof( SaleItem * ) );
+  for ( int i = 0; i < member->count; i++ ) {
+    sorted[ i ] = member->list[ i ];
+  }
+
+  int first = 0;
+  int last = 0;
+  traceBegin( "sort", NULL );
+  sortPage( ( void **) sorted, member->count, compareSaleItemId, page, &first, &last );
+  traceEnd( "sort" );
+
+  traceBegin( "render", NULL );
+  for ( int i = first; i < last; i++ ) {
+    Item const *item = sorted[ i ]->itemPtr;
+    fprintf( out, "%3d %-30s %6d %6d %6d\n",
+             item->id,
+             item->name,
+             item->cost,
+             sorted[ i ]->numSold,
+             sorted[ i ]->numSold * item->cost );
+  }
+  free( sorted );
+
+  fprintf( out, "%-41s %6d %6d\n", "TOTAL", member->sold, member->sales );
+  traceEnd( "render" );
+}
+
+/**
+ * One row of a leaderboard, copied out of the records it ranks so it can
+ * be printed after their locks are released.
+ */
+struct LeaderStruct {
+  int idx;
+  int sold;
+  int score;
+};
+typedef struct LeaderStruct Leader;
+
+/**
+ * Copies the first rows of a ranking onto the end of an array. Must be
+ * called holding the lock that guards the ranking.
+ *
+ * @param ranking the ranking
+ * @param count most rows to copy
+ * @param rows the array, grown if it fills up
+ * @param len number of rows in the array, updated
+ * @param cap capacity of the array, updated
+ */
+static void copyLeaders( Ranking const *ranking, int count, Leader **rows, int *len, int *cap )
+{
+  RankNode const *node = rankedAt( ranking, 0 );
+  for ( int copied = 0; node != NULL && copied < count; node = node->next[ 0 ] ) {
+    if ( *len >= *cap ) {
+      *cap *= 2;
+      *rows = ( Leader *)realloc( *rows, *cap * sizeof( Leader ) );
+    }
+    ( *rows )[ *len ].idx = node->idx;
+    ( *rows )[ *len ].sold = node->sold;
+    ( *rows )[ *len ].score = node->score;
+    ( *len )++;
+    copied++;
+  }
+}
+
+/**
+ * Compares two rows of a seller ranking the way the ranking orders them:
+ * most sold first, then the smaller member index.
+ *
+ * @param va void pointer to a row
+ * @param vb void pointer to a row
+ * @return less than 0 if va comes first, more than 0 if vb does
+ */
+static int compareLeaders( void const *va, void const *vb )
+{
+  Leader const *a = ( Leader const *) va;
+  Leader const *b = ( Leader const *) vb;
+  if ( a->score != b->score ) {
+    return a->score > b->score ? -1 : 1;
+  }
+  return a->idx < b->idx ? -1 : a->idx > b->idx;
+}
+
+/**
+ * Compares two leaderboard rows by the index of the record they rank.
+ *
+ * @param va void pointer to a row
+ * @param vb void pointer to a row
+ * @return less than 0 if va's index is smaller, more than 0 if vb's is
+ */
+static int compareLeaderIdx( void const *va, void const *vb )
+{
+  Leader const *a = ( Leader const *) va;
+  Leader const *b = ( Leader const *) vb;
+  return a->idx < b->idx ? -1 : a->idx > b->idx;
+}
+
+/**
+ * Tells whether one item ranks ahead of another on the top items
+ * leaderboard: the higher score first, then the smaller item ID, then the
+ * one loaded first.
+ *
+ * @param group the live group
+ * @param a one item's row
+ * @param b the other item's row
+ * @return true if a ranks ahead of b
+ */
+static bool leadsItem( Group const *group, Leader const *a, Leader const *b )
+{
+  if ( a->score != b->score ) {
+    return a->score > b->score;
+  }
+  int aId = group->iList[ a->idx ]->id;
+  int bId = group->iList[ b->idx ]->id;
+  return aId != bId ? aId < bId : a->idx < b->idx;
+}
+
+/**
+ * Moves the row at the given place in a heap down until no row below it
+ * ranks behind it, so the row ranking last is always at the top.
+ *
+ * @param group the live group
+ * @param heap the rows
+ * @param len number of rows in the heap
+ * @param at place of the row to move
+ */
+static void siftLeader( Group const *group, Leader *heap, int len, int at )
+{
+  while ( true ) {
+    int last = at;
+    for ( int child = 2 * at + 1; child <= 2 * at + 2 && child < len; child++ ) {
+      if ( leadsItem( group, &heap[ last ], &heap[ child ] ) ) {
+        last = child;
+      }
+    }
+    if ( last == at ) {
+      return;
+    }
+    Leader temp = heap[ at ];
+    heap[ at ] = heap[ last ];
+    heap[ last ] = temp;
+    at = last;
+  }
+}
+
+/**
+ * Adds a row to a heap of the rows ranking best so far, bounded to keep
+ * rows, with the row ranking last at the top. Once the heap is full a row
+ * only goes in if it ranks ahead of that one, which it replaces.
+ *
+ * @param group the live group
+ * @param heap the rows, with room for keep of them
+ * @param len number of rows in the heap, updated
+ * @param keep most rows to keep
+ * @param row the row to add
+ */
+static void keepLeader( Group const *group, Leader *heap, int *len, int keep, Leader row )
+{
+  if ( *len < keep ) {
+    // rebuilt into a heap once it's full
+    heap[ ( *len )++ ] = row;
+    if ( *len == keep ) {
+      for ( int at = keep / 2 - 1; at >= 0; at-- ) {
+        siftLeader( group, heap, *len, at );
+      }
+    }
+  } else if ( keep > 0 && leadsItem( group, &row, &heap[ 0 ] ) ) {
+    heap[ 0 ] = row;
+    siftLeader( group, heap, *len, 0 );
+  }
+}
+
+/**
+ * Makes a row of the top items leaderboard from an item's live count.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param byUnits true to score it by units sold rather than by revenue
+ * @return the row
+ */
+static Leader itemLeader( Group const *group, int idx, bool byUnits )
+{
+  Item const *item = group->iList[ idx ];
+  int sold = __atomic_load_n( &item->numSold, __ATOMIC_RELAXED );
+  return ( Leader ) { idx, sold, byUnits ? sold : sold * item->cost };
+}
+
+/**
+ * Moves an item to its place in the revenue rankings of every shard for
+ * its cost now. Must be called with the write lock held, whenever a
+ * reload changes an item's cost.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ */
+void rescoreItem( Group *group, int idx )
+{
+  int cost = group->iList[ idx ]->cost;
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    ItemRanks *ranks = group->topItems[ i ];
+    if ( idx < ranks->cap && ranks->revenue[ idx ] != NULL ) {
+      RankNode *node = ranks->revenue[ idx ];
+      updateRanked( ranks->byRevenue, node, node->sold, node->sold * cost );
+    }
+  }
+}
+
+/**
+ * Picks the leading rows of the top items leaderboard by merging the
+ * shards' rankings. Every shard is read to the same depth; an item not
+ * among any shard's first rows can have no more than the sum of the
+ * scores at that depth, so once the last row kept scores more than that
+ * no other item can make it. Otherwise the depth is doubled and the
+ * shards read again. Rows hold the items' live totals, not the shards'.
+ *
+ * @param group the live group, on its shared side
+ * @param byUnits true to rank by units sold rather than by revenue
+ * @param keep how many rows are wanted
+ * @param heap set to the rows, as a heap with the row ranking last at the top
+ * @return how many rows there are, or -1 if the page reaches items that
+ *         rank on nothing sold, which only a look at every item can order
+ */
+static int mergeTopItems( Group *group, bool byUnits, int keep, Leader *heap )
+{
+  int cap = INIT_CAPACITY;
+  Leader *rows = ( Leader *)malloc( cap * sizeof( Leader ) );
+  int heapLen = 0;
+  for ( int depth = keep; true; depth *= 2 ) {
+    int len = 0;
+    long long threshold = 0;
+    bool exhausted = true;
+    for ( int i = 0; i < SALE_SHARDS; i++ ) {
+      ItemRanks *ranks = group->topItems[ i ];
+      lockShard( group, i );
+      int start = len;
+      copyLeaders( byUnits ? ranks->byUnits : ranks->byRevenue, depth, &rows, &len, &cap );
+      unlockShard( group, i );
+      if ( len - start == depth ) {
+        threshold += rows[ len - 1 ].score;
+        exhausted = false;
+      }
+    }
+
+    // the same item can lead in more than one shard
+    qsort( rows, len, sizeof( Leader ), compareLeaderIdx );
+    heapLen = 0;
+    for ( int i = 0; i < len; i++ ) {
+      if ( i == 0 || rows[ i ].idx != rows[ i - 1 ].idx ) {
+        keepLeader( group, heap, &heapLen, keep, itemLeader( group, rows[ i ].idx, byUnits ) );
+      }
+    }
+
+    if ( heapLen == keep && heap[ 0 ].score > threshold ) {
+      break;
+    }
+    if ( exhausted ) {
+      heapLen = -1;
+      break;
+    }
+  }
+  free( rows );
+  return heapLen;
+}
+
+/**
+ * Prints the items that have brought in the most, or sold the most units,
+ * best first. Every sale moves its item up the rankings of the shard it
+ * was recorded in, so the leaders are merged from the fronts of the
+ * shards' rankings: each shard is locked in turn just long enough to copy
+ * its first rows, reading deeper only until no item further down any of
+ * them could make the page. Only a page that reaches items with nothing
+ * sold looks at every item. The TOTAL row is for the whole group.
+ *
+ * @param group the live group
+ * @param byUnits true to rank by units sold rather than by revenue
+ * @param count most rows to print
+ * @param page which of the ranked rows to start from, and any further limit
+ * @param out stream the report is written to
+ */
+void listTopItems( Group *group, bool byUnits, int count, Page page, FILE *out )
+{
+  if ( page.limit >= 0 && page.limit < count ) {
+    count = page.limit;
+  }
+
+  // on the shared side, no reload can replace the items being printed
+  enterGroup( group );
+  traceBegin( "lookup", NULL );
+  int keep = count > group->iCount - page.offset ? group->iCount - page.offset : count;
+  keep = keep > 0 ? keep + page.offset : 0;
+  Leader *rows = ( Leader *)malloc( ( keep + 1 ) * sizeof( Leader ) );
+  int heapLen = keep > 0 ? mergeTopItems( group, byUnits, keep, rows ) : 0;
+  if ( heapLen < 0 ) {
+    heapLen = 0;
+    for ( int i = 0; i < group->iCount; i++ ) {
+      keepLeader( group, rows, &heapLen, keep, itemLeader( group, i, byUnits ) );
+    }
+  }
+  traceEnd( "lookup" );
+
+  // taking the last row off the top and putting it at the end, over and
+  // over, leaves the rows best first
+  traceBegin( "sort", NULL );
+  for ( int end = heapLen - 1; end > 0; end-- ) {
+    Leader temp = rows[ 0 ];
+    rows[ 0 ] = rows[ end ];
+    rows[ end ] = temp;
+    siftLeader( group, rows, end, 0 );
+  }
+  traceEnd( "sort" );
+
+  int len = heapLen - page.offset;
+
+  traceBegin( "render", NULL );
+  for ( int i = 0; i < len; i++ ) {
+    Leader const *row = &rows[ page.offset + i ];
+    Item const *item = group->iList[ row->idx ];
+    fprintf( out, "%3d %-30s %6d %6d %6d\n", item->id, item->name, item->cost, row->sold, row->sold * item->cost );
+  }
+  fprintf( out, "%-41s %6d %6d\n", "TOTAL",
+           __atomic_load_n( &group->totalSold, __ATOMIC_RELAXED ),
+           __atomic_load_n( &group->totalSales, __ATOMIC_RELAXED ) );
+  traceEnd( "render" );
+  leaveGroup( group );
+  free( rows );
+}
+
+/**
+ * Prints the members who have sold the most of one item, best first. Each
+ * of the item's seller shards is locked in turn just long enough to copy
+ * the rows up to the end of the page off its ranking, and the copies are
+ * merged, since the rows on the page can come from any shard. The TOTAL
+ * row is for the item.
+ *
+ * @param group the live group
+ * @param itemId ID of the item
+ * @param count most rows to print
+ * @param page which of the ranked rows to start from, and any further limit
+ * @param out stream the report is written to
+ * @return false if there is no such item
+ */
+bool listTopSellers( Group *group, int itemId, int count, Page page, FILE *out )
+{
+  enterGroup( group );
+  traceBegin( "lookup", NULL );
+  int itemIdx = findItem( group, itemId );
+  if ( itemIdx < 0 ) {
+    traceEnd( "lookup" );
+    leaveGroup( group );
+    return false;
+  }
+  if ( page.limit >= 0 && page.limit < count ) {
+    count = page.limit;
+  }
+  // no shard has more rows than there are members
+  int wanted = page.offset < group->mCount && count < group->mCount - page.offset ? page.offset + count : group->mCount;
+
+  Item const *item = group->iList[ itemIdx ];
+  Ranking **sellers = __atomic_load_n( &item->sellers, __ATOMIC_ACQUIRE );
+  int len = 0;
+  int cap = INIT_CAPACITY;
+  Leader *rows = ( Leader *)malloc( cap * sizeof( Leader ) );
+  for ( int i = 0; sellers != NULL && i < SELLER_SHARDS; i++ ) {
+    lockSellers( group, itemIdx, i );
+    copyLeaders( sellers[ i ], wanted, &rows, &len, &cap );
+    unlockSellers( group, itemIdx, i );
+  }
+  traceEnd( "lookup" );
+
+  traceBegin( "sort", NULL );
+  qsort( rows, len, sizeof( Leader ), compareLeaders );
+  traceEnd( "sort" );
+
+  traceBegin( "render", NULL );
+  for ( int i = page.offset; i < len && i - page.offset < count; i++ ) {
+    Member const *member = group->mList[ rows[ i ].idx ];
+    fprintf( out, "%-8s %-30s %6d %6d\n", memberId( group, member ), memberName( group, member ),
+             rows[ i ].sold, rows[ i ].sold * item->cost );
+  }
+  int sold = __atomic_load_n( &item->numSold, __ATOMIC_RELAXED );
+  fprintf( out, "%-39s %6d %6d\n", "TOTAL", sold, sold * item->cost );
+  traceEnd( "render" );
+  leaveGroup( group );
+  free( rows );
+  return true;
+}
+
+/**
+ * Prints the top sellers as estimated by the group's sketch, best first.
+ * Each row shows the most the member can have sold, in sales, and by how
+ * much that can be over, so the true figure is between the two. The TOTAL
+ * row is every sale the sketch has seen.
+ *
+ * @param group the live group, which must keep a sketch
+ * @param count most rows to print
+ * @param page which of the estimated rows to start from, and any further limit
+ * @param out stream the report is written to
+ */
+void listApproxSellers( Group *group, int count, Page page, FILE *out )
+{
+  // on the shared side, no reload can change the members being printed
+  enterGroup( group );
+  SketchCounter *rows = NULL;
+  traceBegin( "lookup", NULL );
+  lockSketch( group );
+  int len = copySketch( group->sketch, &rows );
+  long long total = group->sketch->total;
+  unlockSketch( group );
+  traceEnd( "lookup" );
+
+  traceBegin( "sort", NULL );
+  sortCounters( rows, len );
+  traceEnd( "sort" );
+
+  if ( page.limit >= 0 && page.limit < count ) {
+    count = page.limit;
+  }
+  traceBegin( "render", NULL );
+  for ( int i = page.offset; i < len && i - page.offset < count; i++ ) {
+    Member const *member = group->mList[ rows[ i ].key ];
+    fprintf( out, "%-8s %-30s %6d %6d\n", memberId( group, member ), memberName( group, member ),
+             rows[ i ].count, rows[ i ].error );
+  }
+  fprintf( out, "%-39s %6lld\n", "TOTAL", total );
+  traceEnd( "render" );
+  leaveGroup( group );
+  free( rows );
+}
+
+/**
+ * Compares two sales figures, largest first.
+ *
+ * @param va void pointer to a figure
+ * @param vb void pointer to a figure
+ * @return less than 0 if va comes first, more than 0 if vb does
+ */
+static int compareSalesDown( void const *va, void const *vb )
+{
+  int a = *( int const *) va;
+  int b = *( int const *) vb;
+  return a > b ? -1 : a < b;
+}
+
+/**
+ * Prints how well the group's sketch finds the top sellers, checked
+ * against every member's exact sales: how many of its top count are in
+ * the exact top count, how many it can vouch for, and how far its
+ * estimates are off. The sketch values a sale at the cost when it was
+ * made, so after a reload changes costs the two drift apart.
+ *
+ * @param group the live group, which must keep a sketch
+ * @param count how many top sellers to check
+ * @param out stream the report is written to
+ */
+void printSketchAccuracy( Group *group, int count, FILE *out )
+{
+  enterGroup( group );
+  SketchCounter *rows = NULL;
+  traceBegin( "lookup", NULL );
+  lockSketch( group );
+  int len = copySketch( group->sketch, &rows );
+  int capacity = group->sketch->capacity;
+  long bytes = sketchBytes( group->sketch );
+  unlockSketch( group );
+
+  // the exact sales of every member, by index and largest first
+  int *exact = ( int *)malloc( ( group->mCount + 1 ) * sizeof( int ) );
+  int *sorted = ( int *)malloc( ( group->mCount + 1 ) * sizeof( int ) );
+  for ( int i = 0; i < group->mCount; i++ ) {
+    // a lazily loaded member that hasn't been made yet has sold nothing
+    Member const *member = __atomic_load_n( &group->mList[ i ], __ATOMIC_ACQUIRE );
+    lockMember( group, i );
+    exact[ i ] = member == NULL ? 0 : member->sales;
+    unlockMember( group, i );
+    sorted[ i ] = exact[ i ];
+  }
+  traceEnd( "lookup" );
+
+  traceBegin( "sort", NULL );
+  sortCounters( rows, len );
+  qsort( sorted, group->mCount, sizeof( int ), compareSalesDown );
+  traceEnd( "sort" );
+
+  // a member is in the exact top count if it sold at least as much as the last one in it
+  int exactTop = count < group->mCount ? count : group->mCount;
+  int least = exactTop > 0 ? sorted[ exactTop - 1 ] : 0;
+
+  // nobody outside the sketch's top count can have sold more than this
+  int next = 0;
+  if ( len > count ) {
+    next = rows[ count ].count;
+  } else if ( len == capacity && len > 0 ) {
+    next = rows[ len - 1 ].count;
+  }
+
+  int top = count < len ? count : len;
+  int found = 0;
+  int sure = 0;
+  int largest = 0;
+  int bound = 0;
+  long long offBy = 0;
+  for ( int i = 0; i < top; i++ ) {
+    int real = exact[ rows[ i ].key ];
+    int off = rows[ i ].count - real;
+    found += real >= least;
+    sure += rows[ i ].count - rows[ i ].error >= next;
+    largest = off > largest ? off : largest;
+    bound = rows[ i ].error > bound ? rows[ i ].error : bound;
+    offBy += off;
+  }
+
+  fprintf( out, "Sketch uses %d of %d counters, %ld bytes\n", len, capacity, bytes );
+  fprintf( out, "Found %d of the exact top %d\n", found, exactTop );
+  fprintf( out, "Guaranteed %d of the top %d\n", sure, top );
+  fprintf( out, "Largest error %d, at most %d\n", largest, bound );
+  fprintf( out, "Mean error %.2f\n", top > 0 ? ( double ) offBy / top : 0.0 );
+  leaveGroup( group );
+  free( exact );
+  free( sorted );
+  free( rows );
+}
@@ -0,0 +1,811 @@
+/**
+ * @file history.c
+ * @author Luke Early
+ * Source file for the append-only sales history.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+/** Most bytes one varint takes */
+#define VARINT_MAX 10
+
+/** Most bytes the columns of one block can take */
+#define BLOCK_BYTES_MAX ( HISTORY_BLOCK_ROWS * VARINT_MAX * COLUMN_COUNT )
+
+/** Serial number of the last history opened */
+static unsigned long lastSerial = 0;
+
+/** The calling thread's stage, and the serial number of the history it's in */
+static __thread HistoryStage *threadStage = NULL;
+static __thread unsigned long threadSerial = 0;
+
+/**
+ * Maps a signed number to an unsigned one with small magnitudes staying
+ * small, so negative deltas still make short varints.
+ *
+ * @param value the signed number
+ * @return the zigzag encoded number
+ */
+static unsigned long long zigzag( long long value )
+{
+  return ( ( unsigned long long ) value << 1 ) ^ ( unsigned long long ) ( value >> 63 );
+}
+
+/**
+ * Undoes zigzag().
+ *
+ * @param value the zigzag encoded number
+ * @return the signed number
+ */
+static long long unzigzag( unsigned long long value )
+{
+  return ( long long ) ( value >> 1 ) ^ -( long long ) ( value & 1 );
+}
+
+/**
+ * Writes a number as a varint, seven bits to a byte, low bits first.
+ *
+ * @param buf where to write it
+ * @param value the number
+ * @return number of bytes written
+ */
+static int putVarint( unsigned char *buf, unsigned long long value )
+{
+  int len = 0;
+  while ( value >= 0x80 ) {
+    buf[ len++ ] = ( unsigned char ) value | 0x80;
+    value >>= 7;
+  }
+  buf[ len++ ] = ( unsigned char ) value;
+  return len;
+}
+
+/**
+ * Reads a varint.
+ *
+ * @param pos where it starts, moved past it
+ * @return the number
+ */
+static unsigned long long getVarint( unsigned char const **pos )
+{
+  unsigned char const *p = *pos;
+  unsigned long long value = *p & 0x7f;
+  int shift = 7;
+  while ( *p++ & 0x80 ) {
+    value |= ( unsigned long long ) ( *p & 0x7f ) << shift;
+    shift += 7;
+  }
+  *pos = p;
+  return value;
+}
+
+/**
+ * Reads exactly len bytes from the given offset of a file.
+ *
+ * @param fd the file
+ * @param buf where the bytes go
+ * @param len how many to read
+ * @param offset where in the file to start
+ * @return false if the file ends first or can't be read
+ */
+static bool readAll( int fd, void *buf, size_t len, long offset )
+{
+  char *pos = ( char *)buf;
+  while ( len > 0 ) {
+    ssize_t got = pread( fd, pos, len, offset );
+    if ( got < 0 && errno == EINTR ) {
+      continue;
+    }
+    if ( got <= 0 ) {
+      return false;
+    }
+    pos += got;
+    len -= got;
+    offset += got;
+  }
+  return true;
+}
+
+/**
+ * Writes exactly len bytes at the given offset of a file.
+ *
+ * @param fd the file
+ * @param buf the bytes
+ * @param len how many to write
+ * @param offset where in the file to write them
+ * @return false if the write fails
+ */
+static bool writeAll( int fd, void const *buf, size_t len, long offset )
+{
+  char const *pos = ( char const *)buf;
+  while ( len > 0 ) {
+    ssize_t put = pwrite( fd, pos, len, offset );
+    if ( put < 0 && errno == EINTR ) {
+      continue;
+    }
+    if ( put <= 0 ) {
+      return false;
+    }
+    pos += put;
+    len -= put;
+    offset += put;
+  }
+  return true;
+}
+
+/**
+ * Returns the total size of a block's columns.
+ *
+ * @param header the block's header
+ * @return bytes of column data after the block's member IDs
+ */
+static long columnBytes( BlockHeader const *header )
+{
+  long total = 0;
+  for ( int c = 0; c < COLUMN_COUNT; c++ ) {
+    total += header->bytes[ c ];
+  }
+  return total;
+}
+
+/**
+ * Adds a block to the index. Readers may be scanning the index, so the
+ * summary is filled in before the new count is published. Must be called
+ * with the history's lock held.
+ *
+ * @param history the history
+ * @param offset where the block's header is in the file
+ * @param header the block's header
+ */
+static void addBlock( History *history, long offset, BlockHeader const *header )
+{
+  int count = history->blockCount;
+  BlockInfo **page = &history->pages[ count >> HISTORY_PAGE_SHIFT ];
+  if ( *page == NULL ) {
+    *page = ( BlockInfo *)malloc( HISTORY_PAGE_SIZE * sizeof( BlockInfo ) );
+  }
+  ( *page )[ count & ( HISTORY_PAGE_SIZE - 1 ) ].offset = offset;
+  ( *page )[ count & ( HISTORY_PAGE_SIZE - 1 ) ].header = *header;
+  __atomic_store_n( &history->blockCount, count + 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Reads the member IDs stored in a block into the history's pool. Each
+ * one must get the next code, and every member in the block must have one.
+ *
+ * @param history the history being opened
+ * @param offset where the block's header is in the file
+ * @param header the block's header
+ * @return false if the IDs can't be read or don't follow on from the ones before
+ */
+static bool readIds( History *history, long offset, BlockHeader const *header )
+{
+  if ( header->newIds > 0 && header->firstId != history->ids->count ) {
+    return false;
+  }
+
+  // zeroed past the end, so a bad length can't run a varint off it
+  unsigned char *buf = ( unsigned char *)calloc( header->idBytes + VARINT_MAX + 1, 1 );
+  bool valid = readAll( history->fd, buf, header->idBytes, offset + sizeof( BlockHeader ) );
+  unsigned char const *pos = buf;
+  unsigned char const *end = buf + header->idBytes;
+  for ( unsigned int i = 0; valid && i < header->newIds; i++ ) {
+    unsigned long long len = pos < end ? getVarint( &pos ) : 0;
+    if ( len == 0 || len > ( unsigned long long ) ( end - pos ) ) {
+      valid = false;
+    } else {
+      char *id = ( char *)malloc( len + 1 );
+      memcpy( id, pos, len );
+      id[ len ] = '\0';
+      pos += len;
+      valid = internString( history->ids, id ) == header->firstId + i;
+      free( id );
+    }
+  }
+  free( buf );
+  return valid && pos == end && header->maxMember < history->ids->count;
+}
+
+/**
+ * Frees a history whose writer isn't running.
+ *
+ * @param history the history to free
+ */
+static void freeHistory( History *history )
+{
+  close( history->fd );
+  for ( int p = 0; p < HISTORY_MAX_PAGES && history->pages[ p ] != NULL; p++ ) {
+    free( history->pages[ p ] );
+  }
+  while ( history->stages != NULL ) {
+    HistoryStage *next = history->stages->next;
+    pthread_mutex_destroy( &history->stages->lock );
+    free( history->stages );
+    history->stages = next;
+  }
+  freePool( history->ids );
+  pthread_cond_destroy( &history->room );
+  pthread_cond_destroy( &history->wake );
+  pthread_mutex_destroy( &history->lock );
+  free( history );
+}
+
+/**
+ * Encodes a buffer of sales as a block and appends it to the file, along
+ * with the IDs of any members the file hasn't stored yet. Only called by
+ * the writer, without the history's lock.
+ *
+ * @param history the history
+ * @param rows the sales
+ * @param header set to the block's header
+ * @return false if the block couldn't be written
+ */
+static bool writeBlock( History *history, HistoryRows const *rows, BlockHeader *header )
+{
+  int count = rows->count;
+  memset( header, 0, sizeof( BlockHeader ) );
+  header->magic = HISTORY_MAGIC;
+  header->rows = count;
+  header->minTime = header->maxTime = rows->times[ 0 ];
+  header->minMember = header->maxMember = rows->members[ 0 ];
+  header->minItem = header->maxItem = rows->items[ 0 ];
+  for ( int r = 1; r < count; r++ ) {
+    header->minTime = rows->times[ r ] < header->minTime ? rows->times[ r ] : header->minTime;
+    header->maxTime = rows->times[ r ] > header->maxTime ? rows->times[ r ] : header->maxTime;
+    header->minMember = rows->members[ r ] < header->minMember ? rows->members[ r ] : header->minMember;
+    header->maxMember = rows->members[ r ] > header->maxMember ? rows->members[ r ] : header->maxMember;
+    header->minItem = rows->items[ r ] < header->minItem ? rows->items[ r ] : header->minItem;
+    header->maxItem = rows->items[ r ] > header->maxItem ? rows->items[ r ] : header->maxItem;
+  }
+
+  // codes are handed out in order, so the new ones run from the first not
+  // stored yet up to the largest in the block
+  unsigned int firstId = history->writtenIds;
+  unsigned int newIds = header->maxMember >= firstId ? header->maxMember - firstId + 1 : 0;
+  long idBytes = 0;
+  for ( unsigned int i = 0; i < newIds; i++ ) {
+    idBytes += VARINT_MAX + strlen( poolString( history->ids, firstId + i ) );
+  }
+
+  unsigned char *buf = ( unsigned char *)malloc( idBytes + BLOCK_BYTES_MAX );
+  int len = 0;
+  for ( unsigned int i = 0; i < newIds; i++ ) {
+    char const *id = poolString( history->ids, firstId + i );
+    int idLen = strlen( id );
+    len += putVarint( buf + len, idLen );
+    memcpy( buf + len, id, idLen );
+    len += idLen;
+  }
+  header->firstId = newIds > 0 ? firstId : 0;
+  header->newIds = newIds;
+  header->idBytes = len;
+
+  // times and members are stored as the difference from the one before
+  int start = len;
+  long long prevTime = header->minTime;
+  for ( int r = 0; r < count; r++ ) {
+    len += putVarint( buf + len, zigzag( rows->times[ r ] - prevTime ) );
+    prevTime = rows->times[ r ];
+  }
+  header->bytes[ COLUMN_TIME ] = len - start;
+
+  start = len;
+  long long prevMember = 0;
+  for ( int r = 0; r < count; r++ ) {
+    len += putVarint( buf + len, zigzag( ( long long ) rows->members[ r ] - prevMember ) );
+    prevMember = rows->members[ r ];
+  }
+  header->bytes[ COLUMN_MEMBER ] = len - start;
+
+  start = len;
+  for ( int r = 0; r < count; r++ ) {
+    len += putVarint( buf + len, ( unsigned int ) rows->items[ r ] );
+  }
+  header->bytes[ COLUMN_ITEM ] = len - start;
+
+  start = len;
+  for ( int r = 0; r < count; r++ ) {
+    len += putVarint( buf + len, ( unsigned int ) rows->qtys[ r ] );
+  }
+  header->bytes[ COLUMN_QTY ] = len - start;
+
+  // a block that isn't written leaves its new IDs for the next one
+  bool written = writeAll( history->fd, header, sizeof( BlockHeader ), history->end )
+                 && writeAll( history->fd, buf, len, history->end + sizeof( BlockHeader ) );
+  if ( written ) {
+    history->writtenIds = firstId + newIds;
+  } else {
+    fprintf( stderr, "Can't write history file\n" );
+  }
+  free( buf );
+  return written;
+}
+
+/**
+ * Moves as many of a stage's rows as there's room for into the block
+ * being collected, waking the writer if that fills it. Must be called
+ * holding the history's lock and then the stage's.
+ *
+ * @param history the history
+ * @param stage the stage
+ */
+static void takeStage( History *history, HistoryStage *stage )
+{
+  HistoryRows *rows = history->open;
+  int moved = HISTORY_BLOCK_ROWS - rows->count < stage->count ? HISTORY_BLOCK_ROWS - rows->count : stage->count;
+  int left = stage->count - moved;
+  memcpy( rows->times + rows->count, stage->times, moved * sizeof( long long ) );
+  memcpy( rows->members + rows->count, stage->members, moved * sizeof( unsigned int ) );
+  memcpy( rows->items + rows->count, stage->items, moved * sizeof( int ) );
+  memcpy( rows->qtys + rows->count, stage->qtys, moved * sizeof( int ) );
+  memmove( stage->times, stage->times + moved, left * sizeof( long long ) );
+  memmove( stage->members, stage->members + moved, left * sizeof( unsigned int ) );
+  memmove( stage->items, stage->items + moved, left * sizeof( int ) );
+  memmove( stage->qtys, stage->qtys + moved, left * sizeof( int ) );
+  rows->count += moved;
+  stage->count = left;
+
+  if ( moved > 0 && rows->count == HISTORY_BLOCK_ROWS ) {
+    pthread_cond_signal( &history->wake );
+  }
+}
+
+/**
+ * Moves the rows of every thread's stage into the block being collected,
+ * as far as there's room. Must be called with the history's lock held.
+ *
+ * @param history the history
+ */
+static void collectStages( History *history )
+{
+  for ( HistoryStage *stage = history->stages; stage != NULL; stage = stage->next ) {
+    pthread_mutex_lock( &stage->lock );
+    takeStage( history, stage );
+    pthread_mutex_unlock( &stage->lock );
+  }
+}
+
+/**
+ * Tells whether any thread's stage holds a sale. Must be called with the
+ * history's lock held.
+ *
+ * @param history the history
+ * @return true if some stage isn't empty
+ */
+static bool anyStaged( History *history )
+{
+  bool staged = false;
+  for ( HistoryStage *stage = history->stages; stage != NULL && !staged; stage = stage->next ) {
+    pthread_mutex_lock( &stage->lock );
+    staged = stage->count > 0;
+    pthread_mutex_unlock( &stage->lock );
+  }
+  return staged;
+}
+
+/**
+ * Body of the history's writer: sleeps until a sale is added, gives it
+ * flushMs milliseconds to be joined by more (or until a block's worth is
+ * collected), then takes what every thread has staged, and writes the
+ * buffer out as a block while sales go into the other one. Once stopped,
+ * it writes what's left.
+ *
+ * @param arg the history
+ * @return NULL
+ */
+static void *historyLoop( void *arg )
+{
+  History *history = ( History *) arg;
+  pthread_mutex_lock( &history->lock );
+  for ( ;; ) {
+    // idle is set before the stages are looked at, so a sale staged after
+    // they were found empty sees it and wakes the writer
+    while ( !history->stopping && history->open->count == 0 ) {
+      __atomic_store_n( &history->idle, true, __ATOMIC_SEQ_CST );
+      if ( anyStaged( history ) ) {
+        break;
+      }
+      pthread_cond_wait( &history->wake, &history->lock );
+    }
+    __atomic_store_n( &history->idle, false, __ATOMIC_SEQ_CST );
+
+    struct timespec until;
+    clock_gettime( CLOCK_REALTIME, &until );
+    until.tv_sec += history->flushMs / 1000;
+    until.tv_nsec += ( history->flushMs % 1000 ) * 1000000L;
+    if ( until.tv_nsec >= 1000000000L ) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+    while ( !history->stopping && history->open->count < HISTORY_BLOCK_ROWS ) {
+      if ( pthread_cond_timedwait( &history->wake, &history->lock, &until ) == ETIMEDOUT ) {
+        break;
+      }
+    }
+    collectStages( history );
+    if ( history->open->count == 0 ) {
+      if ( history->stopping ) {
+        break;
+      }
+      continue;
+    }
+
+    // the other buffer was emptied when its block was written
+    HistoryRows *rows = history->open;
+    history->open = rows == &history->buffers[ 0 ] ? &history->buffers[ 1 ] : &history->buffers[ 0 ];
+    history->writing = rows;
+    pthread_cond_broadcast( &history->room );
+    pthread_mutex_unlock( &history->lock );
+
+    BlockHeader header;
+    long offset = history->end;
+    bool written = writeBlock( history, rows, &header );
+
+    // scans see the sales either in the buffer or in the block, never both
+    pthread_mutex_lock( &history->lock );
+    if ( written ) {
+      addBlock( history, offset, &header );
+      history->end += sizeof( BlockHeader ) + header.idBytes + columnBytes( &header );
+    }
+    history->writing = NULL;
+    rows->count = 0;
+  }
+  pthread_mutex_unlock( &history->lock );
+  return NULL;
+}
+
+/**
+ * Opens the history file with the given name, creating it if it doesn't
+ * exist, and starts the thread that writes its blocks. The headers and
+ * member IDs of the blocks already in it are read into memory; a block
+ * left half written by a crash is cut off.
+ *
+ * @param filename name of the history file
+ * @param flushMs most milliseconds a sale waits before its block is written
+ * @return the history, or NULL if the file can't be opened or isn't a history file
+ */
+History *openHistory( char const *filename, int flushMs )
+{
+  int fd = open( filename, O_RDWR | O_CREAT, 0644 );
+  struct stat info;
+  if ( fd < 0 || fstat( fd, &info ) != 0 ) {
+    return NULL;
+  }
+
+  History *history = ( History *)calloc( 1, sizeof( History ) );
+  pthread_mutex_init( &history->lock, NULL );
+  pthread_cond_init( &history->wake, NULL );
+  pthread_cond_init( &history->room, NULL );
+  history->fd = fd;
+  history->ids = makePool();
+  history->flushMs = flushMs;
+  history->open = &history->buffers[ 0 ];
+  history->serial = __atomic_add_fetch( &lastSerial, 1, __ATOMIC_RELAXED );
+
+  long offset = 0;
+  unsigned int stored = 0;
+  BlockHeader header;
+  while ( readAll( fd, &header, sizeof( header ), offset ) ) {
+    long bytes = ( long ) header.idBytes + columnBytes( &header );
+    bool valid = header.magic == HISTORY_MAGIC && header.rows > 0 && header.rows <= HISTORY_BLOCK_ROWS
+                 && columnBytes( &header ) <= BLOCK_BYTES_MAX
+                 && offset + ( long ) sizeof( header ) + bytes <= info.st_size
+                 && readIds( history, offset, &header );
+    if ( !valid ) {
+      break;
+    }
+    addBlock( history, offset, &header );
+    offset += sizeof( header ) + bytes;
+    stored = history->ids->count;
+  }
+
+  // something that isn't a history at all is left alone
+  if ( ( offset == 0 && info.st_size > 0 ) || ( offset < info.st_size && ftruncate( fd, offset ) != 0 ) ) {
+    freeHistory( history );
+    return NULL;
+  }
+
+  // IDs read from a block that was cut off stay in the pool, and are stored again
+  history->end = offset;
+  history->writtenIds = stored;
+  if ( pthread_create( &history->thread, NULL, historyLoop, history ) != 0 ) {
+    freeHistory( history );
+    return NULL;
+  }
+  return history;
+}
+
+/**
+ * Stops the writer once it has written out every sale not in a block yet,
+ * closes the file and frees the history.
+ *
+ * @param history the history to close
+ */
+void closeHistory( History *history )
+{
+  pthread_mutex_lock( &history->lock );
+  history->stopping = true;
+  pthread_cond_signal( &history->wake );
+  pthread_mutex_unlock( &history->lock );
+  pthread_join( history->thread, NULL );
+  freeHistory( history );
+}
+
+/**
+ * Finds the calling thread's stage of the history, adding one the first
+ * time the thread adds a sale. A thread that has ended leaves its stage
+ * for the next one given the same thread ID.
+ *
+ * @param history the history
+ * @return the thread's stage
+ */
+static HistoryStage *findStage( History *history )
+{
+  if ( threadSerial == history->serial ) {
+    return threadStage;
+  }
+
+  pthread_mutex_lock( &history->lock );
+  HistoryStage *stage = history->stages;
+  while ( stage != NULL && !pthread_equal( stage->owner, pthread_self() ) ) {
+    stage = stage->next;
+  }
+  if ( stage == NULL ) {
+    stage = ( HistoryStage *)calloc( 1, sizeof( HistoryStage ) );
+    pthread_mutex_init( &stage->lock, NULL );
+    stage->owner = pthread_self();
+    stage->next = history->stages;
+    history->stages = stage;
+  }
+  pthread_mutex_unlock( &history->lock );
+
+  threadStage = stage;
+  threadSerial = history->serial;
+  return stage;
+}
+
+/**
+ * Hands a full stage's rows to the block being collected, first waiting
+ * for room if sales have filled a block while the writer is still writing
+ * the one before.
+ *
+ * @param history the history
+ * @param stage the calling thread's stage, whose lock isn't held
+ */
+static void handStage( History *history, HistoryStage *stage )
+{
+  pthread_mutex_lock( &history->lock );
+  while ( history->open->count == HISTORY_BLOCK_ROWS ) {
+    pthread_cond_wait( &history->room, &history->lock );
+  }
+  pthread_mutex_lock( &stage->lock );
+  takeStage( history, stage );
+  pthread_mutex_unlock( &stage->lock );
+  pthread_mutex_unlock( &history->lock );
+}
+
+/**
+ * Adds one sale to the calling thread's stage of the history. Only when
+ * the stage is full is the history's lock taken, to hand its rows to the
+ * block being collected, and only then does it wait if sales have filled
+ * a block while the writer is still writing the one before. An idle
+ * writer is woken for the first sale.
+ *
+ * @param history the history
+ * @param time when the sale happened, in seconds since the epoch
+ * @param member ID of the member who made it
+ * @param item ID of the item sold
+ * @param qty how many were sold
+ */
+void addHistory( History *history, long long time, char const *member, int item, int qty )
+{
+  // most sales are by members the history has seen, found without a lock
+  StrHandle code = findString( history->ids, member );
+  if ( code == NO_HANDLE ) {
+    code = internString( history->ids, member );
+  }
+
+  // the history's lock comes before a stage's, so a full stage is let go first
+  HistoryStage *stage = findStage( history );
+  pthread_mutex_lock( &stage->lock );
+  while ( stage->count == HISTORY_STAGE_ROWS ) {
+    pthread_mutex_unlock( &stage->lock );
+    handStage( history, stage );
+    pthread_mutex_lock( &stage->lock );
+  }
+  int r = stage->count++;
+  stage->times[ r ] = time;
+  stage->members[ r ] = code;
+  stage->items[ r ] = item;
+  stage->qtys[ r ] = qty;
+  pthread_mutex_unlock( &stage->lock );
+
+  // the writer marks itself idle before it looks for staged sales, so
+  // either it saw this one or this sees it's idle
+  if ( __atomic_load_n( &history->idle, __ATOMIC_SEQ_CST ) ) {
+    pthread_mutex_lock( &history->lock );
+    if ( __atomic_load_n( &history->idle, __ATOMIC_SEQ_CST ) ) {
+      __atomic_store_n( &history->idle, false, __ATOMIC_SEQ_CST );
+      pthread_cond_signal( &history->wake );
+    }
+    pthread_mutex_unlock( &history->lock );
+  }
+}
+
+/**
+ * Finds the code a member's sales are stored under.
+ *
+ * @param history the history
+ * @param member ID of the member
+ * @return the member's code, or NO_HANDLE if the history has no sales by them
+ */
+StrHandle historyMember( History *history, char const *member )
+{
+  return findString( history->ids, member );
+}
+
+/**
+ * Tells whether a block's header rules out any match for a scan.
+ *
+ * @param header the block's header
+ * @param column COLUMN_ITEM or COLUMN_MEMBER
+ * @param value the item ID or member code looked for
+ * @param from earliest time looked for
+ * @param to latest time looked for
+ * @return true if the block can be skipped
+ */
+static bool canSkip( BlockHeader const *header, int column, long long value, long long from, long long to )
+{
+  if ( header->maxTime < from || header->minTime > to ) {
+    return true;
+  }
+  if ( column == COLUMN_ITEM ) {
+    return value < header->minItem || value > header->maxItem;
+  }
+  return value < header->minMember || value > header->maxMember;
+}
+
+/**
+ * Decodes the columns of one block and adds up its matching sales.
+ *
+ * @param header the block's header
+ * @param buf the block's columns
+ * @param column COLUMN_ITEM or COLUMN_MEMBER
+ * @param value the item ID or member code looked for
+ * @param from earliest time looked for
+ * @param to latest time looked for
+ * @param totals where the matches are added
+ */
+static void scanBlock( BlockHeader const *header, unsigned char const *buf, int column, long long value,
+                       long long from, long long to, HistoryTotals *totals )
+{
+  int rows = header->rows;
+  long long times[ HISTORY_BLOCK_ROWS ];
+  long long keys[ HISTORY_BLOCK_ROWS ];
+
+  // times only need decoding if the block isn't wholly inside the range
+  bool checkTimes = header->minTime < from || header->maxTime > to;
+  unsigned char const *pos = buf;
+  long long prev = header->minTime;
+  for ( int r = 0; checkTimes && r < rows; r++ ) {
+    prev += unzigzag( getVarint( &pos ) );
+    times[ r ] = prev;
+  }
+
+  if ( column == COLUMN_MEMBER ) {
+    pos = buf + header->bytes[ COLUMN_TIME ];
+    prev = 0;
+    for ( int r = 0; r < rows; r++ ) {
+      prev += unzigzag( getVarint( &pos ) );
+      keys[ r ] = prev;
+    }
+  } else {
+    pos = buf + header->bytes[ COLUMN_TIME ] + header->bytes[ COLUMN_MEMBER ];
+    for ( int r = 0; r < rows; r++ ) {
+      keys[ r ] = getVarint( &pos );
+    }
+  }
+
+  pos = buf + header->bytes[ COLUMN_TIME ] + header->bytes[ COLUMN_MEMBER ] + header->bytes[ COLUMN_ITEM ];
+  for ( int r = 0; r < rows; r++ ) {
+    long long qty = getVarint( &pos );
+    if ( keys[ r ] == value && ( !checkTimes || ( times[ r ] >= from && times[ r ] <= to ) ) ) {
+      totals->sales++;
+      totals->sold += qty;
+    }
+  }
+}
+
+/**
+ * Adds up the matching sales among rows not written to a block yet.
+ *
+ * @param times when each sale happened
+ * @param members who made each one
+ * @param items what was sold
+ * @param qtys how many were sold
+ * @param count how many rows there are
+ * @param column COLUMN_ITEM or COLUMN_MEMBER
+ * @param value the item ID or member code looked for
+ * @param from earliest time looked for
+ * @param to latest time looked for
+ * @param totals where the matches are added
+ */
+static void scanRows( long long const *times, unsigned int const *members, int const *items, int const *qtys,
+                      int count, int column, long long value, long long from, long long to, HistoryTotals *totals )
+{
+  for ( int r = 0; r < count; r++ ) {
+    long long key = column == COLUMN_ITEM ? items[ r ] : members[ r ];
+    if ( key == value && times[ r ] >= from && times[ r ] <= to ) {
+      totals->sales++;
+      totals->sold += qtys[ r ];
+    }
+  }
+}
+
+/**
+ * Totals up the sales of one item, or by one member, in a range of times.
+ *
+ * @param history the history
+ * @param column COLUMN_ITEM or COLUMN_MEMBER
+ * @param value the item ID or member code to look for
+ * @param from earliest time to include
+ * @param to latest time to include
+ * @param totals set to what was found
+ */
+void scanHistory( History *history, int column, long long value, long long from, long long to,
+                  HistoryTotals *totals )
+{
+  memset( totals, 0, sizeof( HistoryTotals ) );
+
+  // sales not in a block yet count as one more block for the buffer being
+  // written, and one for the buffer being collected along with the stages
+  // that will go into it; taking the block count at the same time means
+  // every sale is in exactly one of them
+  pthread_mutex_lock( &history->lock );
+  int count = history->blockCount;
+  HistoryRows const *rows = history->open;
+  int pending = rows->count;
+  scanRows( rows->times, rows->members, rows->items, rows->qtys, rows->count, column, value, from, to, totals );
+  for ( HistoryStage *stage = history->stages; stage != NULL; stage = stage->next ) {
+    pthread_mutex_lock( &stage->lock );
+    pending += stage->count;
+    scanRows( stage->times, stage->members, stage->items, stage->qtys, stage->count, column, value, from, to,
+              totals );
+    pthread_mutex_unlock( &stage->lock );
+  }
+  if ( pending > 0 ) {
+    totals->blocks++;
+    totals->scanned++;
+  }
+  rows = history->writing;
+  if ( rows != NULL ) {
+    scanRows( rows->times, rows->members, rows->items, rows->qtys, rows->count, column, value, from, to, totals );
+    totals->blocks++;
+    totals->scanned++;
+  }
+  pthread_mutex_unlock( &history->lock );
+
+  // written blocks never change, so they're scanned without the lock
+  totals->blocks += count;
+  unsigned char *buf = ( unsigned char *)malloc( BLOCK_BYTES_MAX );
+  for ( int b = 0; b < count; b++ ) {
+    BlockInfo const *info = &history->pages[ b >> HISTORY_PAGE_SHIFT ][ b & ( HISTORY_PAGE_SIZE - 1 ) ];
+    if ( canSkip( &info->header, column, value, from, to ) ) {
+      continue;
+    }
+    long start = info->offset + sizeof( BlockHeader ) + info->header.idBytes;
+    if ( readAll( history->fd, buf, columnBytes( &info->header ), start ) ) {
+      scanBlock( &info->header, buf, column, value, from, to, totals );
+      totals->scanned++;
+    }
+  }
+  free( buf );
+}
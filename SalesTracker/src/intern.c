@@ -0,0 +1,337 @@
+/**
+ * @file intern.c
+ * @author Luke Early
+ * Source file for the string interning pool.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+/** Starting number of hash table slots */
+#define INIT_TABLE_SIZE 1024
+
+/** How many strings ahead internStrings() fetches table slots */
+#define PREFETCH_AHEAD 16
+
+/** Offset of a reserved handle that has no string yet */
+#define NO_OFFSET 0xffffffffu
+
+/**
+ * Makes an empty hash table.
+ *
+ * @param size number of slots, a power of two
+ * @return the new table
+ */
+static StrTable *makeTable( unsigned int size )
+{
+  StrTable *table = ( StrTable *)calloc( 1, sizeof( StrTable ) + size * sizeof( unsigned int ) );
+  table->size = size;
+  return table;
+}
+
+/**
+ * Makes a new, empty string pool.
+ *
+ * @return pointer to the new pool
+ */
+StrPool *makePool()
+{
+  StrPool *pool = ( StrPool *)calloc( 1, sizeof( StrPool ) );
+  pthread_mutex_init( &pool->lock, NULL );
+  pool->table = makeTable( INIT_TABLE_SIZE );
+  pool->blockUsed = POOL_BLOCK_SIZE; // first string starts a block
+  return pool;
+}
+
+/**
+ * Frees a string pool and every string in it.
+ *
+ * @param pool the pool to free
+ */
+void freePool( StrPool *pool )
+{
+  for ( int i = 0; i < pool->blockCount; i++ ) {
+    free( pool->blocks[ i ] );
+  }
+  for ( int i = 0; i < POOL_MAX_PAGES && pool->pages[ i ] != NULL; i++ ) {
+    free( pool->pages[ i ] );
+  }
+  for ( int i = 0; i < pool->oldTableCount; i++ ) {
+    free( pool->oldTables[ i ] );
+  }
+  free( pool->table );
+  pthread_mutex_destroy( &pool->lock );
+  free( pool );
+}
+
+/**
+ * Hashes a string.
+ *
+ * @param str the string
+ * @return FNV-1a hash of the string
+ */
+static unsigned int hashString( char const *str )
+{
+  unsigned int hash = 2166136261u;
+  for ( ; *str != '\0'; str++ ) {
+    hash = ( hash ^ ( unsigned char ) *str ) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Returns the text of the string with the given handle.
+ *
+ * @param pool the pool the handle came from
+ * @param handle the handle
+ * @return the string, which stays valid until the pool is freed
+ */
+char const *poolString( StrPool const *pool, StrHandle handle )
+{
+  unsigned int offset = pool->pages[ handle >> POOL_PAGE_SHIFT ][ handle & ( POOL_PAGE_SIZE - 1 ) ];
+  return pool->blocks[ offset >> POOL_BLOCK_SHIFT ] + ( offset & ( POOL_BLOCK_SIZE - 1 ) );
+}
+
+/**
+ * Searches one hash table for a string.
+ *
+ * @param pool the pool the table belongs to
+ * @param table the hash table
+ * @param str the string
+ * @param hash the string's hash
+ * @return the slot holding the string, or the empty slot where it would go
+ */
+static unsigned int probe( StrPool const *pool, StrTable *table, char const *str, unsigned int hash )
+{
+  unsigned int slot = hash & ( table->size - 1 );
+  while ( true ) {
+    unsigned int entry = __atomic_load_n( &table->slots[ slot ], __ATOMIC_ACQUIRE );
+    if ( entry == 0 || strcmp( poolString( pool, entry - 1 ), str ) == 0 ) {
+      return slot;
+    }
+    slot = ( slot + 1 ) & ( table->size - 1 );
+  }
+}
+
+/**
+ * Looks up a string without adding it.
+ *
+ * @param pool the pool to search
+ * @param str the string
+ * @return the string's handle, or NO_HANDLE if it isn't in the pool
+ */
+StrHandle findString( StrPool *pool, char const *str )
+{
+  StrTable *table = __atomic_load_n( &pool->table, __ATOMIC_ACQUIRE );
+  unsigned int entry = __atomic_load_n( &table->slots[ probe( pool, table, str, hashString( str ) ) ],
+                                        __ATOMIC_ACQUIRE );
+  return entry == 0 ? NO_HANDLE : entry - 1;
+}
+
+/**
+ * Doubles the hash table. Readers may still be using the old table, so it
+ * is kept until the pool is freed. Must be called with the lock held.
+ *
+ * @param pool the pool to grow
+ */
+static void growTable( StrPool *pool )
+{
+  // the old table holds every stored string, and reserved handles have none
+  StrTable *old = pool->table;
+  StrTable *table = makeTable( old->size * 2 );
+  for ( unsigned int s = 0; s < old->size; s++ ) {
+    if ( old->slots[ s ] != 0 ) {
+      char const *str = poolString( pool, old->slots[ s ] - 1 );
+      table->slots[ probe( pool, table, str, hashString( str ) ) ] = old->slots[ s ];
+    }
+  }
+
+  pool->oldTables[ pool->oldTableCount++ ] = old;
+  __atomic_store_n( &pool->table, table, __ATOMIC_RELEASE );
+}
+
+/**
+ * Sets where a handle's string is kept, making the page for it if needed.
+ * Must be called with the lock held.
+ *
+ * @param pool the pool
+ * @param handle the handle
+ * @param offset block << POOL_BLOCK_SHIFT | position of the string, or
+ *               NO_OFFSET for a reserved handle
+ */
+static void setOffset( StrPool *pool, StrHandle handle, unsigned int offset )
+{
+  unsigned int **page = &pool->pages[ handle >> POOL_PAGE_SHIFT ];
+  if ( *page == NULL ) {
+    *page = ( unsigned int *)malloc( POOL_PAGE_SIZE * sizeof( unsigned int ) );
+  }
+  ( *page )[ handle & ( POOL_PAGE_SIZE - 1 ) ] = offset;
+}
+
+/**
+ * Copies a string into the current block, starting a new one if it's
+ * full. Must be called with the lock held.
+ *
+ * @param pool the pool
+ * @param str the string
+ * @return block << POOL_BLOCK_SHIFT | position of the copy
+ */
+static unsigned int copyString( StrPool *pool, char const *str )
+{
+  int len = strlen( str ) + 1;
+  if ( pool->blockUsed + len > POOL_BLOCK_SIZE ) {
+    pool->blocks[ pool->blockCount++ ] = ( char *)malloc( POOL_BLOCK_SIZE );
+    pool->blockUsed = 0;
+  }
+  int block = pool->blockCount - 1;
+  memcpy( pool->blocks[ block ] + pool->blockUsed, str, len );
+  unsigned int offset = ( unsigned int ) block << POOL_BLOCK_SHIFT | pool->blockUsed;
+  pool->blockUsed += len;
+  return offset;
+}
+
+/**
+ * Fills a table slot with a handle whose string is in place, growing the
+ * table once it's half full. Must be called with the lock held.
+ *
+ * @param pool the pool
+ * @param slot the empty slot where the string goes
+ * @param handle the string's handle
+ */
+static void storeHandle( StrPool *pool, unsigned int slot, StrHandle handle )
+{
+  // the string is in place before its slot is filled, so readers see all of it
+  __atomic_store_n( &pool->table->slots[ slot ], handle + 1, __ATOMIC_RELEASE );
+  pool->stored++;
+
+  if ( pool->stored * 2 > pool->table->size ) {
+    growTable( pool );
+  }
+}
+
+/**
+ * Adds a string to the pool if it isn't already there. Must be called
+ * with the lock held.
+ *
+ * @param pool the pool to add to
+ * @param str the string
+ * @param hash the string's hash
+ * @return the string's handle
+ */
+static StrHandle addString( StrPool *pool, char const *str, unsigned int hash )
+{
+  unsigned int slot = probe( pool, pool->table, str, hash );
+  if ( pool->table->slots[ slot ] != 0 ) {
+    return pool->table->slots[ slot ] - 1;
+  }
+
+  StrHandle handle = pool->count++;
+  setOffset( pool, handle, copyString( pool, str ) );
+  storeHandle( pool, slot, handle );
+  return handle;
+}
+
+/**
+ * Adds a string to the pool if it isn't already there.
+ *
+ * @param pool the pool to add to
+ * @param str the string
+ * @return the string's handle
+ */
+StrHandle internString( StrPool *pool, char const *str )
+{
+  unsigned int hash = hashString( str );
+  pthread_mutex_lock( &pool->lock );
+  StrHandle handle = addString( pool, str, hash );
+  pthread_mutex_unlock( &pool->lock );
+  return handle;
+}
+
+/**
+ * Adds many strings to the pool at once, as if each were passed to
+ * internString() in turn. The table is grown to fit them all first, and
+ * the slot for each string is fetched into the cache a few strings ahead,
+ * so a big batch isn't held up by one cache miss after another.
+ *
+ * @param pool the pool to add to
+ * @param strs the strings
+ * @param count how many there are
+ * @param handles set to the handle of each string
+ */
+void internStrings( StrPool *pool, char const *const *strs, int count, StrHandle *handles )
+{
+  unsigned int *hashes = ( unsigned int *)malloc( ( count + 1 ) * sizeof( unsigned int ) );
+  for ( int i = 0; i < count; i++ ) {
+    hashes[ i ] = hashString( strs[ i ] );
+  }
+
+  pthread_mutex_lock( &pool->lock );
+  while ( ( pool->stored + count ) * 2 > pool->table->size ) {
+    growTable( pool );
+  }
+  StrTable *table = pool->table;
+  for ( int i = 0; i < count; i++ ) {
+    if ( i + PREFETCH_AHEAD < count ) {
+      __builtin_prefetch( &table->slots[ hashes[ i + PREFETCH_AHEAD ] & ( table->size - 1 ) ] );
+    }
+    handles[ i ] = addString( pool, strs[ i ], hashes[ i ] );
+  }
+  pthread_mutex_unlock( &pool->lock );
+
+  free( hashes );
+}
+
+/**
+ * Sets aside the next count handles for strings that are added later with
+ * placeStrings(). Strings added in the meantime get the handles after them.
+ *
+ * @param pool the pool to reserve handles in
+ * @param count how many handles to reserve
+ * @return the first reserved handle; the rest follow it
+ */
+StrHandle reserveStrings( StrPool *pool, int count )
+{
+  pthread_mutex_lock( &pool->lock );
+  StrHandle first = pool->count;
+  for ( int i = 0; i < count; i++ ) {
+    setOffset( pool, first + i, NO_OFFSET );
+  }
+  pool->count += count;
+  pthread_mutex_unlock( &pool->lock );
+  return first;
+}
+
+/**
+ * Gives reserved handles their strings. A handle that already has its
+ * string is left as it is. None of the strings may be in the pool under
+ * another handle. Like internStrings(), the table is grown to fit them
+ * all before any is added.
+ *
+ * @param pool the pool the handles were reserved in
+ * @param handles the reserved handles
+ * @param strs the string for each handle
+ * @param count how many there are
+ */
+void placeStrings( StrPool *pool, StrHandle const *handles, char const *const *strs, int count )
+{
+  unsigned int *hashes = ( unsigned int *)malloc( ( count + 1 ) * sizeof( unsigned int ) );
+  for ( int i = 0; i < count; i++ ) {
+    hashes[ i ] = hashString( strs[ i ] );
+  }
+
+  pthread_mutex_lock( &pool->lock );
+  while ( ( pool->stored + count ) * 2 > pool->table->size ) {
+    growTable( pool );
+  }
+  for ( int i = 0; i < count; i++ ) {
+    unsigned int *offset = &pool->pages[ handles[ i ] >> POOL_PAGE_SHIFT ][ handles[ i ] & ( POOL_PAGE_SIZE - 1 ) ];
+    if ( *offset == NO_OFFSET ) {
+      *offset = copyString( pool, strs[ i ] );
+      storeHandle( pool, probe( pool, pool->table, strs[ i ], hashes[ i ] ), handles[ i ] );
+    }
+  }
+  pthread_mutex_unlock( &pool->lock );
+
+  free( hashes );
+}
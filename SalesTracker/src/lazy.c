@@ -0,0 +1,264 @@
+/**
+ * @file lazy.c
+ * @author Luke Early
+ * Source file for making the members of a lazily loaded member file only
+ * when they're first needed.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "lazy.h"
+#include "snapshot.h"
+#include "trace.h"
+
+/** Fewest slots in the index of IDs */
+#define INIT_INDEX_SIZE 1024
+
+/**
+ * Makes the state for loading a member file lazily. Set it as the group's
+ * lazy field before calling readMembers().
+ *
+ * @return the new state, with no members
+ */
+Lazy *makeLazy()
+{
+  Lazy *lazy = ( Lazy *)calloc( 1, sizeof( Lazy ) );
+  pthread_mutex_init( &lazy->lock, NULL );
+  return lazy;
+}
+
+/**
+ * Frees the lazy loading state and the file it kept. Members made from it
+ * belong to the group.
+ *
+ * @param lazy the state to free, or NULL
+ */
+void freeLazy( Lazy *lazy )
+{
+  if ( lazy == NULL ) {
+    return;
+  }
+  free( lazy->buffer );
+  free( lazy->lines );
+  free( lazy->index );
+  pthread_mutex_destroy( &lazy->lock );
+  free( lazy );
+}
+
+/**
+ * Hashes a member ID.
+ *
+ * @param id the ID
+ * @return FNV-1a hash of the ID
+ */
+static unsigned int hashId( char const *id )
+{
+  unsigned int hash = 2166136261u;
+  for ( ; *id != '\0'; id++ ) {
+    hash = ( hash ^ ( unsigned char ) *id ) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Searches the index for an ID.
+ *
+ * @param lazy the lazy loading state
+ * @param id the ID
+ * @param hash the ID's hash
+ * @return the slot holding the ID, or the empty slot where it would go
+ */
+static int probeIndex( Lazy const *lazy, char const *id, unsigned int hash )
+{
+  int slot = hash & ( lazy->indexSize - 1 );
+  while ( true ) {
+    LazySlot const *entry = &lazy->index[ slot ];
+    if ( entry->member == 0
+         || ( entry->hash == hash && strcmp( lazy->lines[ entry->member - 1 ], id ) == 0 ) ) {
+      return slot;
+    }
+    slot = ( slot + 1 ) & ( lazy->indexSize - 1 );
+  }
+}
+
+/**
+ * Builds the index of a lazily loaded member file's IDs. Each line has
+ * been cut into its ID and name, and the member on lines[ i ] gets index
+ * i. Only for a group with no members yet.
+ *
+ * @param group the live group, with its lazy field set
+ * @param lines each member's ID, in file order; kept by the lazy state if
+ *              the index is built
+ * @param count how many members there are
+ * @return false if two lines have the same ID
+ */
+bool indexMembers( Group *group, char **lines, int count )
+{
+  Lazy *lazy = group->lazy;
+  lazy->indexSize = INIT_INDEX_SIZE;
+  while ( lazy->indexSize < count * 2 ) {
+    lazy->indexSize *= 2;
+  }
+  lazy->index = ( LazySlot *)calloc( lazy->indexSize, sizeof( LazySlot ) );
+  lazy->lines = lines;
+
+  for ( int i = 0; i < count; i++ ) {
+    unsigned int hash = hashId( lines[ i ] );
+    LazySlot *entry = &lazy->index[ probeIndex( lazy, lines[ i ], hash ) ];
+    if ( entry->member != 0 ) {
+      free( lazy->index );
+      lazy->index = NULL;
+      lazy->lines = NULL;
+      return false;
+    }
+    entry->hash = hash;
+    entry->member = i + 1;
+  }
+  lazy->count = count;
+  return true;
+}
+
+/**
+ * Finds a member of a lazily loaded member file by its ID, whether it's
+ * been made or not. Needs no lock, since the index doesn't change once
+ * it's built.
+ *
+ * @param lazy the lazy loading state
+ * @param id the member's ID
+ * @return index of the member in mList, or -1 if the file didn't list it
+ */
+int findLazyMember( Lazy const *lazy, char const *id )
+{
+  if ( lazy->index == NULL ) {
+    return -1;
+  }
+  return lazy->index[ probeIndex( lazy, id, hashId( id ) ) ].member - 1;
+}
+
+/**
+ * Returns the name on a member's line, past the nul after its ID and the
+ * blanks before the name.
+ *
+ * @param lazy the lazy loading state
+ * @param idx index of the member
+ * @return the name
+ */
+static char const *lineName( Lazy const *lazy, int idx )
+{
+  char const *name = lazy->lines[ idx ] + strlen( lazy->lines[ idx ] ) + 1;
+  while ( *name == ' ' || *name == '\t' ) {
+    name++;
+  }
+  return name;
+}
+
+/**
+ * Puts a newly made member in its place in mList, where other threads can
+ * find it, and has the next snapshot copy it. Must be called with the lazy
+ * lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member
+ * @param member the member
+ */
+static void placeMember( Group *group, int idx, Member *member )
+{
+  __atomic_store_n( &group->mList[ idx ], member, __ATOMIC_RELEASE );
+  __atomic_store_n( &group->lazy->made, group->lazy->made + 1, __ATOMIC_RELEASE );
+  markMemberLoaded( group, idx );
+}
+
+/**
+ * Returns the live member at the given index, making it from its line of
+ * the member file first if it hasn't been made yet. Works on any live
+ * group, lazily loaded or not. Must be called on the shared side or with
+ * the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ * @return the member
+ */
+Member *loadMember( Group *group, int idx )
+{
+  Member *member = __atomic_load_n( &group->mList[ idx ], __ATOMIC_ACQUIRE );
+  if ( member != NULL ) {
+    return member;
+  }
+
+  Lazy *lazy = group->lazy;
+  pthread_mutex_lock( &lazy->lock );
+  member = group->mList[ idx ];
+  if ( member == NULL ) {
+    StrHandle id = idx;
+    placeStrings( group->ids, &id, ( char const *const *) &lazy->lines[ idx ], 1 );
+    member = makeMember( id, internString( group->names, lineName( lazy, idx ) ) );
+    placeMember( group, idx, member );
+  }
+  pthread_mutex_unlock( &lazy->lock );
+  return member;
+}
+
+/**
+ * Makes every member of a lazily loaded group that hasn't been made yet,
+ * interning their IDs and names in one go, so the next snapshot holds
+ * every member. Does nothing if they've all been made. Must be called off
+ * the shared side, like openView().
+ *
+ * @param group the live group
+ */
+void loadAllMembers( Group *group )
+{
+  Lazy *lazy = group->lazy;
+  if ( lazy == NULL || __atomic_load_n( &lazy->made, __ATOMIC_ACQUIRE ) == lazy->count ) {
+    return;
+  }
+
+  traceBegin( "load", NULL );
+  enterGroup( group );
+  pthread_mutex_lock( &lazy->lock );
+
+  // a member's ID handle is its index, set aside when the file was indexed
+  int left = lazy->count - lazy->made;
+  StrHandle *missing = ( StrHandle *)malloc( ( left + 1 ) * sizeof( StrHandle ) );
+  char const **ids = ( char const **)malloc( ( left + 1 ) * sizeof( char * ) );
+  char const **names = ( char const **)malloc( ( left + 1 ) * sizeof( char * ) );
+  int missingCount = 0;
+  for ( int i = 0; i < lazy->count; i++ ) {
+    if ( group->mList[ i ] == NULL ) {
+      missing[ missingCount ] = i;
+      ids[ missingCount ] = lazy->lines[ i ];
+      names[ missingCount++ ] = lineName( lazy, i );
+    }
+  }
+
+  StrHandle *handles = ( StrHandle *)malloc( ( missingCount + 1 ) * sizeof( StrHandle ) );
+  placeStrings( group->ids, missing, ids, missingCount );
+  internStrings( group->names, names, missingCount, handles );
+  for ( int m = 0; m < missingCount; m++ ) {
+    placeMember( group, missing[ m ], makeMember( missing[ m ], handles[ m ] ) );
+  }
+
+  pthread_mutex_unlock( &lazy->lock );
+  leaveGroup( group );
+  traceEnd( "load" );
+
+  free( missing );
+  free( ids );
+  free( names );
+  free( handles );
+}
+
+/**
+ * Returns the name of the live member at the given index, read from its
+ * line of the member file if it hasn't been made yet, so it can be checked
+ * without making it.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ * @return the member's name
+ */
+char const *liveMemberName( Group *group, int idx )
+{
+  Member const *member = __atomic_load_n( &group->mList[ idx ], __ATOMIC_ACQUIRE );
+  return member != NULL ? memberName( group, member ) : lineName( group->lazy, idx );
+}
@@ -0,0 +1,268 @@
+/**
+ * @file loader.c
+ * @author Luke Early
+ * Source file for parallel loading of item and member files.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "loader.h"
+
+/** Starting size of a chunk's record array */
+#define INIT_RECORDS 1024
+
+/** Most threads a file is split for, 0 for one per core, and the smallest chunk */
+static int splitThreads = 0;
+static size_t splitMinBytes = MIN_CHUNK_BYTES;
+
+/**
+ * Reads an entire file into a nul terminated buffer.
+ *
+ * @param filename name of the file
+ * @param len set to the number of bytes read
+ * @return the buffer, or NULL if the file can't be opened
+ */
+static char *readWholeFile( char const *filename, size_t *len )
+{
+  FILE *fp = fopen( filename, "r" );
+  if ( fp == NULL ) {
+    return NULL;
+  }
+
+  // sized to the file up front, so a big file is read without copying it as it grows
+  struct stat info;
+  size_t cap = fstat( fileno( fp ), &info ) == 0 && info.st_size > 0 ? ( size_t ) info.st_size + 1 : 1 << 16;
+  size_t count = 0;
+  char *buffer = ( char *)malloc( cap + 1 );
+  size_t got;
+  while ( ( got = fread( buffer + count, 1, cap - count, fp ) ) > 0 ) {
+    count += got;
+    if ( count == cap ) {
+      cap *= 2;
+      buffer = ( char *)realloc( buffer, cap + 1 );
+    }
+  }
+  fclose( fp );
+
+  buffer[ count ] = '\0';
+  *len = count;
+  return buffer;
+}
+
+/**
+ * Hashes a run of bytes, eight at a time where it can.
+ *
+ * @param bytes start of the bytes
+ * @param len how many there are
+ * @return the hash
+ */
+static unsigned long long hashBytes( char const *bytes, size_t len )
+{
+  unsigned long long hash = 14695981039346656037ull;
+  size_t pos = 0;
+  for ( ; pos + 8 <= len; pos += 8 ) {
+    unsigned long long word;
+    memcpy( &word, bytes + pos, 8 );
+    hash = ( hash ^ word ) * 1099511628211ull;
+    hash ^= hash >> 29;
+  }
+  for ( ; pos < len; pos++ ) {
+    hash = ( hash ^ ( unsigned char ) bytes[ pos ] ) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/**
+ * Parses every line in a chunk, ending each line in place with a nul.
+ *
+ * @param arg the chunk to parse
+ * @return NULL
+ */
+static void *parseChunk( void *arg )
+{
+  Chunk *chunk = ( Chunk *)arg;
+  chunk->cap = INIT_RECORDS;
+  chunk->records = ( void **)malloc( chunk->cap * sizeof( void * ) );
+
+  char *line = chunk->start;
+  while ( line < chunk->end && !chunk->invalid ) {
+    char *newline = memchr( line, '\n', chunk->end - line );
+    char *lineEnd = newline == NULL ? chunk->end : newline;
+    if ( lineEnd > line && lineEnd[ -1 ] == '\r' ) {
+      lineEnd[ -1 ] = '\0';
+    }
+    *lineEnd = '\0';
+
+    void *record = chunk->parse( line );
+    if ( record == NULL ) {
+      chunk->invalid = true;
+      break;
+    }
+
+    if ( chunk->count + 1 > chunk->cap ) {
+      chunk->cap *= 2;
+      chunk->records = ( void **)realloc( chunk->records, chunk->cap * sizeof( void * ) );
+    }
+    chunk->records[ chunk->count++ ] = record;
+
+    line = lineEnd + 1;
+  }
+
+  return NULL;
+}
+
+/**
+ * Changes how files are split for loading, so a small file can be split
+ * the way a big one is. Meant for tests; must be called before any file
+ * is loaded, not during a load.
+ *
+ * @param threads most threads a file is parsed on, up to MAX_LOAD_THREADS,
+ *                or 0 for one per core
+ * @param minChunkBytes files smaller than this per thread are parsed on
+ *                      fewer threads
+ */
+void setLoadSplit( int threads, size_t minChunkBytes )
+{
+  splitThreads = threads;
+  splitMinBytes = minChunkBytes < 1 ? 1 : minChunkBytes;
+}
+
+/**
+ * Reads the whole named file, splits it on line boundaries into one chunk
+ * per thread, and parses every chunk in parallel with the given parser.
+ *
+ * Each chunk keeps its records in the order they appear in the file, so
+ * reading the chunks in order gives every record in file order.
+ *
+ * If the file still starts with the whole lines mark describes, only the
+ * lines after them are parsed and the load is marked appended. Either way,
+ * mark is updated to describe the file as it is now.
+ *
+ * @param filename name of the file to load
+ * @param parse turns one line into a record
+ * @param mark what was loaded last time, all zero for a first load
+ * @return the parsed chunks, or NULL if the file can't be opened
+ */
+Load *loadFile( char const *filename, LineParser parse, FileMark *mark )
+{
+  size_t fileLen = 0;
+  char *buffer = readWholeFile( filename, &fileLen );
+  if ( buffer == NULL ) {
+    return NULL;
+  }
+
+  Load *load = ( Load *)calloc( 1, sizeof( Load ) );
+  load->buffer = buffer;
+
+  // skip what was loaded before if the file has only grown since
+  size_t skip = 0;
+  if ( mark->length > 0 && mark->length <= fileLen && buffer[ mark->length - 1 ] == '\n'
+       && hashBytes( buffer, mark->length ) == mark->hash ) {
+    skip = mark->length;
+    load->appended = true;
+  }
+  mark->length = fileLen;
+  mark->hash = hashBytes( buffer, fileLen );
+
+  char *base = buffer + skip;
+  size_t len = fileLen - skip;
+
+  // one thread per core, but don't bother splitting small files
+  long cores = splitThreads > 0 ? splitThreads : sysconf( _SC_NPROCESSORS_ONLN );
+  int threads = cores < 1 ? 1 : cores;
+  if ( threads > MAX_LOAD_THREADS ) {
+    threads = MAX_LOAD_THREADS;
+  }
+  if ( len / splitMinBytes < threads ) {
+    threads = len / splitMinBytes > 0 ? len / splitMinBytes : 1;
+  }
+
+  // chunk boundaries are moved forward to the start of the next line
+  char *start = base;
+  char *fileEnd = base + len;
+  for ( int i = 0; i < threads && start < fileEnd; i++ ) {
+    char *end = i == threads - 1 ? fileEnd : base + len / threads * ( i + 1 );
+    if ( end < start ) {
+      end = start;
+    }
+    char *newline = memchr( end, '\n', fileEnd - end );
+    end = newline == NULL ? fileEnd : newline + 1;
+
+    Chunk *chunk = &load->chunks[ load->chunkCount++ ];
+    chunk->start = start;
+    chunk->end = end;
+    chunk->parse = parse;
+    start = end;
+  }
+
+  if ( load->chunkCount == 1 ) {
+    parseChunk( &load->chunks[ 0 ] );
+  } else {
+    // a chunk whose thread can't be started is parsed here instead
+    pthread_t ids[ MAX_LOAD_THREADS ];
+    bool started[ MAX_LOAD_THREADS ];
+    for ( int i = 0; i < load->chunkCount; i++ ) {
+      started[ i ] = pthread_create( &ids[ i ], NULL, parseChunk, &load->chunks[ i ] ) == 0;
+      if ( !started[ i ] ) {
+        parseChunk( &load->chunks[ i ] );
+      }
+    }
+    for ( int i = 0; i < load->chunkCount; i++ ) {
+      if ( started[ i ] ) {
+        pthread_join( ids[ i ], NULL );
+      }
+    }
+  }
+
+  return load;
+}
+
+/**
+ * Tells whether any line of the loaded file failed to parse.
+ *
+ * @param load the loaded file
+ * @return true if some chunk had an invalid line
+ */
+bool loadInvalid( Load const *load )
+{
+  for ( int i = 0; i < load->chunkCount; i++ ) {
+    if ( load->chunks[ i ].invalid ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Returns the total number of records parsed from the file.
+ *
+ * @param load the loaded file
+ * @return the record count
+ */
+int loadCount( Load const *load )
+{
+  int count = 0;
+  for ( int i = 0; i < load->chunkCount; i++ ) {
+    count += load->chunks[ i ].count;
+  }
+  return count;
+}
+
+/**
+ * Frees the file buffer and the chunk record arrays. The records
+ * themselves belong to whoever took them out of the chunks.
+ *
+ * @param load the loaded file
+ */
+void freeLoad( Load *load )
+{
+  for ( int i = 0; i < load->chunkCount; i++ ) {
+    free( load->chunks[ i ].records );
+  }
+  free( load->buffer );
+  free( load );
+}
@@ -0,0 +1,561 @@
+/**
+ * @file publish.c
+ * @author Luke Early
+ * Source file for publishing snapshots to shared memory, and for reading
+ * them from another process.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "publish.h"
+#include "snapshot.h"
+#include "lazy.h"
+#include "trace.h"
+
+/** Times a reader tries to map a segment that is being replaced */
+#define MAP_TRIES 100
+
+/** Fewest records of each kind a segment has room for */
+#define MIN_CAP 1024
+
+/** Where shm_open() keeps segments, so one can be renamed over another */
+#define SHM_DIR "/dev/shm"
+
+/** Added to a segment's name while a new one is being filled */
+#define FILL_SUFFIX ".new"
+
+/**
+ * Rounds a size up to a whole number of cache lines.
+ *
+ * @param bytes the size
+ * @return the rounded size
+ */
+static long roundUp( long bytes )
+{
+  return ( bytes + 63 ) & ~63L;
+}
+
+/**
+ * Copies a segment name, adding the leading slash shm_open() wants if it
+ * doesn't have one.
+ *
+ * @param name the name as given
+ * @param out set to the name to open
+ * @return false if the name is empty or too long
+ */
+static bool segmentName( char const *name, char *out )
+{
+  int slash = name[ 0 ] == '/' ? 0 : 1;
+  if ( name[ 1 - slash ] == '\0' || strlen( name ) + slash > PUBLISH_NAME_MAX ) {
+    return false;
+  }
+  out[ 0 ] = '/';
+  strcpy( out + slash, name );
+  return true;
+}
+
+/**
+ * Returns one of the two buffers of a segment.
+ *
+ * @param header the segment
+ * @param which 0 or 1
+ * @return the buffer
+ */
+static PubBuffer *bufferAt( PubHeader const *header, int which )
+{
+  return ( PubBuffer *) ( ( char *) header + roundUp( sizeof( PubHeader ) ) + which * header->bufferBytes );
+}
+
+/**
+ * Makes a new segment with room for the given number of records in each
+ * buffer, under the name it's filled under, replacing any left behind
+ * there. Its magic number is only set once the first copy is in it, and
+ * it only gets the segment's real name after that, from placeSegment().
+ *
+ * @param name name of the segment being filled
+ * @param itemCap items each buffer has room for
+ * @param memberCap members each buffer has room for
+ * @param saleCap sales each buffer has room for
+ * @param bytes set to the size of the segment
+ * @return the mapped segment, or NULL if it can't be made
+ */
+static PubHeader *makeSegment( char const *name, int itemCap, int memberCap, int saleCap, long *bytes )
+{
+  long itemOffset = roundUp( sizeof( PubBuffer ) );
+  long memberOffset = itemOffset + roundUp( ( long ) itemCap * sizeof( PubItem ) );
+  long saleOffset = memberOffset + roundUp( ( long ) memberCap * sizeof( PubMember ) );
+  long bufferBytes = saleOffset + roundUp( ( long ) saleCap * sizeof( PubSale ) );
+  *bytes = roundUp( sizeof( PubHeader ) ) + 2 * bufferBytes;
+
+  shm_unlink( name );
+  int fd = shm_open( name, O_CREAT | O_EXCL | O_RDWR, PUBLISH_MODE );
+  if ( fd < 0 ) {
+    return NULL;
+  }
+  if ( ftruncate( fd, *bytes ) != 0 ) {
+    close( fd );
+    shm_unlink( name );
+    return NULL;
+  }
+  PubHeader *header = ( PubHeader *) mmap( NULL, *bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( header == MAP_FAILED ) {
+    shm_unlink( name );
+    return NULL;
+  }
+
+  // a new segment is all zeros, so both buffers start out empty and even
+  header->layout = PUBLISH_LAYOUT;
+  header->itemCap = itemCap;
+  header->memberCap = memberCap;
+  header->saleCap = saleCap;
+  header->itemOffset = itemOffset;
+  header->memberOffset = memberOffset;
+  header->saleOffset = saleOffset;
+  header->bufferBytes = bufferBytes;
+  return header;
+}
+
+/**
+ * Gives a filled segment its real name, in place of any segment that had
+ * it, so readers opening the name find either the old segment or the
+ * filled one and never a missing or empty one.
+ *
+ * @param fillName name the segment was filled under
+ * @param name the segment's real name
+ * @return false if it couldn't be renamed, which removes the filled one
+ */
+static bool placeSegment( char const *fillName, char const *name )
+{
+  char fillPath[ sizeof( SHM_DIR ) + sizeof( FILL_SUFFIX ) + PUBLISH_NAME_MAX ];
+  char path[ sizeof( SHM_DIR ) + PUBLISH_NAME_MAX ];
+  sprintf( fillPath, "%s%s", SHM_DIR, fillName );
+  sprintf( path, "%s%s", SHM_DIR, name );
+  if ( rename( fillPath, path ) != 0 ) {
+    shm_unlink( fillName );
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Finds a capacity with room for what's needed, doubling the old one.
+ *
+ * @param cap the old capacity
+ * @param need how much room is needed
+ * @return the new capacity
+ */
+static int growCap( int cap, int need )
+{
+  if ( cap < MIN_CAP ) {
+    cap = MIN_CAP;
+  }
+  while ( cap < need ) {
+    cap *= 2;
+  }
+  return cap;
+}
+
+/**
+ * Writes a snapshot into the buffer readers aren't being sent to, then
+ * sends them to it.
+ *
+ * @param group the live group
+ * @param header the segment
+ * @param snap the snapshot
+ */
+static void writeBuffer( Group *group, PubHeader *header, Snapshot const *snap )
+{
+  int next = 1 - header->current;
+  PubBuffer *buffer = bufferAt( header, next );
+  PubItem *items = ( PubItem *) ( ( char *) buffer + header->itemOffset );
+  PubMember *members = ( PubMember *) ( ( char *) buffer + header->memberOffset );
+  PubSale *sales = ( PubSale *) ( ( char *) buffer + header->saleOffset );
+
+  // an odd number tells readers the buffer is being written
+  unsigned long seq = buffer->seq;
+  __atomic_store_n( &buffer->seq, seq + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+
+  for ( int i = 0; i < snap->iCount; i++ ) {
+    Item const *item = snap->iPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ];
+    items[ i ].id = item->id;
+    items[ i ].cost = item->cost;
+    items[ i ].sold = item->numSold;
+    strcpy( items[ i ].name, item->name );
+  }
+
+  int saleCount = 0;
+  for ( int i = 0; i < snap->mCount; i++ ) {
+    Member const *member = snap->mPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ];
+    strcpy( members[ i ].id, memberId( group, member ) );
+    strcpy( members[ i ].name, memberName( group, member ) );
+    members[ i ].sold = member->sold;
+    members[ i ].sales = member->sales;
+    members[ i ].first = saleCount;
+    members[ i ].count = member->count;
+    for ( int j = 0; j < member->count; j++ ) {
+      sales[ saleCount ].itemId = member->list[ j ]->itemPtr->id;
+      sales[ saleCount ].sold = member->list[ j ]->numSold;
+      saleCount++;
+    }
+  }
+
+  buffer->epoch = snap->epoch;
+  buffer->time = time( NULL );
+  buffer->iCount = snap->iCount;
+  buffer->mCount = snap->mCount;
+  buffer->saleCount = saleCount;
+  buffer->totalSold = snap->totalSold;
+  buffer->totalSales = snap->totalSales;
+  __atomic_store_n( &buffer->seq, seq + 2, __ATOMIC_RELEASE );
+  __atomic_store_n( &header->current, next, __ATOMIC_RELEASE );
+}
+
+/**
+ * Copies the group's newest snapshot into the segment, unless it's the
+ * one already there. If the segment is too small, a bigger one is filled
+ * under another name and then renamed over it. If that fails, the old
+ * segment stays where it is, with its last copy.
+ *
+ * @param publisher the publisher
+ * @return false if a bigger segment was needed and couldn't be made
+ */
+static bool copySnapshot( Publisher *publisher )
+{
+  // every member is published, so a lazily loaded group makes them all first
+  loadAllMembers( publisher->group );
+  int slot = 0;
+  Snapshot *snap = pinSnapshot( publisher->group, &slot );
+  if ( publisher->header != NULL && snap->epoch == publisher->epoch ) {
+    unpinSnapshot( publisher->group, slot );
+    return true;
+  }
+
+  traceBegin( "publish", NULL );
+  int saleCount = 0;
+  for ( int i = 0; i < snap->mCount; i++ ) {
+    saleCount += snap->mPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ]->count;
+  }
+
+  PubHeader *old = publisher->header;
+  if ( old == NULL || snap->iCount > old->itemCap || snap->mCount > old->memberCap
+       || saleCount > old->saleCap ) {
+    char fillName[ PUBLISH_NAME_MAX + sizeof( FILL_SUFFIX ) ];
+    sprintf( fillName, "%s%s", publisher->name, FILL_SUFFIX );
+    long bytes = 0;
+    PubHeader *header = makeSegment( fillName,
+                                     growCap( old == NULL ? 0 : old->itemCap, snap->iCount ),
+                                     growCap( old == NULL ? 0 : old->memberCap, snap->mCount ),
+                                     growCap( old == NULL ? 0 : old->saleCap, saleCount ), &bytes );
+    if ( header == NULL ) {
+      traceEnd( "publish" );
+      unpinSnapshot( publisher->group, slot );
+      return false;
+    }
+
+    // readers only find the new segment once it holds a copy
+    writeBuffer( publisher->group, header, snap );
+    __atomic_store_n( &header->magic, PUBLISH_MAGIC, __ATOMIC_RELEASE );
+    if ( !placeSegment( fillName, publisher->name ) ) {
+      munmap( header, bytes );
+      traceEnd( "publish" );
+      unpinSnapshot( publisher->group, slot );
+      return false;
+    }
+    if ( old != NULL ) {
+      __atomic_store_n( &old->moved, 1, __ATOMIC_RELEASE );
+      munmap( old, publisher->bytes );
+    }
+    publisher->header = header;
+    publisher->bytes = bytes;
+  } else {
+    writeBuffer( publisher->group, old, snap );
+  }
+
+  publisher->epoch = snap->epoch;
+  traceEnd( "publish" );
+  unpinSnapshot( publisher->group, slot );
+  return true;
+}
+
+/**
+ * Body of the publisher's thread: copies the group in after every
+ * everySales sales, or everyMs milliseconds, until it's stopped.
+ *
+ * @param arg the publisher
+ * @return NULL
+ */
+static void *publishLoop( void *arg )
+{
+  Publisher *publisher = ( Publisher *) arg;
+  pthread_mutex_lock( &publisher->lock );
+  while ( !publisher->stopping ) {
+    struct timespec until;
+    clock_gettime( CLOCK_REALTIME, &until );
+    until.tv_sec += publisher->everyMs / 1000;
+    until.tv_nsec += ( publisher->everyMs % 1000 ) * 1000000L;
+    if ( until.tv_nsec >= 1000000000L ) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+
+    while ( !publisher->stopping
+            && __atomic_load_n( &publisher->pending, __ATOMIC_RELAXED ) < publisher->everySales ) {
+      if ( pthread_cond_timedwait( &publisher->wake, &publisher->lock, &until ) == ETIMEDOUT ) {
+        break;
+      }
+    }
+    if ( publisher->stopping ) {
+      break;
+    }
+
+    // sales made while copying count towards the next copy. A copy that
+    // fails is tried again next time, and said once until one works
+    __atomic_store_n( &publisher->pending, 0, __ATOMIC_RELAXED );
+    pthread_mutex_unlock( &publisher->lock );
+    bool copied = copySnapshot( publisher );
+    if ( !copied && !publisher->failing ) {
+      fprintf( stderr, "Can't grow shared memory %s, readers keep the last copy\n", publisher->name );
+    }
+    publisher->failing = !copied;
+    pthread_mutex_lock( &publisher->lock );
+  }
+  pthread_mutex_unlock( &publisher->lock );
+  return NULL;
+}
+
+/**
+ * Makes the shared-memory segment with the given name, copies the group's
+ * newest snapshot into it, and starts the thread that keeps it up to date.
+ *
+ * @param group the live group
+ * @param name name of the segment, with or without its leading slash
+ * @param everySales copy after this many sales
+ * @param everyMs copy after this many milliseconds, if anything changed
+ * @return the publisher, or NULL if the segment can't be made
+ */
+Publisher *openPublisher( Group *group, char const *name, int everySales, int everyMs )
+{
+  Publisher *publisher = ( Publisher *)calloc( 1, sizeof( Publisher ) );
+  publisher->group = group;
+  publisher->everySales = everySales;
+  publisher->everyMs = everyMs;
+  if ( !segmentName( name, publisher->name ) || !copySnapshot( publisher ) ) {
+    free( publisher );
+    return NULL;
+  }
+
+  pthread_mutex_init( &publisher->lock, NULL );
+  pthread_cond_init( &publisher->wake, NULL );
+  if ( pthread_create( &publisher->thread, NULL, publishLoop, publisher ) != 0 ) {
+    pthread_cond_destroy( &publisher->wake );
+    pthread_mutex_destroy( &publisher->lock );
+    munmap( publisher->header, publisher->bytes );
+    shm_unlink( publisher->name );
+    free( publisher );
+    return NULL;
+  }
+  return publisher;
+}
+
+/**
+ * Stops the publisher's thread, copies the group in one last time and
+ * removes the segment's name. Readers that have it mapped can still read
+ * the last copy.
+ *
+ * @param publisher the publisher to close
+ */
+void closePublisher( Publisher *publisher )
+{
+  pthread_mutex_lock( &publisher->lock );
+  publisher->stopping = true;
+  pthread_cond_signal( &publisher->wake );
+  pthread_mutex_unlock( &publisher->lock );
+  pthread_join( publisher->thread, NULL );
+
+  copySnapshot( publisher );
+  shm_unlink( publisher->name );
+  munmap( publisher->header, publisher->bytes );
+  pthread_cond_destroy( &publisher->wake );
+  pthread_mutex_destroy( &publisher->lock );
+  free( publisher );
+}
+
+/**
+ * Counts a sale towards the next copy, waking the publisher's thread once
+ * enough have been made.
+ *
+ * @param publisher the publisher
+ */
+void notePublishSale( Publisher *publisher )
+{
+  // only the sale that reaches the count takes the lock
+  if ( __atomic_add_fetch( &publisher->pending, 1, __ATOMIC_RELAXED ) == publisher->everySales ) {
+    pthread_mutex_lock( &publisher->lock );
+    pthread_cond_signal( &publisher->wake );
+    pthread_mutex_unlock( &publisher->lock );
+  }
+}
+
+/**
+ * Maps the segment named in a mapping read-only, trying again for a while
+ * if the name is missing, as it is until the publisher has filled the
+ * first segment, or the segment isn't one a group published.
+ *
+ * @param map the mapping, with its name set
+ * @return false if no segment turned up
+ */
+static bool mapSegment( PubMap *map )
+{
+  for ( int tries = 0; tries < MAP_TRIES; tries++ ) {
+    if ( tries > 0 ) {
+      nanosleep( &( struct timespec ) { 0, 1000000L }, NULL );
+    }
+
+    int fd = shm_open( map->name, O_RDONLY, 0 );
+    if ( fd < 0 ) {
+      continue;
+    }
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 || info.st_size < ( long ) sizeof( PubHeader ) ) {
+      close( fd );
+      continue;
+    }
+    PubHeader const *header = ( PubHeader const *) mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( header == MAP_FAILED ) {
+      continue;
+    }
+
+    // the size is checked too, so a bad header can't send a reader off the end
+    if ( __atomic_load_n( &header->magic, __ATOMIC_ACQUIRE ) == PUBLISH_MAGIC
+         && header->layout == PUBLISH_LAYOUT
+         && roundUp( sizeof( PubHeader ) ) + 2 * header->bufferBytes <= info.st_size ) {
+      map->header = header;
+      map->bytes = info.st_size;
+      return true;
+    }
+    munmap( ( void *) header, info.st_size );
+  }
+  return false;
+}
+
+/**
+ * Maps the segment with the given name read-only.
+ *
+ * @param name name of the segment, with or without its leading slash
+ * @return the mapping, or NULL if there's no such segment or it isn't one
+ *         a group published
+ */
+PubMap *openPubMap( char const *name )
+{
+  PubMap *map = ( PubMap *)malloc( sizeof( PubMap ) );
+  if ( !segmentName( name, map->name ) || !mapSegment( map ) ) {
+    free( map );
+    return NULL;
+  }
+  return map;
+}
+
+/**
+ * Unmaps a segment mapped with openPubMap().
+ *
+ * @param map the mapping
+ */
+void closePubMap( PubMap *map )
+{
+  if ( map->header != NULL ) {
+    munmap( ( void *) map->header, map->bytes );
+  }
+  free( map );
+}
+
+/**
+ * Starts reading the newest copy in a segment, mapping it again first if
+ * it has moved. The buffer's records can be read in place until
+ * endPubRead() says whether they were all from one copy. Until then its
+ * counts may be torn, so they must be kept within the header's capacities.
+ *
+ * @param map the mapping
+ * @param seq set to the buffer's sequence number, to pass to endPubRead()
+ * @return the buffer to read, or NULL if the segment has gone
+ */
+PubBuffer const *beginPubRead( PubMap *map, unsigned long *seq )
+{
+  while ( true ) {
+    if ( __atomic_load_n( &map->header->moved, __ATOMIC_ACQUIRE ) ) {
+      munmap( ( void *) map->header, map->bytes );
+      map->header = NULL;
+      if ( !mapSegment( map ) ) {
+        return NULL;
+      }
+    }
+
+    int current = __atomic_load_n( &map->header->current, __ATOMIC_ACQUIRE );
+    PubBuffer const *buffer = bufferAt( map->header, current );
+    *seq = __atomic_load_n( &buffer->seq, __ATOMIC_ACQUIRE );
+    if ( ( *seq & 1 ) == 0 ) {
+      return buffer;
+    }
+    sched_yield();
+  }
+}
+
+/**
+ * Finishes reading a buffer started with beginPubRead().
+ *
+ * @param buffer the buffer
+ * @param seq the sequence number beginPubRead() gave
+ * @return false if the buffer was written while it was read, so the read
+ *         has to start again
+ */
+bool endPubRead( PubBuffer const *buffer, unsigned long seq )
+{
+  __atomic_thread_fence( __ATOMIC_ACQUIRE );
+  return __atomic_load_n( &buffer->seq, __ATOMIC_RELAXED ) == seq;
+}
+
+/**
+ * Returns the items of a buffer.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its items
+ */
+PubItem const *pubItems( PubMap const *map, PubBuffer const *buffer )
+{
+  return ( PubItem const *) ( ( char const *) buffer + map->header->itemOffset );
+}
+
+/**
+ * Returns the members of a buffer, in the order they were loaded.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its members
+ */
+PubMember const *pubMembers( PubMap const *map, PubBuffer const *buffer )
+{
+  return ( PubMember const *) ( ( char const *) buffer + map->header->memberOffset );
+}
+
+/**
+ * Returns the sales of a buffer, each member's after the one before's.
+ *
+ * @param map the mapping the buffer is in
+ * @param buffer the buffer
+ * @return its sales
+ */
+PubSale const *pubSales( PubMap const *map, PubBuffer const *buffer )
+{
+  return ( PubSale const *) ( ( char const *) buffer + map->header->saleOffset );
+}
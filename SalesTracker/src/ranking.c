@@ -0,0 +1,177 @@
+/**
+ * @file ranking.c
+ * @author Luke Early
+ * Source file for rankings kept in order as sales are recorded.
+ */
+#include <stdlib.h>
+
+#include "ranking.h"
+
+/**
+ * Makes a node on the given number of levels.
+ *
+ * @param height levels the node is on
+ * @return the new node, linked to nothing
+ */
+static RankNode *makeNode( int height )
+{
+  RankNode *node = ( RankNode *)calloc( 1, sizeof( RankNode ) + height * sizeof( RankNode * ) );
+  node->height = height;
+  return node;
+}
+
+/**
+ * Makes an empty ranking.
+ *
+ * @return pointer to the new Ranking
+ */
+Ranking *makeRanking()
+{
+  Ranking *ranking = ( Ranking *)malloc( sizeof( Ranking ) );
+  ranking->height = 1;
+  ranking->head = makeNode( RANK_LEVELS );
+  return ranking;
+}
+
+/**
+ * Frees a ranking and every node in it.
+ *
+ * @param ranking to free, or NULL
+ */
+void freeRanking( Ranking *ranking )
+{
+  if ( ranking == NULL ) {
+    return;
+  }
+  RankNode *node = ranking->head;
+  while ( node != NULL ) {
+    RankNode *next = node->next[ 0 ];
+    free( node );
+    node = next;
+  }
+  free( ranking );
+}
+
+/**
+ * Picks how many levels a node is on: one more for each pair of bits of a
+ * hash of its key that are both zero, so a quarter of the nodes on each
+ * level are also on the one above.
+ *
+ * @param key the node's key
+ * @return the node's height
+ */
+static int pickHeight( int key )
+{
+  unsigned long long h = ( unsigned int ) key;
+  h = ( h ^ ( h >> 30 ) ) * 0xbf58476d1ce4e5b9ULL + 0x9e3779b97f4a7c15ULL;
+  h = ( h ^ ( h >> 27 ) ) * 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+
+  int height = 1;
+  while ( height < RANK_LEVELS && ( h & 3 ) == 0 ) {
+    height++;
+    h >>= 2;
+  }
+  return height;
+}
+
+/**
+ * Finds the last node on each level that ranks before the given score and
+ * key: a higher score, or the same score and a smaller key.
+ *
+ * @param ranking the ranking
+ * @param score the score
+ * @param key the key
+ * @param before set to the node on each level in use
+ */
+static void findBefore( Ranking const *ranking, int score, int key, RankNode **before )
+{
+  RankNode *node = ranking->head;
+  for ( int level = ranking->height - 1; level >= 0; level-- ) {
+    RankNode *next = node->next[ level ];
+    while ( next != NULL && ( next->score > score || ( next->score == score && next->key < key ) ) ) {
+      node = next;
+      next = node->next[ level ];
+    }
+    before[ level ] = node;
+  }
+}
+
+/**
+ * Links a node in at the place for its score and key.
+ *
+ * @param ranking the ranking
+ * @param node the node
+ */
+static void linkNode( Ranking *ranking, RankNode *node )
+{
+  RankNode *before[ RANK_LEVELS ];
+  if ( node->height > ranking->height ) {
+    ranking->height = node->height;
+  }
+  findBefore( ranking, node->score, node->key, before );
+  for ( int level = 0; level < node->height; level++ ) {
+    node->next[ level ] = before[ level ]->next[ level ];
+    before[ level ]->next[ level ] = node;
+  }
+}
+
+/**
+ * Makes a node for a record and adds it to a ranking with nothing sold.
+ * Its height comes from a hash of key, so it's the same from run to run.
+ *
+ * @param ranking the ranking
+ * @param key breaks ties between records with the same score
+ * @param idx index of the record
+ * @return the new node
+ */
+RankNode *addRanked( Ranking *ranking, int key, int idx )
+{
+  RankNode *node = makeNode( pickHeight( key ) );
+  node->key = key;
+  node->idx = idx;
+  linkNode( ranking, node );
+  return node;
+}
+
+/**
+ * Moves a node to its place for a new score.
+ *
+ * @param ranking the ranking holding the node
+ * @param node the node
+ * @param sold how many its record has now sold
+ * @param score its new score
+ */
+void updateRanked( Ranking *ranking, RankNode *node, int sold, int score )
+{
+  node->sold = sold;
+  if ( score == node->score ) {
+    return;
+  }
+
+  // unlink it from where it was, then link it in again at its new place
+  RankNode *before[ RANK_LEVELS ];
+  findBefore( ranking, node->score, node->key, before );
+  for ( int level = 0; level < node->height; level++ ) {
+    before[ level ]->next[ level ] = node->next[ level ];
+  }
+  node->score = score;
+  linkNode( ranking, node );
+}
+
+/**
+ * Returns the node at the given rank, counting from 0, by walking the
+ * bottom level.
+ *
+ * @param ranking the ranking
+ * @param rank the rank
+ * @return the node, or NULL if the ranking is shorter than that
+ */
+RankNode *rankedAt( Ranking const *ranking, int rank )
+{
+  RankNode *node = ranking->head->next[ 0 ];
+  for ( int i = 0; i < rank && node != NULL; i++ ) {
+    node = node->next[ 0 ];
+  }
+  return node;
+}
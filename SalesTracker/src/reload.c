@@ -0,0 +1,488 @@
+/**
+ * @file reload.c
+ * @author Luke Early
+ * Source file for reloading the item and member files of a running group.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reload.h"
+#include "snapshot.h"
+#include "lazy.h"
+#include "intern.h"
+#include "ranking.h"
+
+/**
+ * Everything a reload is going to change, worked out before the group is
+ * locked. Only a reload adds records or changes names and costs, and only
+ * one runs at a time, so this can be done against the live group without
+ * holding its lock.
+ */
+struct PlanStruct {
+  Load *items;
+  Load *members;
+  FileMark itemMark;   // the files as they'll be once the plan is applied
+  FileMark memberMark;
+  Item **newItems;
+  int newItemCount;
+  int *changedIdx;     // index of each changed item in iList
+  Item **changedItems; // the new version of each
+  int changedItemCount;
+  char **newMembers;   // ID then name of each new member, in the member file's buffer
+  int newMemberCount;
+  int *renamedIdx;
+  char **renamedNames;
+  int renamedCount;
+};
+typedef struct PlanStruct Plan;
+
+/**
+ * Makes the reload state for a group, with no reload running.
+ *
+ * @return pointer to the new Reload
+ */
+Reload *makeReload()
+{
+  Reload *reload = ( Reload *)calloc( 1, sizeof( Reload ) );
+  pthread_mutex_init( &reload->apply, NULL );
+  pthread_mutex_init( &reload->lock, NULL );
+  return reload;
+}
+
+/**
+ * Waits for any reload still running, then frees the reload state.
+ *
+ * @param reload to free
+ */
+void freeReload( Reload *reload )
+{
+  if ( reload->started ) {
+    pthread_join( reload->thread, NULL );
+  }
+  pthread_mutex_destroy( &reload->apply );
+  pthread_mutex_destroy( &reload->lock );
+  free( reload );
+}
+
+/**
+ * Returns a power of two table size with room for count entries at no
+ * more than half full.
+ *
+ * @param count number of entries
+ * @return table size
+ */
+static int tableSize( int count )
+{
+  int size = 16;
+  while ( size < count * 2 ) {
+    size *= 2;
+  }
+  return size;
+}
+
+/**
+ * Frees every item record parsed into a load.
+ *
+ * @param load the loaded item file
+ */
+static void freeItemRecords( Load *load )
+{
+  for ( int c = 0; c < load->chunkCount; c++ ) {
+    for ( int i = 0; i < load->chunks[ c ].count; i++ ) {
+      free( load->chunks[ c ].records[ i ] );
+    }
+  }
+}
+
+/**
+ * Loads the item file again and works out which items are new and which
+ * have a new name or cost. Unchanged records are freed as they're found.
+ *
+ * @param group the live group
+ * @param plan the plan to fill in
+ * @param result set to what went wrong, if anything
+ * @return false if the file can't be read or isn't valid
+ */
+static bool planItems( Group *group, Plan *plan, char *result )
+{
+  plan->itemMark = group->itemMark;
+  Load *load = loadFile( group->itemFile, parseItemLine, &plan->itemMark );
+  if ( load == NULL ) {
+    snprintf( result, RESULT_MAX, "Reload failed: Can't open file: %s", group->itemFile );
+    return false;
+  }
+  plan->items = load;
+  if ( loadInvalid( load ) ) {
+    freeItemRecords( load );
+    snprintf( result, RESULT_MAX, "Reload failed: Invalid item file: %s", group->itemFile );
+    return false;
+  }
+
+  int count = loadCount( load );
+  plan->newItems = ( Item **)malloc( ( count + 1 ) * sizeof( Item * ) );
+  plan->changedIdx = ( int *)malloc( ( count + 1 ) * sizeof( int ) );
+  plan->changedItems = ( Item **)malloc( ( count + 1 ) * sizeof( Item * ) );
+
+  // one table for the IDs of the current items (index + 1) and the new
+  // ones in the file (-(position in newItems + 1)), so a repeated ID is
+  // found in a single pass
+  int size = tableSize( group->iCount + count );
+  int *table = ( int *)calloc( size, sizeof( int ) );
+  bool *seen = ( bool *)calloc( group->iCount + 1, sizeof( bool ) );
+  for ( int i = 0; i < group->iCount; i++ ) {
+    unsigned int slot = ( unsigned int ) group->iList[ i ]->id * 2654435761u & ( size - 1 );
+    while ( table[ slot ] != 0 ) {
+      slot = ( slot + 1 ) & ( size - 1 );
+    }
+    table[ slot ] = i + 1;
+  }
+
+  bool duplicate = false;
+  for ( int c = 0; c < load->chunkCount; c++ ) {
+    for ( int i = 0; i < load->chunks[ c ].count; i++ ) {
+      Item *record = ( Item *)load->chunks[ c ].records[ i ];
+      if ( duplicate ) {
+        free( record );
+        continue;
+      }
+
+      unsigned int slot = ( unsigned int ) record->id * 2654435761u & ( size - 1 );
+      int entry = 0;
+      while ( table[ slot ] != 0 ) {
+        entry = table[ slot ];
+        Item const *other = entry > 0 ? group->iList[ entry - 1 ] : plan->newItems[ -entry - 1 ];
+        if ( other->id == record->id ) {
+          break;
+        }
+        entry = 0;
+        slot = ( slot + 1 ) & ( size - 1 );
+      }
+
+      if ( entry == 0 ) {
+        table[ slot ] = -( plan->newItemCount + 1 );
+        plan->newItems[ plan->newItemCount++ ] = record;
+      } else if ( entry < 0 || seen[ entry - 1 ] || load->appended ) {
+        // appended lines can't repeat an ID from the lines before them
+        duplicate = true;
+        free( record );
+      } else {
+        Item const *item = group->iList[ entry - 1 ];
+        seen[ entry - 1 ] = true;
+        if ( item->cost != record->cost || strcmp( item->name, record->name ) != 0 ) {
+          plan->changedIdx[ plan->changedItemCount ] = entry - 1;
+          plan->changedItems[ plan->changedItemCount++ ] = record;
+        } else {
+          free( record );
+        }
+      }
+    }
+  }
+  free( table );
+  free( seen );
+
+  if ( duplicate ) {
+    snprintf( result, RESULT_MAX, "Reload failed: Invalid item file: %s", group->itemFile );
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Loads the member file again and works out which members are new and
+ * which have a new name.
+ *
+ * @param group the live group
+ * @param plan the plan to fill in
+ * @param result set to what went wrong, if anything
+ * @return false if the file can't be read or isn't valid
+ */
+static bool planMembers( Group *group, Plan *plan, char *result )
+{
+  plan->memberMark = group->memberMark;
+  Load *load = loadFile( group->memberFile, parseMemberLine, &plan->memberMark );
+  if ( load == NULL ) {
+    snprintf( result, RESULT_MAX, "Reload failed: Can't open file: %s", group->memberFile );
+    return false;
+  }
+  plan->members = load;
+  if ( loadInvalid( load ) ) {
+    snprintf( result, RESULT_MAX, "Reload failed: Invalid member file: %s", group->memberFile );
+    return false;
+  }
+
+  int count = loadCount( load );
+  plan->newMembers = ( char **)malloc( ( count + 1 ) * sizeof( char * ) );
+  plan->renamedIdx = ( int *)malloc( ( count + 1 ) * sizeof( int ) );
+  plan->renamedNames = ( char **)malloc( ( count + 1 ) * sizeof( char * ) );
+
+  // IDs from this file, to catch one that's listed twice
+  StrPool *fileIds = makePool();
+  bool duplicate = false;
+
+  for ( int c = 0; c < load->chunkCount && !duplicate; c++ ) {
+    for ( int i = 0; i < load->chunks[ c ].count && !duplicate; i++ ) {
+      char *id = load->chunks[ c ].records[ i ];
+      char *name = id + strlen( id ) + 1;
+
+      if ( internString( fileIds, id ) != fileIds->count - 1 ) {
+        duplicate = true;
+        break;
+      }
+
+      // a lazily loaded member that hasn't been made yet is still a member
+      int idx = findMember( group, id );
+      if ( idx < 0 ) {
+        plan->newMembers[ plan->newMemberCount++ ] = id;
+      } else if ( load->appended ) {
+        duplicate = true;
+      } else if ( strcmp( liveMemberName( group, idx ), name ) != 0 ) {
+        plan->renamedIdx[ plan->renamedCount ] = idx;
+        plan->renamedNames[ plan->renamedCount++ ] = name;
+      }
+    }
+  }
+  freePool( fileIds );
+
+  if ( duplicate ) {
+    snprintf( result, RESULT_MAX, "Reload failed: Invalid member file: %s", group->memberFile );
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Replaces a live item with a new version of it that has a different name
+ * or cost. The sales recorded for the old one move to the new one, and
+ * every member who sold it is pointed at the new one. A new cost moves it
+ * in the revenue leaderboards. The old item is retired, since earlier
+ * snapshots can still reach it.
+ * Must be called with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param item the new version of the item
+ */
+static void replaceItem( Group *group, int idx, Item *item )
+{
+  Item *old = group->iList[ idx ];
+  item->numSold = old->numSold;
+  item->version = old->version;
+  item->sellers = old->sellers;
+  group->totalSales += old->numSold * ( item->cost - old->cost );
+  group->iList[ idx ] = item;
+  if ( item->cost != old->cost ) {
+    rescoreItem( group, idx );
+  }
+
+  // every member who sold it is ranked in one of its seller shards, by index
+  for ( int i = 0; item->sellers != NULL && i < SELLER_SHARDS; i++ ) {
+    for ( RankNode *node = rankedAt( item->sellers[ i ], 0 ); node != NULL; node = node->next[ 0 ] ) {
+      Member *member = group->mList[ node->idx ];
+      for ( int j = 0; j < member->count; j++ ) {
+        if ( member->list[ j ]->itemPtr == old ) {
+          member->list[ j ]->itemPtr = item;
+          member->sales += member->list[ j ]->numSold * ( item->cost - old->cost );
+        }
+      }
+      markMemberChanged( group, node->idx );
+    }
+  }
+
+  old->sellers = NULL;
+  retireItem( group, old );
+  markItemChanged( group, idx );
+}
+
+/**
+ * Applies a plan to the live group as a single new group version.
+ *
+ * @param group the live group
+ * @param plan what to change
+ */
+static void applyPlan( Group *group, Plan *plan )
+{
+  pthread_mutex_lock( &group->reload->apply );
+  lockGroup( group );
+  newVersion( group );
+
+  for ( int i = 0; i < plan->changedItemCount; i++ ) {
+    replaceItem( group, plan->changedIdx[ i ], plan->changedItems[ i ] );
+  }
+
+  if ( group->iCount + plan->newItemCount > group->iCap ) {
+    while ( group->iCount + plan->newItemCount > group->iCap ) {
+      group->iCap *= 2;
+    }
+    group->iList = ( Item **)realloc( group->iList, group->iCap * sizeof( Item * ) );
+  }
+  reserveVersions( group );
+  for ( int i = 0; i < plan->newItemCount; i++ ) {
+    Item *item = plan->newItems[ i ];
+    group->iList[ group->iCount++ ] = item;
+    markItemChanged( group, group->iCount - 1 );
+  }
+
+  if ( group->mCount + plan->newMemberCount > group->mCap ) {
+    while ( group->mCount + plan->newMemberCount > group->mCap ) {
+      group->mCap *= 2;
+    }
+    group->mList = ( Member **)realloc( group->mList, group->mCap * sizeof( Member * ) );
+  }
+  reserveVersions( group );
+  for ( int i = 0; i < plan->newMemberCount; i++ ) {
+    char const *id = plan->newMembers[ i ];
+    StrHandle idHandle = internString( group->ids, id );
+    StrHandle nameHandle = internString( group->names, id + strlen( id ) + 1 );
+    group->mList[ group->mCount++ ] = makeMember( idHandle, nameHandle );
+    markMemberChanged( group, group->mCount - 1 );
+  }
+
+  for ( int i = 0; i < plan->renamedCount; i++ ) {
+    loadMember( group, plan->renamedIdx[ i ] )->name = internString( group->names, plan->renamedNames[ i ] );
+    markMemberChanged( group, plan->renamedIdx[ i ] );
+  }
+
+  group->itemMark = plan->itemMark;
+  group->memberMark = plan->memberMark;
+  unlockGroup( group );
+  pthread_mutex_unlock( &group->reload->apply );
+}
+
+/**
+ * Frees a plan. Item records it still holds are freed too, unless the plan
+ * was applied and they now belong to the group.
+ *
+ * @param plan the plan to free
+ * @param applied true if the plan was applied
+ */
+static void freePlan( Plan *plan, bool applied )
+{
+  if ( !applied ) {
+    for ( int i = 0; i < plan->newItemCount; i++ ) {
+      free( plan->newItems[ i ] );
+    }
+    for ( int i = 0; i < plan->changedItemCount; i++ ) {
+      free( plan->changedItems[ i ] );
+    }
+  }
+  if ( plan->items != NULL ) {
+    freeLoad( plan->items );
+  }
+  if ( plan->members != NULL ) {
+    freeLoad( plan->members );
+  }
+  free( plan->newItems );
+  free( plan->changedIdx );
+  free( plan->changedItems );
+  free( plan->newMembers );
+  free( plan->renamedIdx );
+  free( plan->renamedNames );
+}
+
+/**
+ * Body of the reload thread: plans the reload, applies it if both files
+ * are valid, and leaves a message saying how it went.
+ *
+ * @param arg the live group
+ * @return NULL
+ */
+static void *reloadFiles( void *arg )
+{
+  Group *group = ( Group *)arg;
+  Plan plan;
+  memset( &plan, 0, sizeof( Plan ) );
+  char result[ RESULT_MAX + 1 ] = "";
+
+  bool valid = planItems( group, &plan, result ) && planMembers( group, &plan, result );
+  if ( valid ) {
+    applyPlan( group, &plan );
+    snprintf( result, RESULT_MAX, "Reloaded: %d items added, %d items changed, %d members added, %d members changed",
+              plan.newItemCount, plan.changedItemCount, plan.newMemberCount, plan.renamedCount );
+  }
+  freePlan( &plan, valid );
+
+  Reload *reload = group->reload;
+  pthread_mutex_lock( &reload->lock );
+  strcpy( reload->result, result );
+  reload->count++;
+  reload->running = false;
+  pthread_mutex_unlock( &reload->lock );
+  return NULL;
+}
+
+/**
+ * Starts reloading the group's item and member files on a background
+ * thread. Parsing, validation and working out what changed all happen on
+ * that thread; the changes are then applied under the group's write lock
+ * as a single new group version.
+ *
+ * @param group the live group
+ * @return false if a reload is already running
+ */
+bool startReload( Group *group )
+{
+  Reload *reload = group->reload;
+  pthread_mutex_lock( &reload->lock );
+  if ( reload->running ) {
+    pthread_mutex_unlock( &reload->lock );
+    return false;
+  }
+
+  // the last reload's thread has finished, so this doesn't wait
+  if ( reload->started ) {
+    pthread_join( reload->thread, NULL );
+    reload->started = false;
+  }
+
+  reload->running = true;
+  reload->started = pthread_create( &reload->thread, NULL, reloadFiles, group ) == 0;
+  if ( !reload->started ) {
+    reload->running = false;
+    snprintf( reload->result, RESULT_MAX, "Reload failed: can't start a thread" );
+  }
+  pthread_mutex_unlock( &reload->lock );
+  return true;
+}
+
+/**
+ * Holds off applying any reload until releaseReloads() is called. A reload
+ * that finishes planning in the meantime waits, so everything read while
+ * reloads are held off comes from the same records.
+ *
+ * @param group the live group
+ */
+void holdReloads( Group *group )
+{
+  pthread_mutex_lock( &group->reload->apply );
+}
+
+/**
+ * Lets a reload held off by holdReloads() apply its changes.
+ *
+ * @param group the live group
+ */
+void releaseReloads( Group *group )
+{
+  pthread_mutex_unlock( &group->reload->apply );
+}
+
+/**
+ * Prints whether a reload is running, or how the last one went.
+ *
+ * @param group the live group
+ * @param out stream the status is written to
+ */
+void reloadStatus( Group *group, FILE *out )
+{
+  Reload *reload = group->reload;
+  pthread_mutex_lock( &reload->lock );
+  if ( reload->running ) {
+    fprintf( out, "Reload running\n" );
+  } else if ( reload->count == 0 && reload->result[ 0 ] == '\0' ) {
+    fprintf( out, "No reload yet\n" );
+  } else {
+    fprintf( out, "%s\n", reload->result );
+  }
+  pthread_mutex_unlock( &reload->lock );
+}
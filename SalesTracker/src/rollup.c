@@ -0,0 +1,424 @@
+/**
+ * @file rollup.c
+ * @author Luke Early
+ * Source file for per-minute, per-hour and per-day sales rollups.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "rollup.h"
+#include "snapshot.h"
+#include "trace.h"
+
+/** Seconds covered by one bucket at each level */
+static long long const widths[ ROLLUP_LEVELS ] = { 60, 60 * 60, 24 * 60 * 60 };
+
+/** Buckets in the ring at each level */
+static int const sizes[ ROLLUP_LEVELS ] = { MINUTE_BUCKETS, HOUR_BUCKETS, DAY_BUCKETS };
+
+/** Where each level's ring starts in a rollup's buckets */
+static int const starts[ ROLLUP_LEVELS ] = { 0, MINUTE_BUCKETS, MINUTE_BUCKETS + HOUR_BUCKETS };
+
+/** Names of the units of each level, singular then plural */
+static char const *const units[ ROLLUP_LEVELS ][ 2 ] = {
+  { "minute", "minutes" }, { "hour", "hours" }, { "day", "days" }
+};
+
+/** Tally tables start with this many slots */
+#define INIT_TALLIES 16
+
+/**
+ * Makes an empty rollup.
+ *
+ * @return pointer to the new Rollup
+ */
+Rollup *makeRollup()
+{
+  Rollup *rollup = ( Rollup *)calloc( 1, sizeof( Rollup ) );
+  for ( int i = 0; i < ROLLUP_BUCKETS; i++ ) {
+    rollup->buckets[ i ].number = -1;
+  }
+  return rollup;
+}
+
+/**
+ * Frees a rollup and the tallies in it.
+ *
+ * @param rollup to free, or NULL
+ */
+void freeRollup( Rollup *rollup )
+{
+  if ( rollup == NULL ) {
+    return;
+  }
+  for ( int i = 0; i < ROLLUP_BUCKETS; i++ ) {
+    free( rollup->buckets[ i ].tallies.slots );
+  }
+  free( rollup );
+}
+
+/**
+ * Finds the slot for a member and item in a tally table: the one holding
+ * their tally, or the empty one it would go in.
+ *
+ * @param table the table, with at least one empty slot
+ * @param member index of the member
+ * @param item index of the item
+ * @return the slot
+ */
+static Tally *findTally( TallyTable const *table, int member, int item )
+{
+  unsigned long long h = ( ( unsigned long long ) ( unsigned int ) member << 32 | ( unsigned int ) item )
+                         * 0x9e3779b97f4a7c15ULL;
+  int mask = table->cap - 1;
+  int at = ( int ) ( h >> 40 ) & mask;
+  while ( table->slots[ at ].member >= 0
+          && ( table->slots[ at ].member != member || table->slots[ at ].item != item ) ) {
+    at = ( at + 1 ) & mask;
+  }
+  return &table->slots[ at ];
+}
+
+/**
+ * Makes a tally table's slots, or doubles them, moving every tally to its
+ * slot in the new ones.
+ *
+ * @param table the table
+ */
+static void growTallies( TallyTable *table )
+{
+  Tally *old = table->slots;
+  int oldCap = table->cap;
+  table->cap = oldCap == 0 ? INIT_TALLIES : oldCap * 2;
+  table->slots = ( Tally *)malloc( table->cap * sizeof( Tally ) );
+  for ( int i = 0; i < table->cap; i++ ) {
+    table->slots[ i ].member = -1;
+  }
+  for ( int i = 0; i < oldCap; i++ ) {
+    if ( old[ i ].member >= 0 ) {
+      *findTally( table, old[ i ].member, old[ i ].item ) = old[ i ];
+    }
+  }
+  free( old );
+}
+
+/**
+ * Adds sold and sales to the tally for a member and item in a table,
+ * making it if it isn't there.
+ *
+ * @param table the table
+ * @param member index of the member
+ * @param item index of the item
+ * @param sold how many were sold
+ * @param sales what they were worth
+ */
+void addTally( TallyTable *table, int member, int item, int sold, int sales )
+{
+  // kept no more than half full, so a search soon finds an empty slot
+  if ( ( table->count + 1 ) * 2 > table->cap ) {
+    growTallies( table );
+  }
+  Tally *tally = findTally( table, member, item );
+  if ( tally->member < 0 ) {
+    tally->member = member;
+    tally->item = item;
+    tally->sold = 0;
+    tally->sales = 0;
+    table->count++;
+  }
+  tally->sold += sold;
+  tally->sales += sales;
+}
+
+/**
+ * Frees the slots of a tally table, leaving it empty.
+ *
+ * @param table the table
+ */
+void clearTallies( TallyTable *table )
+{
+  free( table->slots );
+  table->slots = NULL;
+  table->cap = 0;
+  table->count = 0;
+}
+
+/**
+ * Adds a sale to the bucket holding its time at every level, clearing
+ * out a bucket that held an older minute, hour or day first.
+ *
+ * @param rollup the rollup
+ * @param time when the sale happened, in seconds since the epoch
+ * @param member index of the member who made it
+ * @param item index of the item sold
+ * @param sold how many were sold
+ */
+void addRollup( Rollup *rollup, long long time, int member, int item, int sold )
+{
+  for ( int level = 0; level < ROLLUP_LEVELS; level++ ) {
+    long long number = time / widths[ level ];
+    Bucket *bucket = &rollup->buckets[ starts[ level ] + number % sizes[ level ] ];
+
+    // a bucket holding a later minute, hour or day means this sale is older
+    // than the ring reaches back, so it only counts in coarser levels
+    if ( bucket->number > number ) {
+      continue;
+    }
+    if ( bucket->number < number ) {
+      bucket->number = number;
+      bucket->sold = 0;
+      bucket->tallies.count = 0;
+      for ( int i = 0; i < bucket->tallies.cap; i++ ) {
+        bucket->tallies.slots[ i ].member = -1;
+      }
+    }
+    bucket->sold += sold;
+    addTally( &bucket->tallies, member, item, sold, 0 );
+  }
+}
+
+/**
+ * Finds the bucket holding the given minute, hour or day, if the rollup
+ * still has it.
+ *
+ * @param rollup the rollup
+ * @param level the level
+ * @param number which minute, hour or day since the epoch
+ * @return the bucket, or NULL if it has been reused or never had a sale
+ */
+static Bucket const *findBucket( Rollup const *rollup, int level, long long number )
+{
+  Bucket const *bucket = &rollup->buckets[ starts[ level ] + number % sizes[ level ] ];
+  return bucket->number == number ? bucket : NULL;
+}
+
+/**
+ * Adds up how many were sold in a window.
+ *
+ * @param rollup the rollup
+ * @param window the window
+ * @return how many were sold in it
+ */
+int sumRollup( Rollup const *rollup, Window const *window )
+{
+  int sold = 0;
+  long long last = window->now / widths[ window->level ];
+  for ( long long n = last - window->count + 1; n <= last; n++ ) {
+    Bucket const *bucket = findBucket( rollup, window->level, n );
+    sold += bucket == NULL ? 0 : bucket->sold;
+  }
+  return sold;
+}
+
+/**
+ * Adds every tally in a window to a table, by member and item, valuing
+ * them at the costs of the given items. Tallies of items or members past
+ * the given counts, added after the caller looked, are left out.
+ *
+ * @param rollup the rollup
+ * @param window the window
+ * @param items the items, by index
+ * @param itemCount how many items there are
+ * @param memberCount how many members to count
+ * @param table where the tallies are added
+ */
+void tallyRollup( Rollup const *rollup, Window const *window, Item *const *items, int itemCount, int memberCount,
+                  TallyTable *table )
+{
+  long long last = window->now / widths[ window->level ];
+  for ( long long n = last - window->count + 1; n <= last; n++ ) {
+    Bucket const *bucket = findBucket( rollup, window->level, n );
+    for ( int i = 0; bucket != NULL && i < bucket->tallies.cap; i++ ) {
+      Tally const *tally = &bucket->tallies.slots[ i ];
+      if ( tally->member >= 0 && tally->member < memberCount && tally->item < itemCount ) {
+        addTally( table, tally->member, tally->item, tally->sold, tally->sold * items[ tally->item ]->cost );
+      }
+    }
+  }
+}
+
+/**
+ * Parses the window at the end of a windowed report, such as
+ * "last 3 hours". The unit may be minute, hour or day, or their plurals.
+ *
+ * @param count how many units
+ * @param unit the unit
+ * @param now when the window ends, in seconds since the epoch
+ * @param window set to the window ending at now
+ * @return false if the unit is unknown or count isn't from 1 up to the
+ *         number of buckets kept for it
+ */
+bool parseWindow( int count, char const *unit, long long now, Window *window )
+{
+  for ( int level = 0; level < ROLLUP_LEVELS; level++ ) {
+    if ( strcmp( unit, units[ level ][ 0 ] ) == 0 || strcmp( unit, units[ level ][ 1 ] ) == 0 ) {
+      if ( count < 1 || count > sizes[ level ] ) {
+        return false;
+      }
+      window->level = level;
+      window->count = count;
+      window->now = now;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Makes an empty view sharing a read view's ID and name pools.
+ *
+ * @param view the read view
+ * @return the new view
+ */
+static Group *makeWindowView( Group const *view )
+{
+  Group *window = ( Group *)calloc( 1, sizeof( Group ) );
+  window->ids = view->ids;
+  window->names = view->names;
+  return window;
+}
+
+/**
+ * Adds up the tallies of every one of the group's rollups in a window,
+ * each shard locked in turn just long enough to add up its own.
+ *
+ * Only the records in the view's snapshot are counted.
+ *
+ * @param group the live group
+ * @param view the read view whose items give the costs
+ * @param window the window
+ * @param table where the tallies are added
+ */
+static void tallyWindow( Group *group, Group const *view, Window const *window, TallyTable *table )
+{
+  Snapshot const *snap = view->snapshot;
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    lockShard( group, i );
+    tallyRollup( group->rollups[ i ], window, view->iList, view->iCount, snap->mCount, table );
+    unlockShard( group, i );
+  }
+}
+
+/**
+ * Makes a read view of the items holding only what was sold in a window,
+ * from the group's rollups. Each item in it is a copy whose count sold is
+ * its count in the window, so its sales are that count times its cost.
+ * The group totals are for the window, so the view can be listed like any
+ * other view.
+ *
+ * @param group the live group
+ * @param view a read view from openView()
+ * @param window the window
+ * @return the windowed view, with no members
+ */
+Group *openItemWindow( Group *group, Group const *view, Window const *window )
+{
+  traceBegin( "window", NULL );
+  TallyTable table = { NULL, 0, 0 };
+  tallyWindow( group, view, window, &table );
+
+  Group *windowed = makeWindowView( view );
+  Item *copies = ( Item *)malloc( ( view->iCount + 1 ) * sizeof( Item ) );
+  windowed->windowRecords = copies;
+  windowed->iList = ( Item **)malloc( ( view->iCount + 1 ) * sizeof( Item * ) );
+  windowed->iCount = view->iCount;
+  windowed->iCap = view->iCount + 1;
+  for ( int i = 0; i < view->iCount; i++ ) {
+    copies[ i ] = *view->iList[ i ];
+    copies[ i ].numSold = 0;
+    windowed->iList[ i ] = copies + i;
+  }
+
+  for ( int i = 0; i < table.cap; i++ ) {
+    Tally const *tally = &table.slots[ i ];
+    if ( tally->member >= 0 ) {
+      copies[ tally->item ].numSold += tally->sold;
+      windowed->totalSold += tally->sold;
+      windowed->totalSales += tally->sales;
+    }
+  }
+  clearTallies( &table );
+  traceEnd( "window" );
+  return windowed;
+}
+
+/**
+ * Makes a read view of the members holding only what they sold in a
+ * window, the way openItemWindow() does for items. A member's sales in a
+ * window are what it sold of each item times the item's cost.
+ *
+ * @param group the live group
+ * @param view a read view from openView(); its members are taken from
+ *             its snapshot, so it only needs them if soldOnly is false
+ * @param window the window
+ * @param soldOnly true to leave out the members who sold nothing in the
+ *                 window, so the view is made without looking at them
+ * @return the windowed view, with no items
+ */
+Group *openMemberWindow( Group *group, Group const *view, Window const *window, bool soldOnly )
+{
+  traceBegin( "window", NULL );
+  TallyTable table = { NULL, 0, 0 };
+  tallyWindow( group, view, window, &table );
+
+  // a member's tallies for each item are added up under item 0
+  TallyTable byMember = { NULL, 0, 0 };
+  for ( int i = 0; i < table.cap; i++ ) {
+    Tally const *tally = &table.slots[ i ];
+    if ( tally->member >= 0 ) {
+      addTally( &byMember, tally->member, 0, tally->sold, tally->sales );
+    }
+  }
+  clearTallies( &table );
+
+  Group *windowed = makeWindowView( view );
+  Snapshot const *snap = view->snapshot;
+  int count = soldOnly ? byMember.count : snap->mCount;
+  Member *copies = ( Member *)malloc( ( count + 1 ) * sizeof( Member ) );
+  windowed->windowRecords = copies;
+  windowed->mList = ( Member **)malloc( ( count + 1 ) * sizeof( Member * ) );
+  windowed->mCount = count;
+  windowed->mCap = count + 1;
+  if ( !soldOnly ) {
+    for ( int i = 0; i < count; i++ ) {
+      copies[ i ] = *snap->mPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ];
+      copies[ i ].sold = 0;
+      copies[ i ].sales = 0;
+      windowed->mList[ i ] = copies + i;
+    }
+  }
+
+  int made = 0;
+  for ( int i = 0; i < byMember.cap; i++ ) {
+    Tally const *tally = &byMember.slots[ i ];
+    if ( tally->member < 0 ) {
+      continue;
+    }
+    Member *copy = copies + tally->member;
+    if ( soldOnly ) {
+      copy = copies + made;
+      *copy = *snap->mPages[ tally->member >> PAGE_SHIFT ][ tally->member & PAGE_MASK ];
+      windowed->mList[ made++ ] = copy;
+    }
+    copy->sold = tally->sold;
+    copy->sales = tally->sales;
+    windowed->totalSold += tally->sold;
+    windowed->totalSales += tally->sales;
+  }
+  clearTallies( &byMember );
+  traceEnd( "window" );
+  return windowed;
+}
+
+/**
+ * Frees a view made by openItemWindow() or openMemberWindow().
+ *
+ * @param window the windowed view
+ */
+void closeWindowView( Group *window )
+{
+  free( window->windowRecords );
+  free( window->iList );
+  free( window->mList );
+  free( window );
+}
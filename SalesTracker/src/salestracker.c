@@ -0,0 +1,139 @@
+/**
+ * @file salestracker.c
+ * @author Luke Early
+ * Source file for the public C interface of libsalestracker.
+ */
+#include <string.h>
+
+#include "salestracker.h"
+#include "group.h"
+#include "snapshot.h"
+#include "lazy.h"
+#include "command.h"
+
+/**
+ * Loads a group from an item file and a member file. If either file can't
+ * be opened or is invalid, a message is printed to stderr.
+ *
+ * @param itemFile name of the item file
+ * @param memberFile name of the member file
+ * @return the new group, or NULL if it couldn't be loaded
+ */
+StGroup *st_open( char const *itemFile, char const *memberFile )
+{
+  Group *group = makeGroup();
+  if ( !readItems( itemFile, group ) || !readMembers( memberFile, group ) ) {
+    freeGroup( group );
+    return NULL;
+  }
+  return group;
+}
+
+/**
+ * Frees a group. No other thread may still be using it.
+ *
+ * @param group the group to free
+ */
+void st_close( StGroup *group )
+{
+  freeGroup( group );
+}
+
+/**
+ * Records a sale of qty of the given item by the given member.
+ *
+ * @param group the group
+ * @param memberId ID of the member who made the sale
+ * @param itemId ID of the item that was sold
+ * @param qty how many were sold
+ * @return false if the member or item doesn't exist or qty isn't positive
+ */
+bool st_record_sale( StGroup *group, char const *memberId, int itemId, int qty )
+{
+  return recordSale( group, memberId, itemId, qty );
+}
+
+/**
+ * Gets the current totals for one item.
+ *
+ * @param group the group
+ * @param itemId ID of the item
+ * @param info set to the item's totals
+ * @return false if there is no such item
+ */
+bool st_query_item( StGroup *group, int itemId, StItemInfo *info )
+{
+  // on the shared side no reload can replace the item under us
+  enterGroup( group );
+  int idx = findItem( group, itemId );
+  if ( idx < 0 ) {
+    leaveGroup( group );
+    return false;
+  }
+
+  Item *item = group->iList[ idx ];
+  info->id = item->id;
+  strcpy( info->name, item->name );
+  info->cost = item->cost;
+  info->sold = __atomic_load_n( &item->numSold, __ATOMIC_RELAXED );
+  info->sales = info->sold * item->cost;
+  leaveGroup( group );
+  return true;
+}
+
+/**
+ * Gets the current totals for one member.
+ *
+ * @param group the group
+ * @param memberId ID of the member
+ * @param info set to the member's totals
+ * @return false if there is no such member
+ */
+bool st_query_member( StGroup *group, char const *memberId, StMemberInfo *info )
+{
+  enterGroup( group );
+  int idx = findMember( group, memberId );
+  if ( idx < 0 ) {
+    leaveGroup( group );
+    return false;
+  }
+
+  Member *member = loadMember( group, idx );
+  strcpy( info->id, memberId );
+  strcpy( info->name, memberName( group, member ) );
+
+  // both totals change together while the member is selling
+  lockMember( group, idx );
+  info->sold = member->sold;
+  info->sales = member->sales;
+  unlockMember( group, idx );
+  leaveGroup( group );
+  return true;
+}
+
+/**
+ * Gets the current totals for the whole group.
+ *
+ * @param group the group
+ * @param sold set to how many items have been sold
+ * @param sales set to what they were worth
+ */
+void st_query_totals( StGroup *group, int *sold, int *sales )
+{
+  *sold = __atomic_load_n( &group->totalSold, __ATOMIC_RELAXED );
+  *sales = __atomic_load_n( &group->totalSales, __ATOMIC_RELAXED );
+}
+
+/**
+ * Runs one line of the fundraiser command language, such as
+ * "list topsellers", writing its output to out.
+ *
+ * @param group the group
+ * @param command the command line, without its trailing newline
+ * @param out stream the command's output is written to
+ * @return false if the command was quit, true otherwise
+ */
+bool st_run_command( StGroup *group, char const *command, FILE *out )
+{
+  return runCommand( group, command, out );
+}
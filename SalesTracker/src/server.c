@@ -0,0 +1,472 @@
+/**
+ * @file server.c
+ * @author Luke Early
+ * Source file for the Unix domain socket server.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "server.h"
+#include "command.h"
+
+/** Set from the signal handler to stop the event loop */
+static volatile sig_atomic_t stopServer = 0;
+
+/**
+ * Buffers for one connected client.
+ */
+struct ConnectionStruct {
+  int fd;
+  char *in;
+  int inLen;
+  int inCap;
+  char *out;
+  size_t outLen;
+  size_t outPos;
+  size_t outCap;
+  bool closing; // close once out has been sent
+  struct ConnectionStruct *prev;
+  struct ConnectionStruct *next;
+};
+typedef struct ConnectionStruct Connection;
+
+/** Every open connection, so they can all be closed when the server stops */
+static Connection *connections = NULL;
+
+/**
+ * Handles SIGINT and SIGTERM by asking the event loop to stop.
+ *
+ * @param sig the signal that was caught
+ */
+static void handleStop( int sig )
+{
+  stopServer = 1;
+}
+
+/**
+ * Puts the given descriptor into non-blocking mode.
+ *
+ * @param fd descriptor to change
+ * @return true if it worked
+ */
+static bool setNonBlocking( int fd )
+{
+  int flags = fcntl( fd, F_GETFL, 0 );
+  return flags != -1 && fcntl( fd, F_SETFL, flags | O_NONBLOCK ) != -1;
+}
+
+/**
+ * Makes a connection for a newly accepted client.
+ *
+ * @param fd the client's socket
+ * @return pointer to the new connection
+ */
+static Connection *makeConnection( int fd )
+{
+  Connection *conn = ( Connection *)malloc( sizeof( Connection ) );
+  conn->fd = fd;
+  conn->inCap = READ_CHUNK;
+  conn->inLen = 0;
+  conn->in = ( char *)malloc( conn->inCap );
+  conn->outCap = 0;
+  conn->outLen = 0;
+  conn->outPos = 0;
+  conn->out = NULL;
+  conn->closing = false;
+  conn->prev = NULL;
+  conn->next = connections;
+  if ( connections != NULL ) {
+    connections->prev = conn;
+  }
+  connections = conn;
+  return conn;
+}
+
+/**
+ * Closes the client's socket and frees the connection.
+ *
+ * @param epfd the event loop's epoll descriptor
+ * @param conn connection to free
+ */
+static void freeConnection( int epfd, Connection *conn )
+{
+  if ( conn->prev != NULL ) {
+    conn->prev->next = conn->next;
+  } else {
+    connections = conn->next;
+  }
+  if ( conn->next != NULL ) {
+    conn->next->prev = conn->prev;
+  }
+
+  epoll_ctl( epfd, EPOLL_CTL_DEL, conn->fd, NULL );
+  close( conn->fd );
+  free( conn->in );
+  free( conn->out );
+  free( conn );
+}
+
+/**
+ * Adds len bytes of command output to the connection's pending output.
+ *
+ * @param conn connection to queue the output on
+ * @param data bytes to queue
+ * @param len number of bytes
+ */
+static void queueOutput( Connection *conn, char const *data, size_t len )
+{
+  // slide unsent bytes to the front before growing
+  if ( conn->outPos > 0 ) {
+    memmove( conn->out, conn->out + conn->outPos, conn->outLen - conn->outPos );
+    conn->outLen -= conn->outPos;
+    conn->outPos = 0;
+  }
+
+  if ( conn->outLen + len > conn->outCap ) {
+    size_t newCap = conn->outCap == 0 ? READ_CHUNK : conn->outCap;
+    while ( newCap < conn->outLen + len ) {
+      newCap *= 2;
+    }
+    conn->out = ( char *)realloc( conn->out, newCap );
+    conn->outCap = newCap;
+  }
+
+  memcpy( conn->out + conn->outLen, data, len );
+  conn->outLen += len;
+}
+
+/**
+ * Tells whether the connection has so much output waiting to be sent that
+ * no more of its input should be read until the client catches up.
+ *
+ * @param conn connection to check
+ * @return true if its unsent output is over OUT_HIGH_WATER
+ */
+static bool outputBacklogged( Connection const *conn )
+{
+  return conn->outLen - conn->outPos > OUT_HIGH_WATER;
+}
+
+/**
+ * Sends as much pending output as the socket will take without blocking,
+ * and updates which events the connection waits for. A connection that's
+ * closing or backlogged stops waiting for input.
+ *
+ * @param epfd the event loop's epoll descriptor
+ * @param conn connection to flush
+ * @return false if the connection should be closed
+ */
+static bool flushOutput( int epfd, Connection *conn )
+{
+  while ( conn->outPos < conn->outLen ) {
+    ssize_t sent = send( conn->fd, conn->out + conn->outPos, conn->outLen - conn->outPos, MSG_NOSIGNAL );
+    if ( sent < 0 ) {
+      if ( errno == EINTR ) {
+        continue;
+      }
+      if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+        break;
+      }
+      return false;
+    }
+    conn->outPos += sent;
+  }
+
+  if ( conn->outPos == conn->outLen ) {
+    conn->outPos = 0;
+    conn->outLen = 0;
+    if ( conn->closing ) {
+      return false;
+    }
+  }
+
+  struct epoll_event ev;
+  ev.events = 0;
+  if ( !conn->closing && !outputBacklogged( conn ) ) {
+    ev.events |= EPOLLIN;
+  }
+  if ( conn->outLen > 0 ) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.ptr = conn;
+  epoll_ctl( epfd, EPOLL_CTL_MOD, conn->fd, &ev );
+  return true;
+}
+
+/**
+ * Runs every complete line in the connection's input buffer, collecting
+ * their output into one buffer queued for sending.
+ *
+ * @param group the group commands run against
+ * @param conn connection whose input is processed
+ */
+static void runLines( Group *group, Connection *conn )
+{
+  char *report = NULL;
+  size_t reportLen = 0;
+  FILE *out = open_memstream( &report, &reportLen );
+
+  int start = 0;
+  for ( int i = 0; i < conn->inLen && !conn->closing; i++ ) {
+    if ( conn->in[ i ] != '\n' ) {
+      continue;
+    }
+
+    conn->in[ i ] = '\0';
+    if ( i > start && conn->in[ i - 1 ] == '\r' ) {
+      conn->in[ i - 1 ] = '\0';
+    }
+
+    if ( conn->in[ start ] != '\0' && !runCommand( group, conn->in + start, out ) ) {
+      conn->closing = true;
+    }
+    start = i + 1;
+  }
+
+  fclose( out );
+  if ( reportLen > 0 ) {
+    queueOutput( conn, report, reportLen );
+  }
+  free( report );
+
+  // keep any partial line for the next read
+  if ( conn->closing ) {
+    conn->inLen = 0;
+  } else {
+    memmove( conn->in, conn->in + start, conn->inLen - start );
+    conn->inLen -= start;
+  }
+}
+
+/**
+ * Reads everything currently available on the connection and runs any
+ * complete commands. Stops early once the connection is backlogged, leaving
+ * the rest in the socket until the client reads its output.
+ *
+ * @param group the group commands run against
+ * @param conn connection to read from
+ * @return false if the connection should be closed
+ */
+static bool readInput( Group *group, Connection *conn )
+{
+  while ( !conn->closing && !outputBacklogged( conn ) ) {
+    if ( conn->inCap - conn->inLen < READ_CHUNK ) {
+      conn->inCap *= 2;
+      conn->in = ( char *)realloc( conn->in, conn->inCap );
+    }
+
+    ssize_t got = read( conn->fd, conn->in + conn->inLen, conn->inCap - conn->inLen );
+    if ( got == 0 ) {
+      // client hung up, but still answer whatever it sent, including a
+      // last line with no newline; the read left room for one more byte
+      if ( conn->inLen > 0 ) {
+        conn->in[ conn->inLen++ ] = '\n';
+        runLines( group, conn );
+      }
+      conn->closing = true;
+      break;
+    }
+    if ( got < 0 ) {
+      if ( errno == EINTR ) {
+        continue;
+      }
+      if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+        break;
+      }
+      return false;
+    }
+
+    conn->inLen += got;
+    runLines( group, conn );
+
+    if ( conn->inLen > LINE_MAX_LEN ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Opens a listening Unix domain socket at the given path, replacing any
+ * stale socket file left behind by an earlier run.
+ *
+ * @param path file system path of the socket
+ * @return the listening descriptor, or -1 on failure
+ */
+static int openListener( char const *path )
+{
+  struct sockaddr_un addr;
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  if ( strlen( path ) >= sizeof( addr.sun_path ) ) {
+    fprintf( stderr, "Socket path too long: %s\n", path );
+    return -1;
+  }
+  strcpy( addr.sun_path, path );
+
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( fd < 0 ) {
+    perror( "socket" );
+    return -1;
+  }
+
+  unlink( path );
+  if ( bind( fd, ( struct sockaddr *)&addr, sizeof( addr ) ) < 0
+       || listen( fd, SOMAXCONN ) < 0 || !setNonBlocking( fd ) ) {
+    perror( path );
+    close( fd );
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * Accepts every client waiting on the listener. If the process is out of
+ * descriptors, the spare descriptor is given up long enough to accept the
+ * next client and close it at once, so it doesn't stay queued and wake the
+ * event loop over and over.
+ *
+ * @param epfd the event loop's epoll descriptor
+ * @param listenFd the listening socket
+ * @param spareFd descriptor held in reserve, or -1 if it couldn't be reopened
+ */
+static void acceptClients( int epfd, int listenFd, int *spareFd )
+{
+  while ( true ) {
+    int clientFd = accept( listenFd, NULL, NULL );
+    if ( clientFd < 0 ) {
+      if ( errno == EINTR ) {
+        continue;
+      }
+      if ( ( errno == EMFILE || errno == ENFILE ) && *spareFd >= 0 ) {
+        // accept() runs out of descriptors before it looks for a client,
+        // so stop once there's none left to turn away
+        close( *spareFd );
+        clientFd = accept( listenFd, NULL, NULL );
+        if ( clientFd >= 0 ) {
+          close( clientFd );
+        }
+        *spareFd = open( "/dev/null", O_RDONLY );
+        if ( clientFd < 0 ) {
+          return;
+        }
+        fprintf( stderr, "Out of descriptors, turned a client away\n" );
+        continue;
+      }
+      return;
+    }
+
+    if ( !setNonBlocking( clientFd ) ) {
+      close( clientFd );
+      continue;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = makeConnection( clientFd );
+    epoll_ctl( epfd, EPOLL_CTL_ADD, clientFd, &ev );
+  }
+}
+
+/**
+ * Serves the command language to any number of clients connected to a Unix
+ * domain socket at the given path.
+ *
+ * Runs a single epoll event loop with non-blocking sockets. Each connection
+ * keeps its own input and output buffer, so a slow reader never holds up
+ * the other terminals. Every newline terminated line a client sends is run
+ * as one command against group, and its output is sent back on the same
+ * connection. A client's quit closes only that connection.
+ *
+ * Returns once the process gets SIGINT or SIGTERM, closing every connection
+ * and removing the socket file.
+ *
+ * @param group the group shared by every connection
+ * @param path file system path of the socket to listen on
+ * @return EXIT_SUCCESS on a clean shutdown, EXIT_FAILURE if the socket can't be set up
+ */
+int serveGroup( Group *group, char const *path )
+{
+  int listenFd = openListener( path );
+  if ( listenFd < 0 ) {
+    return EXIT_FAILURE;
+  }
+
+  int epfd = epoll_create1( 0 );
+  if ( epfd < 0 ) {
+    perror( "epoll_create1" );
+    close( listenFd );
+    unlink( path );
+    return EXIT_FAILURE;
+  }
+
+  // listener is marked with a NULL pointer, clients with their Connection
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  epoll_ctl( epfd, EPOLL_CTL_ADD, listenFd, &ev );
+
+  struct sigaction sa;
+  memset( &sa, 0, sizeof( sa ) );
+  sa.sa_handler = handleStop;
+  sigaction( SIGINT, &sa, NULL );
+  sigaction( SIGTERM, &sa, NULL );
+  signal( SIGPIPE, SIG_IGN );
+
+  // held so a client can still be turned away when descriptors run out
+  int spareFd = open( "/dev/null", O_RDONLY );
+
+  struct epoll_event events[ MAX_EVENTS ];
+  while ( !stopServer ) {
+    int ready = epoll_wait( epfd, events, MAX_EVENTS, -1 );
+    if ( ready < 0 ) {
+      if ( errno == EINTR ) {
+        continue;
+      }
+      perror( "epoll_wait" );
+      break;
+    }
+
+    for ( int i = 0; i < ready; i++ ) {
+      Connection *conn = ( Connection *)events[ i ].data.ptr;
+
+      if ( conn == NULL ) {
+        acceptClients( epfd, listenFd, &spareFd );
+        continue;
+      }
+
+      bool keep = true;
+      if ( events[ i ].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) {
+        keep = readInput( group, conn );
+      }
+      if ( keep ) {
+        keep = flushOutput( epfd, conn );
+      }
+      if ( !keep ) {
+        freeConnection( epfd, conn );
+      }
+    }
+  }
+
+  // clients still connected are dropped, along with any output they haven't read
+  while ( connections != NULL ) {
+    freeConnection( epfd, connections );
+  }
+  if ( spareFd >= 0 ) {
+    close( spareFd );
+  }
+  close( epfd );
+  close( listenFd );
+  unlink( path );
+  return EXIT_SUCCESS;
+}
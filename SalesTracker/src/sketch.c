@@ -0,0 +1,254 @@
+/**
+ * @file sketch.c
+ * @author Luke Early
+ * Source file for the fixed-size sketch of the top sellers.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "sketch.h"
+
+/**
+ * Makes an empty sketch with the given number of counters.
+ *
+ * @param capacity how many counters it keeps
+ * @return pointer to the new Sketch
+ */
+Sketch *makeSketch( int capacity )
+{
+  Sketch *sketch = ( Sketch *)malloc( sizeof( Sketch ) );
+  sketch->capacity = capacity;
+  sketch->used = 0;
+  sketch->total = 0;
+  sketch->heap = ( SketchCounter *)malloc( capacity * sizeof( SketchCounter ) );
+
+  // at most half full, so probes stay short
+  sketch->slotCount = 1;
+  while ( sketch->slotCount < 2 * capacity ) {
+    sketch->slotCount *= 2;
+  }
+  sketch->slots = ( int *)malloc( sketch->slotCount * sizeof( int ) );
+  memset( sketch->slots, -1, sketch->slotCount * sizeof( int ) );
+  return sketch;
+}
+
+/**
+ * Frees a sketch.
+ *
+ * @param sketch to free, or NULL
+ */
+void freeSketch( Sketch *sketch )
+{
+  if ( sketch == NULL ) {
+    return;
+  }
+  free( sketch->heap );
+  free( sketch->slots );
+  free( sketch );
+}
+
+/**
+ * Picks where in the hash table a key's search starts.
+ *
+ * @param sketch the sketch
+ * @param key the key
+ * @return the slot
+ */
+static int homeSlot( Sketch const *sketch, int key )
+{
+  return ( int ) ( ( ( unsigned int ) key * 2654435761u ) & ( sketch->slotCount - 1 ) );
+}
+
+/**
+ * Finds the counter following a key.
+ *
+ * @param sketch the sketch
+ * @param key the key
+ * @return its heap position, or -1 if no counter follows it
+ */
+static int findCounter( Sketch const *sketch, int key )
+{
+  for ( int slot = homeSlot( sketch, key ); sketch->slots[ slot ] >= 0;
+        slot = ( slot + 1 ) & ( sketch->slotCount - 1 ) ) {
+    if ( sketch->heap[ sketch->slots[ slot ] ].key == key ) {
+      return sketch->slots[ slot ];
+    }
+  }
+  return -1;
+}
+
+/**
+ * Puts the counter at a heap position in the hash table under its key.
+ *
+ * @param sketch the sketch
+ * @param pos the counter's heap position
+ */
+static void addSlot( Sketch *sketch, int pos )
+{
+  int slot = homeSlot( sketch, sketch->heap[ pos ].key );
+  while ( sketch->slots[ slot ] >= 0 ) {
+    slot = ( slot + 1 ) & ( sketch->slotCount - 1 );
+  }
+  sketch->slots[ slot ] = pos;
+  sketch->heap[ pos ].slot = slot;
+}
+
+/**
+ * Takes a slot out of the hash table, moving back any later entries that
+ * would no longer be found past the gap.
+ *
+ * @param sketch the sketch
+ * @param slot the slot to empty
+ */
+static void removeSlot( Sketch *sketch, int slot )
+{
+  int mask = sketch->slotCount - 1;
+  int next = ( slot + 1 ) & mask;
+  while ( sketch->slots[ next ] >= 0 ) {
+    int home = homeSlot( sketch, sketch->heap[ sketch->slots[ next ] ].key );
+
+    // it can fill the gap if its search passes the gap before reaching it
+    if ( ( ( next - home ) & mask ) >= ( ( next - slot ) & mask ) ) {
+      sketch->slots[ slot ] = sketch->slots[ next ];
+      sketch->heap[ sketch->slots[ slot ] ].slot = slot;
+      slot = next;
+    }
+    next = ( next + 1 ) & mask;
+  }
+  sketch->slots[ slot ] = -1;
+}
+
+/**
+ * Moves a counter down the heap until no counter below it is smaller.
+ *
+ * @param sketch the sketch
+ * @param pos the counter's heap position
+ */
+static void siftDown( Sketch *sketch, int pos )
+{
+  SketchCounter *heap = sketch->heap;
+  SketchCounter moving = heap[ pos ];
+  for ( ;; ) {
+    int child = 2 * pos + 1;
+    if ( child >= sketch->used ) {
+      break;
+    }
+    if ( child + 1 < sketch->used && heap[ child + 1 ].count < heap[ child ].count ) {
+      child++;
+    }
+    if ( heap[ child ].count >= moving.count ) {
+      break;
+    }
+    heap[ pos ] = heap[ child ];
+    sketch->slots[ heap[ pos ].slot ] = pos;
+    pos = child;
+  }
+  heap[ pos ] = moving;
+  sketch->slots[ moving.slot ] = pos;
+}
+
+/**
+ * Moves a counter up the heap until the counter above it isn't larger.
+ *
+ * @param sketch the sketch
+ * @param pos the counter's heap position
+ */
+static void siftUp( Sketch *sketch, int pos )
+{
+  SketchCounter *heap = sketch->heap;
+  SketchCounter moving = heap[ pos ];
+  while ( pos > 0 && heap[ ( pos - 1 ) / 2 ].count > moving.count ) {
+    heap[ pos ] = heap[ ( pos - 1 ) / 2 ];
+    sketch->slots[ heap[ pos ].slot ] = pos;
+    pos = ( pos - 1 ) / 2;
+  }
+  heap[ pos ] = moving;
+  sketch->slots[ moving.slot ] = pos;
+}
+
+/**
+ * Adds a sale to the counter of the member who made it, taking over the
+ * smallest counter if the member doesn't have one and they're all in use.
+ * Takes time logarithmic in the sketch's capacity.
+ *
+ * @param sketch the sketch
+ * @param key ID handle of the member
+ * @param amount what the sale was worth
+ */
+void addSketch( Sketch *sketch, int key, int amount )
+{
+  sketch->total += amount;
+  int pos = findCounter( sketch, key );
+  if ( pos >= 0 ) {
+    sketch->heap[ pos ].count += amount;
+    siftDown( sketch, pos );
+  } else if ( sketch->used < sketch->capacity ) {
+    pos = sketch->used++;
+    sketch->heap[ pos ] = ( SketchCounter ) { key, amount, 0, 0 };
+    addSlot( sketch, pos );
+    siftUp( sketch, pos );
+  } else {
+    // the new member may have sold as much as the one it replaces
+    SketchCounter *smallest = &sketch->heap[ 0 ];
+    removeSlot( sketch, smallest->slot );
+    smallest->key = key;
+    smallest->error = smallest->count;
+    smallest->count += amount;
+    addSlot( sketch, 0 );
+    siftDown( sketch, 0 );
+  }
+}
+
+/**
+ * Compares two counters, largest count first, then smallest key.
+ *
+ * @param va void pointer to a counter
+ * @param vb void pointer to a counter
+ * @return less than 0 if va comes first, more than 0 if vb does
+ */
+static int compareCounters( void const *va, void const *vb )
+{
+  SketchCounter const *a = ( SketchCounter const *) va;
+  SketchCounter const *b = ( SketchCounter const *) vb;
+  if ( a->count != b->count ) {
+    return a->count > b->count ? -1 : 1;
+  }
+  return a->key < b->key ? -1 : a->key > b->key;
+}
+
+/**
+ * Copies the counters in use, in no particular order, so they can be
+ * sorted after the lock guarding the sketch is released.
+ *
+ * @param sketch the sketch
+ * @param rows set to a new array of the counters
+ * @return how many counters were copied
+ */
+int copySketch( Sketch const *sketch, SketchCounter **rows )
+{
+  *rows = ( SketchCounter *)malloc( ( sketch->used + 1 ) * sizeof( SketchCounter ) );
+  memcpy( *rows, sketch->heap, sketch->used * sizeof( SketchCounter ) );
+  return sketch->used;
+}
+
+/**
+ * Sorts copied counters, largest count first, then smallest key.
+ *
+ * @param rows the counters
+ * @param count how many there are
+ */
+void sortCounters( SketchCounter *rows, int count )
+{
+  qsort( rows, count, sizeof( SketchCounter ), compareCounters );
+}
+
+/**
+ * Tells how many bytes a sketch holds, however many members it has seen.
+ *
+ * @param sketch the sketch
+ * @return its size in bytes
+ */
+long sketchBytes( Sketch const *sketch )
+{
+  return sizeof( Sketch ) + sketch->capacity * sizeof( SketchCounter ) + sketch->slotCount * sizeof( int );
+}
@@ -0,0 +1,1042 @@
+/**
+ * @file snapshot.c
+ * @author Luke Early
+ * Source file for multi-version snapshots of a group.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "snapshot.h"
+#include "lazy.h"
+#include "trace.h"
+
+/** Pinned epoch used when no reader is pinned at all */
+#define NO_READERS 0x7fffffffffffffffL
+
+/** Shared slot this thread uses, or -1 until it first enters a group */
+static __thread int sharedSlot = -1;
+
+/** Slot handed to the next thread that enters a group */
+static int nextSharedSlot = 0;
+
+/** Shard of recent sales this thread adds to, or -1 until its first sale */
+static __thread int threadShard = -1;
+
+/** Shard handed to the next thread that records a sale */
+static int nextShard = 0;
+
+/**
+ * Makes the version bookkeeping for a live group. Nothing is published
+ * until the first reader asks for a snapshot.
+ *
+ * @return pointer to the new Versions
+ */
+Versions *makeVersions()
+{
+  Versions *v = ( Versions *)calloc( 1, sizeof( Versions ) );
+  pthread_mutex_init( &v->lock, NULL );
+  for ( int i = 0; i < RECORD_LOCKS; i++ ) {
+    pthread_mutex_init( &v->memberLocks[ i ], NULL );
+    pthread_mutex_init( &v->sellerLocks[ i ], NULL );
+  }
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    pthread_mutex_init( &v->shardLocks[ i ], NULL );
+  }
+  pthread_mutex_init( &v->sketchLock, NULL );
+  v->stale = true;
+
+  v->dirtyItemCap = INIT_CAPACITY;
+  v->dirtyItems = ( int *)malloc( v->dirtyItemCap * sizeof( int ) );
+  v->dirtyMemberCap = INIT_CAPACITY;
+  v->dirtyMembers = ( int *)malloc( v->dirtyMemberCap * sizeof( int ) );
+
+  v->itemChanges.head = v->itemChanges.tail = -1;
+  v->memberChanges.head = v->memberChanges.tail = -1;
+
+  return v;
+}
+
+/**
+ * Returns how many pages it takes to hold count records.
+ *
+ * @param count number of records
+ * @return number of pages
+ */
+static int pageCount( int count )
+{
+  return ( count + PAGE_SIZE - 1 ) >> PAGE_SHIFT;
+}
+
+/**
+ * Frees a frozen item copy, or a replaced live item.
+ *
+ * @param item to free
+ */
+static void freeFrozenItem( Item *item )
+{
+  free( item );
+}
+
+/**
+ * Frees a frozen member copy along with its sale list.
+ *
+ * @param member to free
+ */
+static void freeFrozenMember( Member *member )
+{
+  if ( member->list != NULL ) {
+    free( member->list[ 0 ] );
+  }
+  free( member->list );
+  free( member );
+}
+
+/**
+ * Frees one piece of retired memory according to its kind.
+ *
+ * @param r the retired entry
+ */
+static void freeRetired( Retired *r )
+{
+  if ( r->kind == RETIRED_ITEM ) {
+    freeFrozenItem( ( Item *)r->ptr );
+  } else if ( r->kind == RETIRED_MEMBER ) {
+    freeFrozenMember( ( Member *)r->ptr );
+  } else if ( r->kind == RETIRED_SNAPSHOT ) {
+    Snapshot *snap = ( Snapshot *)r->ptr;
+    free( snap->iPages );
+    free( snap->mPages );
+    free( snap );
+  } else {
+    free( r->ptr );
+  }
+}
+
+/**
+ * Frees the current snapshot, everything on the retired list, and the
+ * Versions itself. No reader may still be pinned.
+ *
+ * @param versions to free
+ */
+void freeVersions( Versions *versions )
+{
+  Snapshot *snap = versions->current;
+  if ( snap != NULL ) {
+    for ( int p = 0; p < pageCount( snap->iCount ); p++ ) {
+      for ( int i = 0; i < PAGE_SIZE; i++ ) {
+        if ( snap->iPages[ p ][ i ] != NULL ) {
+          freeFrozenItem( snap->iPages[ p ][ i ] );
+        }
+      }
+      free( snap->iPages[ p ] );
+    }
+    for ( int p = 0; p < pageCount( snap->mCount ); p++ ) {
+      // a page of lazily loaded members none of which has been made is never filled in
+      if ( snap->mPages[ p ] == NULL ) {
+        continue;
+      }
+      for ( int i = 0; i < PAGE_SIZE; i++ ) {
+        if ( snap->mPages[ p ][ i ] != NULL ) {
+          freeFrozenMember( snap->mPages[ p ][ i ] );
+        }
+      }
+      free( snap->mPages[ p ] );
+    }
+    free( snap->iPages );
+    free( snap->mPages );
+    free( snap );
+  }
+
+  while ( versions->retired != NULL ) {
+    Retired *next = versions->retired->next;
+    freeRetired( versions->retired );
+    free( versions->retired );
+    versions->retired = next;
+  }
+
+  pthread_mutex_destroy( &versions->lock );
+  for ( int i = 0; i < RECORD_LOCKS; i++ ) {
+    pthread_mutex_destroy( &versions->memberLocks[ i ] );
+    pthread_mutex_destroy( &versions->sellerLocks[ i ] );
+  }
+  for ( int i = 0; i < SALE_SHARDS; i++ ) {
+    pthread_mutex_destroy( &versions->shardLocks[ i ] );
+  }
+  pthread_mutex_destroy( &versions->sketchLock );
+  free( versions->dirtyItems );
+  free( versions->dirtyMembers );
+  ChangeList *lists[] = { &versions->itemChanges, &versions->memberChanges };
+  for ( int i = 0; i < 2; i++ ) {
+    free( lists[ i ]->stamp );
+    free( lists[ i ]->latest );
+    free( lists[ i ]->prev );
+    free( lists[ i ]->next );
+  }
+  free( versions );
+}
+
+/**
+ * Grows a dirty list so it can hold at least cap entries.
+ *
+ * @param list the dirty list
+ * @param oldCap capacity of the list, updated
+ * @param cap capacity needed
+ */
+static void reserveDirty( int **list, int *oldCap, int cap )
+{
+  if ( cap > *oldCap ) {
+    *list = ( int *)realloc( *list, cap * sizeof( int ) );
+    *oldCap = cap;
+  }
+}
+
+/**
+ * Grows a change list so it can hold at least cap records.
+ *
+ * @param list the change list
+ * @param cap capacity needed
+ */
+static void reserveChanges( ChangeList *list, int cap )
+{
+  if ( cap > list->cap ) {
+    list->stamp = ( long *)realloc( list->stamp, cap * sizeof( long ) );
+    list->latest = ( long *)realloc( list->latest, cap * sizeof( long ) );
+    list->prev = ( int *)realloc( list->prev, cap * sizeof( int ) );
+    list->next = ( int *)realloc( list->next, cap * sizeof( int ) );
+    for ( int i = list->cap; i < cap; i++ ) {
+      list->stamp[ i ] = 0;
+      list->latest[ i ] = 0;
+    }
+    list->cap = cap;
+  }
+}
+
+/**
+ * Makes room in the change bookkeeping for every record the group has
+ * space for. Must be called, with the write lock held or before the group
+ * is shared, whenever iList or mList grows.
+ *
+ * @param group the live group
+ */
+void reserveVersions( Group *group )
+{
+  Versions *v = group->versions;
+  reserveDirty( &v->dirtyItems, &v->dirtyItemCap, group->iCap );
+  reserveDirty( &v->dirtyMembers, &v->dirtyMemberCap, group->mCap );
+  reserveChanges( &v->itemChanges, group->iCap );
+  reserveChanges( &v->memberChanges, group->mCap );
+}
+
+/**
+ * Takes the group's write lock, waiting for every thread on the shared
+ * side to leave. Changes other than sales must be made while holding it.
+ *
+ * @param group the live group
+ */
+void lockGroup( Group *group )
+{
+  Versions *v = group->versions;
+  pthread_mutex_lock( &v->lock );
+
+  // threads entering after this see the flag and back off
+  __atomic_store_n( &v->exclusive, 1, __ATOMIC_SEQ_CST );
+  for ( int i = 0; i < SHARED_SLOTS; i++ ) {
+    while ( __atomic_load_n( &v->shared[ i ].active, __ATOMIC_SEQ_CST ) != 0 ) {
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * Releases the group's write lock.
+ *
+ * @param group the live group
+ */
+void unlockGroup( Group *group )
+{
+  Versions *v = group->versions;
+  __atomic_store_n( &v->exclusive, 0, __ATOMIC_SEQ_CST );
+  pthread_mutex_unlock( &v->lock );
+}
+
+/**
+ * Enters the group's shared side, where sales are recorded. Any number of
+ * threads can be inside at once; it only waits while a writer holds the
+ * write lock.
+ *
+ * @param group the live group
+ */
+void enterGroup( Group *group )
+{
+  Versions *v = group->versions;
+  if ( sharedSlot < 0 ) {
+    sharedSlot = __atomic_fetch_add( &nextSharedSlot, 1, __ATOMIC_RELAXED ) % SHARED_SLOTS;
+  }
+
+  int *active = &v->shared[ sharedSlot ].active;
+  while ( true ) {
+    __atomic_fetch_add( active, 1, __ATOMIC_SEQ_CST );
+    if ( !__atomic_load_n( &v->exclusive, __ATOMIC_SEQ_CST ) ) {
+      return;
+    }
+
+    // let the writer finish before trying again
+    __atomic_fetch_sub( active, 1, __ATOMIC_SEQ_CST );
+    while ( __atomic_load_n( &v->exclusive, __ATOMIC_SEQ_CST ) ) {
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * Leaves the group's shared side.
+ *
+ * @param group the live group
+ */
+void leaveGroup( Group *group )
+{
+  __atomic_fetch_sub( &group->versions->shared[ sharedSlot ].active, 1, __ATOMIC_SEQ_CST );
+}
+
+/**
+ * Takes the lock guarding the sale list of the member at the given index,
+ * one of RECORD_LOCKS shared out between all the members. Only used on the
+ * shared side.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void lockMember( Group *group, int idx )
+{
+  pthread_mutex_lock( &group->versions->memberLocks[ idx % RECORD_LOCKS ] );
+}
+
+/**
+ * Releases the lock taken by lockMember().
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void unlockMember( Group *group, int idx )
+{
+  pthread_mutex_unlock( &group->versions->memberLocks[ idx % RECORD_LOCKS ] );
+}
+
+/**
+ * Takes the lock guarding one shard of the seller ranking of the item at
+ * the given index, one of RECORD_LOCKS shared out between the shards of
+ * all the items. Members selling the same item at once only wait for each
+ * other when their shards share a lock. Taken after any member lock,
+ * never before.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param shard the shard, from 0 up to SELLER_SHARDS
+ */
+void lockSellers( Group *group, int idx, int shard )
+{
+  pthread_mutex_lock( &group->versions->sellerLocks[ ( idx * SELLER_SHARDS + shard ) % RECORD_LOCKS ] );
+}
+
+/**
+ * Releases the lock taken by lockSellers().
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ * @param shard the shard
+ */
+void unlockSellers( Group *group, int idx, int shard )
+{
+  pthread_mutex_unlock( &group->versions->sellerLocks[ ( idx * SELLER_SHARDS + shard ) % RECORD_LOCKS ] );
+}
+
+/**
+ * Tells which of the group's SALE_SHARDS shards of recent sales the
+ * calling thread adds its sales to. Threads are handed shards in turn the
+ * first time they ask, so threads selling at once rarely share one.
+ *
+ * @return the thread's shard
+ */
+int saleShard()
+{
+  if ( threadShard < 0 ) {
+    threadShard = __atomic_fetch_add( &nextShard, 1, __ATOMIC_RELAXED ) % SALE_SHARDS;
+  }
+  return threadShard;
+}
+
+/**
+ * Takes the lock guarding one of the group's rollups. Taken after any
+ * member or seller lock, never before.
+ *
+ * @param group the live group
+ * @param shard the shard, from 0 up to SALE_SHARDS
+ */
+void lockShard( Group *group, int shard )
+{
+  pthread_mutex_lock( &group->versions->shardLocks[ shard ] );
+}
+
+/**
+ * Releases the lock taken by lockShard().
+ *
+ * @param group the live group
+ * @param shard the shard
+ */
+void unlockShard( Group *group, int shard )
+{
+  pthread_mutex_unlock( &group->versions->shardLocks[ shard ] );
+}
+
+/**
+ * Takes the lock guarding the group's top sellers sketch. Taken after any
+ * member, seller or shard lock, never before.
+ *
+ * @param group the live group
+ */
+void lockSketch( Group *group )
+{
+  pthread_mutex_lock( &group->versions->sketchLock );
+}
+
+/**
+ * Releases the lock taken by lockSketch().
+ *
+ * @param group the live group
+ */
+void unlockSketch( Group *group )
+{
+  pthread_mutex_unlock( &group->versions->sketchLock );
+}
+
+/**
+ * Appends an index to one of the dirty lists, growing it if needed.
+ *
+ * @param list the dirty list
+ * @param count number of entries in the list
+ * @param cap capacity of the list
+ * @param idx the index to add
+ */
+static void addDirty( int **list, int *count, int *cap, int idx )
+{
+  if ( *count + 1 > *cap ) {
+    *cap = *cap * 2;
+    *list = ( int *)realloc( *list, *cap * sizeof( int ) );
+  }
+  ( *list )[ ( *count )++ ] = idx;
+}
+
+/**
+ * Moves a record to the most recent end of a change list, stamped with the
+ * given version.
+ *
+ * @param list the change list
+ * @param idx index of the record
+ * @param version version of the change
+ */
+static void touchChange( ChangeList *list, int idx, long version )
+{
+  if ( list->tail == idx ) {
+    list->stamp[ idx ] = version;
+    return;
+  }
+
+  // unlink it if it's already in the list
+  if ( list->stamp[ idx ] != 0 ) {
+    if ( list->prev[ idx ] >= 0 ) {
+      list->next[ list->prev[ idx ] ] = list->next[ idx ];
+    } else {
+      list->head = list->next[ idx ];
+    }
+    list->prev[ list->next[ idx ] ] = list->prev[ idx ];
+  }
+
+  list->prev[ idx ] = list->tail;
+  list->next[ idx ] = -1;
+  if ( list->tail >= 0 ) {
+    list->next[ list->tail ] = idx;
+  } else {
+    list->head = idx;
+  }
+  list->tail = idx;
+  list->stamp[ idx ] = version;
+}
+
+/**
+ * Notes the newest version a record changed in, to be linked into its
+ * change list at the next publish. Sales can race here, so the larger
+ * version always wins.
+ *
+ * @param list the change list
+ * @param idx index of the record
+ * @param version version of the change
+ */
+static void noteChange( ChangeList *list, int idx, long version )
+{
+  long seen = __atomic_load_n( &list->latest[ idx ], __ATOMIC_RELAXED );
+  while ( seen < version &&
+          !__atomic_compare_exchange_n( &list->latest[ idx ], &seen, version, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+  }
+}
+
+/**
+ * Adds an index to a dirty list that already has room for it. Sales on
+ * the shared side can add at the same time.
+ *
+ * @param list the dirty list
+ * @param count number of entries in the list
+ * @param idx the index to add
+ */
+static void addDirtyShared( int *list, int *count, int idx )
+{
+  list[ __atomic_fetch_add( count, 1, __ATOMIC_RELAXED ) ] = idx;
+}
+
+/**
+ * Claims a record for the next snapshot, so only the first change to it
+ * since the last publish puts it on the dirty list.
+ *
+ * @param version the record's version field
+ * @param epoch epoch of the current snapshot
+ * @return true if this change is the first
+ */
+static bool claimDirty( long *version, long epoch )
+{
+  long seen = __atomic_load_n( version, __ATOMIC_RELAXED );
+  return seen <= epoch &&
+         __atomic_compare_exchange_n( version, &seen, epoch + 1, false,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED );
+}
+
+/**
+ * Starts a new group version for a change about to be made. Records marked
+ * changed after this are stamped with the new version. Must be called on
+ * the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @return the new version
+ */
+long newVersion( Group *group )
+{
+  return __atomic_add_fetch( &group->versions->version, 1, __ATOMIC_RELAXED );
+}
+
+/**
+ * Notes that the item at the given index changed, so the next snapshot
+ * gets a fresh copy of it and it shows up as changed in the current group
+ * version. Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the item in iList
+ */
+void markItemChanged( Group *group, int idx )
+{
+  Versions *v = group->versions;
+
+  // only list each record once per snapshot
+  if ( claimDirty( &group->iList[ idx ]->version, v->epoch ) ) {
+    addDirtyShared( v->dirtyItems, &v->dirtyItemCount, idx );
+  }
+  noteChange( &v->itemChanges, idx, __atomic_load_n( &v->version, __ATOMIC_RELAXED ) );
+  if ( !__atomic_load_n( &v->stale, __ATOMIC_RELAXED ) ) {
+    __atomic_store_n( &v->stale, true, __ATOMIC_RELEASE );
+  }
+}
+
+/**
+ * Notes that the member at the given index changed, so the next snapshot
+ * gets a fresh copy of it and it shows up as changed in the current group
+ * version. Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void markMemberChanged( Group *group, int idx )
+{
+  Versions *v = group->versions;
+
+  if ( claimDirty( &group->mList[ idx ]->version, v->epoch ) ) {
+    addDirtyShared( v->dirtyMembers, &v->dirtyMemberCount, idx );
+  }
+  noteChange( &v->memberChanges, idx, __atomic_load_n( &v->version, __ATOMIC_RELAXED ) );
+  if ( !__atomic_load_n( &v->stale, __ATOMIC_RELAXED ) ) {
+    __atomic_store_n( &v->stale, true, __ATOMIC_RELEASE );
+  }
+}
+
+/**
+ * Notes that the member at the given index was just made from its line of
+ * a lazily loaded member file, so the next snapshot gets a copy of it. It
+ * hasn't changed, so unlike markMemberChanged() this gives it no version.
+ * Must be called on the shared side or with the write lock held.
+ *
+ * @param group the live group
+ * @param idx index of the member in mList
+ */
+void markMemberLoaded( Group *group, int idx )
+{
+  Versions *v = group->versions;
+
+  if ( claimDirty( &group->mList[ idx ]->version, v->epoch ) ) {
+    addDirtyShared( v->dirtyMembers, &v->dirtyMemberCount, idx );
+  }
+  if ( !__atomic_load_n( &v->stale, __ATOMIC_RELAXED ) ) {
+    __atomic_store_n( &v->stale, true, __ATOMIC_RELEASE );
+  }
+}
+
+/**
+ * Puts memory on the retired list, to be freed once no reader can see it.
+ *
+ * @param v the group's versions
+ * @param ptr memory to retire
+ * @param kind what sort of memory it is
+ * @param epoch first epoch that no longer contains it
+ */
+static void retire( Versions *v, void *ptr, int kind, long epoch )
+{
+  Retired *r = ( Retired *)malloc( sizeof( Retired ) );
+  r->ptr = ptr;
+  r->kind = kind;
+  r->epoch = epoch;
+  r->next = v->retired;
+  __atomic_store_n( &v->retired, r, __ATOMIC_RELAXED );
+}
+
+/**
+ * Retires a live item that has been replaced in iList. Members in earlier
+ * snapshots still point at it, so it is only freed once no reader can see
+ * those snapshots. Must be called with the write lock held.
+ *
+ * @param group the live group
+ * @param item the replaced item, with its sellers already moved off it
+ */
+void retireItem( Group *group, Item *item )
+{
+  retire( group->versions, item, RETIRED_ITEM, group->versions->epoch + 1 );
+}
+
+/**
+ * Frees every retired entry that no pinned reader can still see.
+ * Must be called with the write lock held.
+ *
+ * @param v the group's versions
+ */
+static void reclaim( Versions *v )
+{
+  long oldest = NO_READERS;
+  for ( int i = 0; i < MAX_READERS; i++ ) {
+    long pinned = __atomic_load_n( &v->readers[ i ], __ATOMIC_SEQ_CST );
+    if ( pinned != 0 && pinned < oldest ) {
+      oldest = pinned;
+    }
+  }
+
+  Retired *keep = NULL;
+  Retired *r = v->retired;
+  while ( r != NULL ) {
+    Retired *next = r->next;
+    if ( r->epoch <= oldest ) {
+      freeRetired( r );
+      free( r );
+    } else {
+      r->next = keep;
+      keep = r;
+    }
+    r = next;
+  }
+  __atomic_store_n( &v->retired, keep, __ATOMIC_RELAXED );
+}
+
+/**
+ * Makes an immutable copy of a live item for a snapshot. Readers never
+ * need the seller ranking, so it isn't copied.
+ *
+ * @param item the live item
+ * @return the frozen copy
+ */
+static Item *freezeItem( Item const *item )
+{
+  Item *copy = ( Item *)malloc( sizeof( Item ) );
+  *copy = *item;
+  copy->sellers = NULL;
+  return copy;
+}
+
+/**
+ * Makes an immutable copy of a live member for a snapshot, including its
+ * sale list. The copied SaleItems still point at the live Items, which are
+ * replaced rather than changed when a reload gives them a new name or cost.
+ *
+ * @param member the live member
+ * @return the frozen copy
+ */
+static Member *freezeMember( Member const *member )
+{
+  Member *copy = ( Member *)malloc( sizeof( Member ) );
+  *copy = *member;
+  copy->capacity = member->count;
+  copy->list = NULL;
+
+  if ( member->count > 0 ) {
+    SaleItem *block = ( SaleItem *)malloc( member->count * sizeof( SaleItem ) );
+    copy->list = ( SaleItem **)malloc( member->count * sizeof( SaleItem * ) );
+    for ( int i = 0; i < member->count; i++ ) {
+      block[ i ] = *member->list[ i ];
+      block[ i ].rank = NULL;
+      copy->list[ i ] = block + i;
+    }
+  }
+
+  return copy;
+}
+
+/**
+ * Makes the page holding a record writable in the snapshot being built,
+ * copying it if it's still shared with the previous snapshot.
+ *
+ * @param v the group's versions
+ * @param pages page directory of the new snapshot
+ * @param oldPages page directory of the previous snapshot, or NULL
+ * @param oldPageCount number of pages in oldPages
+ * @param page which page to make writable
+ * @param epoch epoch of the new snapshot
+ * @return the writable page
+ */
+static void **ownPage( Versions *v, void ***pages, void ***oldPages, int oldPageCount,
+                       int page, long epoch )
+{
+  if ( pages[ page ] == NULL ) {
+    pages[ page ] = ( void **)calloc( PAGE_SIZE, sizeof( void * ) );
+  } else if ( oldPages != NULL && page < oldPageCount && pages[ page ] == oldPages[ page ] ) {
+    void **copy = ( void **)malloc( PAGE_SIZE * sizeof( void * ) );
+    memcpy( copy, oldPages[ page ], PAGE_SIZE * sizeof( void * ) );
+    retire( v, oldPages[ page ], RETIRED_PAGE, epoch );
+    pages[ page ] = copy;
+  }
+  return pages[ page ];
+}
+
+/**
+ * A record with changes not linked into its change list yet.
+ */
+struct PendingStruct {
+  long version;
+  int idx;
+};
+typedef struct PendingStruct Pending;
+
+/**
+ * Compares two pending changes by version, for qsort().
+ *
+ * @param va void pointer to a Pending
+ * @param vb void pointer to a Pending
+ * @return negative, zero or positive as va's version is less, equal or greater
+ */
+static int comparePending( void const *va, void const *vb )
+{
+  Pending const *a = ( Pending const *) va;
+  Pending const *b = ( Pending const *) vb;
+
+  return ( a->version > b->version ) - ( a->version < b->version );
+}
+
+/**
+ * Moves the dirty records that changed since they were last linked to the
+ * most recent end of their change list, oldest change first, so the list
+ * stays in version order. Must be called with the write lock held.
+ *
+ * @param list the change list
+ * @param dirty the dirty list
+ * @param count number of entries in the dirty list
+ */
+static void linkChanges( ChangeList *list, int const *dirty, int count )
+{
+  Pending *pending = ( Pending *)malloc( ( count + 1 ) * sizeof( Pending ) );
+  int pendingCount = 0;
+  for ( int d = 0; d < count; d++ ) {
+    int idx = dirty[ d ];
+    if ( list->latest[ idx ] > list->stamp[ idx ] ) {
+      pending[ pendingCount ].version = list->latest[ idx ];
+      pending[ pendingCount ].idx = idx;
+      pendingCount++;
+    }
+  }
+
+  qsort( pending, pendingCount, sizeof( Pending ), comparePending );
+  for ( int i = 0; i < pendingCount; i++ ) {
+    touchChange( list, pending[ i ].idx, pending[ i ].version );
+  }
+  free( pending );
+}
+
+/**
+ * Publishes a new snapshot holding fresh copies of every changed record,
+ * sharing everything else with the previous one. Must be called with the
+ * write lock held.
+ *
+ * @param group the live group
+ */
+static void publish( Group *group )
+{
+  Versions *v = group->versions;
+  Snapshot *old = v->current;
+
+  Snapshot *snap = ( Snapshot *)malloc( sizeof( Snapshot ) );
+  snap->epoch = v->epoch + 1;
+  snap->iCount = group->iCount;
+  snap->mCount = group->mCount;
+  snap->totalSold = group->totalSold;
+  snap->totalSales = group->totalSales;
+
+  int iPageCount = pageCount( snap->iCount );
+  int mPageCount = pageCount( snap->mCount );
+  int oldIPageCount = old == NULL ? 0 : pageCount( old->iCount );
+  int oldMPageCount = old == NULL ? 0 : pageCount( old->mCount );
+  snap->iPages = ( Item ***)calloc( iPageCount + 1, sizeof( Item ** ) );
+  snap->mPages = ( Member ***)calloc( mPageCount + 1, sizeof( Member ** ) );
+
+  if ( old != NULL ) {
+    memcpy( snap->iPages, old->iPages, oldIPageCount * sizeof( Item ** ) );
+    memcpy( snap->mPages, old->mPages, oldMPageCount * sizeof( Member ** ) );
+  } else {
+    // the first snapshot copies everything
+    v->dirtyItemCount = 0;
+    v->dirtyMemberCount = 0;
+    for ( int i = 0; i < group->iCount; i++ ) {
+      addDirty( &v->dirtyItems, &v->dirtyItemCount, &v->dirtyItemCap, i );
+    }
+    // except lazily loaded members that haven't been made yet, which have sold nothing
+    for ( int i = 0; i < group->mCount; i++ ) {
+      if ( group->mList[ i ] != NULL ) {
+        addDirty( &v->dirtyMembers, &v->dirtyMemberCount, &v->dirtyMemberCap, i );
+      }
+    }
+  }
+
+  linkChanges( &v->itemChanges, v->dirtyItems, v->dirtyItemCount );
+  linkChanges( &v->memberChanges, v->dirtyMembers, v->dirtyMemberCount );
+
+  for ( int d = 0; d < v->dirtyItemCount; d++ ) {
+    int idx = v->dirtyItems[ d ];
+    void **page = ownPage( v, ( void ***)snap->iPages, old == NULL ? NULL : ( void ***)old->iPages,
+                           oldIPageCount, idx >> PAGE_SHIFT, snap->epoch );
+    if ( page[ idx & PAGE_MASK ] != NULL ) {
+      retire( v, page[ idx & PAGE_MASK ], RETIRED_ITEM, snap->epoch );
+    }
+    page[ idx & PAGE_MASK ] = freezeItem( group->iList[ idx ] );
+  }
+
+  for ( int d = 0; d < v->dirtyMemberCount; d++ ) {
+    int idx = v->dirtyMembers[ d ];
+    void **page = ownPage( v, ( void ***)snap->mPages, old == NULL ? NULL : ( void ***)old->mPages,
+                           oldMPageCount, idx >> PAGE_SHIFT, snap->epoch );
+    if ( page[ idx & PAGE_MASK ] != NULL ) {
+      retire( v, page[ idx & PAGE_MASK ], RETIRED_MEMBER, snap->epoch );
+    }
+    page[ idx & PAGE_MASK ] = freezeMember( group->mList[ idx ] );
+  }
+
+  v->dirtyItemCount = 0;
+  v->dirtyMemberCount = 0;
+
+  // make the snapshot visible before the epoch that readers pin
+  __atomic_store_n( &v->current, snap, __ATOMIC_SEQ_CST );
+  __atomic_store_n( &v->epoch, snap->epoch, __ATOMIC_SEQ_CST );
+  __atomic_store_n( &v->stale, false, __ATOMIC_RELEASE );
+
+  if ( old != NULL ) {
+    retire( v, old, RETIRED_SNAPSHOT, snap->epoch );
+  }
+  reclaim( v );
+}
+
+/**
+ * Pins the newest snapshot of the group, publishing one first if any
+ * records have changed. The snapshot stays valid until it is unpinned.
+ *
+ * @param group the live group
+ * @param slot set to the reader slot to pass to unpinSnapshot()
+ * @return the pinned snapshot
+ */
+Snapshot *pinSnapshot( Group *group, int *slot )
+{
+  Versions *v = group->versions;
+
+  if ( __atomic_load_n( &v->stale, __ATOMIC_ACQUIRE ) ) {
+    lockGroup( group );
+    if ( v->stale ) {
+      publish( group );
+    }
+    unlockGroup( group );
+  }
+
+  while ( true ) {
+    long epoch = __atomic_load_n( &v->epoch, __ATOMIC_SEQ_CST );
+    for ( int i = 0; i < MAX_READERS; i++ ) {
+      long expected = 0;
+      if ( __atomic_compare_exchange_n( &v->readers[ i ], &expected, epoch, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) ) {
+        // loaded after the pin is visible, so it can't be reclaimed under us
+        *slot = i;
+        return __atomic_load_n( &v->current, __ATOMIC_SEQ_CST );
+      }
+    }
+    sched_yield();
+  }
+}
+
+/**
+ * Releases a snapshot pinned with pinSnapshot(), freeing any retired
+ * records nobody can see anymore.
+ *
+ * @param group the live group
+ * @param slot the reader slot the snapshot was pinned with
+ */
+void unpinSnapshot( Group *group, int slot )
+{
+  Versions *v = group->versions;
+  __atomic_store_n( &v->readers[ slot ], 0, __ATOMIC_SEQ_CST );
+
+  if ( __atomic_load_n( &v->retired, __ATOMIC_RELAXED ) != NULL && pthread_mutex_trylock( &v->lock ) == 0 ) {
+    reclaim( v );
+    pthread_mutex_unlock( &v->lock );
+  }
+}
+
+/**
+ * Opens a read view of the group: a Group whose lists hold the records of a
+ * pinned snapshot. The view's lists belong to the caller, so they can be
+ * sorted freely without disturbing the live group or other readers. A view
+ * for an item report leaves its member list empty; for a view with
+ * members, any members of a lazily loaded group not made yet are made
+ * first.
+ *
+ * @param group the live group
+ * @param members true if the view needs the members, not just the items
+ * @return the read view, to be released with closeView()
+ */
+Group *openView( Group *group, bool members )
+{
+  if ( members ) {
+    loadAllMembers( group );
+  }
+  traceBegin( "view", NULL );
+  Group *view = ( Group *)calloc( 1, sizeof( Group ) );
+  view->ids = group->ids;
+  view->names = group->names;
+  Snapshot *snap = pinSnapshot( group, &view->pin );
+  view->snapshot = snap;
+  view->totalSold = snap->totalSold;
+  view->totalSales = snap->totalSales;
+
+  view->iCount = snap->iCount;
+  view->iCap = snap->iCount;
+  view->iList = ( Item **)malloc( ( snap->iCount + 1 ) * sizeof( Item * ) );
+  for ( int i = 0; i < snap->iCount; i++ ) {
+    view->iList[ i ] = snap->iPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ];
+  }
+
+  view->mCount = members ? snap->mCount : 0;
+  view->mCap = view->mCount;
+  view->mList = ( Member **)malloc( ( view->mCount + 1 ) * sizeof( Member * ) );
+  for ( int i = 0; i < view->mCount; i++ ) {
+    view->mList[ i ] = snap->mPages[ i >> PAGE_SHIFT ][ i & PAGE_MASK ];
+  }
+
+  traceEnd( "view" );
+  return view;
+}
+
+/**
+ * Collects the records of a change list changed after the given version,
+ * walking back from the most recent change.
+ *
+ * @param list the change list
+ * @param since only records changed after this version are collected
+ * @param count set to the number of records collected
+ * @return newly allocated array of record indices
+ */
+static int *changedSince( ChangeList const *list, long since, int *count )
+{
+  int cap = INIT_CAPACITY;
+  int *found = ( int *)malloc( cap * sizeof( int ) );
+  *count = 0;
+
+  for ( int idx = list->tail; idx >= 0 && list->stamp[ idx ] > since; idx = list->prev[ idx ] ) {
+    if ( *count + 1 > cap ) {
+      cap *= 2;
+      found = ( int *)realloc( found, cap * sizeof( int ) );
+    }
+    found[ ( *count )++ ] = idx;
+  }
+  return found;
+}
+
+/**
+ * Opens a read view holding only the records changed after the given group
+ * version. The work done is proportional to the number of changed records,
+ * not to the size of the group.
+ *
+ * @param group the live group
+ * @param since only records changed after this version are included
+ * @param version set to the group version the view is up to date with
+ * @return the read view, to be released with closeView()
+ */
+Group *openChangedView( Group *group, long since, long *version )
+{
+  traceBegin( "view", NULL );
+  Group *view = ( Group *)calloc( 1, sizeof( Group ) );
+  view->ids = group->ids;
+  view->names = group->names;
+
+  // changes are linked into the change lists when they're published, and
+  // the snapshot is pinned after the indices are collected, so it's at
+  // least as new as the version reported
+  lockGroup( group );
+  if ( group->versions->stale ) {
+    publish( group );
+  }
+  *version = group->versions->version;
+  int *items = changedSince( &group->versions->itemChanges, since, &view->iCount );
+  int *members = changedSince( &group->versions->memberChanges, since, &view->mCount );
+  unlockGroup( group );
+
+  Snapshot *snap = pinSnapshot( group, &view->pin );
+  view->snapshot = snap;
+  view->totalSold = snap->totalSold;
+  view->totalSales = snap->totalSales;
+
+  view->iCap = view->iCount;
+  view->iList = ( Item **)malloc( ( view->iCount + 1 ) * sizeof( Item * ) );
+  for ( int i = 0; i < view->iCount; i++ ) {
+    view->iList[ i ] = snap->iPages[ items[ i ] >> PAGE_SHIFT ][ items[ i ] & PAGE_MASK ];
+  }
+
+  view->mCap = view->mCount;
+  view->mList = ( Member **)malloc( ( view->mCount + 1 ) * sizeof( Member * ) );
+  for ( int i = 0; i < view->mCount; i++ ) {
+    view->mList[ i ] = snap->mPages[ members[ i ] >> PAGE_SHIFT ][ members[ i ] & PAGE_MASK ];
+  }
+
+  free( items );
+  free( members );
+  traceEnd( "view" );
+  return view;
+}
+
+/**
+ * Releases a read view opened with openView() or openChangedView().
+ *
+ * @param group the live group the view was opened on
+ * @param view the view to release
+ */
+void closeView( Group *group, Group *view )
+{
+  unpinSnapshot( group, view->pin );
+  free( view->iList );
+  free( view->mList );
+  free( view );
+}
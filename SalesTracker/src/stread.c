@@ -0,0 +1,224 @@
+/**
+ * @file stread.c
+ * @author Luke Early
+ * Main file for the stread program, which prints reports from a segment
+ * a fundraiser publishes to shared memory, without talking to it.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "publish.h"
+
+/** Items or members being sorted, for the compare functions */
+static PubItem const *sortingItems;
+static PubMember const *sortingMembers;
+
+/**
+ * Prints message to stderr informing user legal CLA
+ */
+static void usage()
+{
+  fprintf( stderr, "usage: stread segment-name items|members|member member-id\n" );
+  exit( EXIT_FAILURE );
+}
+
+/**
+ * Compares the IDs of two published items, given by index.
+ *
+ * @param va void pointer to an index
+ * @param vb void pointer to an index
+ * @return less than 0 if va comes first, more than 0 if vb does
+ */
+static int compareItemIdx( void const *va, void const *vb )
+{
+  int a = sortingItems[ *( int const *) va ].id;
+  int b = sortingItems[ *( int const *) vb ].id;
+  return a < b ? -1 : a > b;
+}
+
+/**
+ * Compares the IDs of two published members, given by index.
+ *
+ * @param va void pointer to an index
+ * @param vb void pointer to an index
+ * @return less than 0 if va comes first, more than 0 if vb does
+ */
+static int compareMemberIdx( void const *va, void const *vb )
+{
+  return strncmp( sortingMembers[ *( int const *) va ].id, sortingMembers[ *( int const *) vb ].id, ID_MAX );
+}
+
+/**
+ * Makes the indices of a list, sorted with the given function.
+ *
+ * @param count length of the list
+ * @param compare compares two indices
+ * @return a new array of the sorted indices
+ */
+static int *sortedIndices( int count, int (* compare) (void const *va, void const *vb ) )
+{
+  int *order = ( int *)malloc( ( count + 1 ) * sizeof( int ) );
+  for ( int i = 0; i < count; i++ ) {
+    order[ i ] = i;
+  }
+  qsort( order, count, sizeof( int ), compare );
+  return order;
+}
+
+/**
+ * Keeps a count read from a buffer within what the segment has room for,
+ * since it may be torn until the read is checked.
+ *
+ * @param count the count read
+ * @param cap room in the segment
+ * @return the count, within 0 and cap
+ */
+static int clampCount( int count, int cap )
+{
+  return count < 0 ? 0 : count > cap ? cap : count;
+}
+
+/**
+ * Finds a published item by ID.
+ *
+ * @param items the items
+ * @param count how many there are
+ * @param id the ID
+ * @return the item, or NULL if there isn't one
+ */
+static PubItem const *findPubItem( PubItem const *items, int count, int id )
+{
+  for ( int i = 0; i < count; i++ ) {
+    if ( items[ i ].id == id ) {
+      return &items[ i ];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Prints a report from one buffer, in the same layout the fundraiser's
+ * list command uses, followed by the epoch of the snapshot it came from.
+ *
+ * @param map the mapping
+ * @param buffer the buffer
+ * @param report items, members or member
+ * @param id the member ID, for a member report
+ * @param out stream the report is written to
+ * @return false if the report or member is unknown
+ */
+static bool printReport( PubMap const *map, PubBuffer const *buffer, char const *report, char const *id, FILE *out )
+{
+  PubHeader const *header = map->header;
+  PubItem const *items = pubItems( map, buffer );
+  PubMember const *members = pubMembers( map, buffer );
+  PubSale const *sales = pubSales( map, buffer );
+  int iCount = clampCount( buffer->iCount, header->itemCap );
+  int mCount = clampCount( buffer->mCount, header->memberCap );
+
+  if ( strcmp( report, "items" ) == 0 ) {
+    sortingItems = items;
+    int *order = sortedIndices( iCount, compareItemIdx );
+    fprintf( out, "%-3s %-30s %6s %6s %6s\n", "ID", "Name", "Cost", "Sold", "Total" );
+    for ( int i = 0; i < iCount; i++ ) {
+      PubItem const *item = &items[ order[ i ] ];
+      fprintf( out, "%3d %-30.30s %6d %6d %6d\n", item->id, item->name, item->cost, item->sold,
+               item->sold * item->cost );
+    }
+    fprintf( out, "%-41s %6d %6d\n", "TOTAL", buffer->totalSold, buffer->totalSales );
+    free( order );
+  } else if ( strcmp( report, "members" ) == 0 ) {
+    sortingMembers = members;
+    int *order = sortedIndices( mCount, compareMemberIdx );
+    fprintf( out, "%-8s %-30s %6s %6s\n", "ID", "Name", "Sold", "Total" );
+    for ( int i = 0; i < mCount; i++ ) {
+      PubMember const *member = &members[ order[ i ] ];
+      fprintf( out, "%-8.8s %-30.30s %6d %6d\n", member->id, member->name, member->sold, member->sales );
+    }
+    fprintf( out, "%-39s %6d %6d\n", "TOTAL", buffer->totalSold, buffer->totalSales );
+    free( order );
+  } else if ( strcmp( report, "member" ) == 0 && id != NULL ) {
+    PubMember const *member = NULL;
+    for ( int i = 0; i < mCount && member == NULL; i++ ) {
+      if ( strncmp( members[ i ].id, id, ID_MAX + 1 ) == 0 ) {
+        member = &members[ i ];
+      }
+    }
+    if ( member == NULL ) {
+      return false;
+    }
+
+    // each item once, in order of ID, like the fundraiser's member report
+    int first = clampCount( member->first, header->saleCap );
+    int count = clampCount( member->count, header->saleCap - first );
+    fprintf( out, "%-3s %-30s %6s %6s %6s\n", "ID", "Name", "Cost", "Sold", "Total" );
+    int last = -1;
+    for ( int n = 0; n < count; n++ ) {
+      int next = -1;
+      for ( int j = first; j < first + count; j++ ) {
+        if ( sales[ j ].itemId > last && ( next < 0 || sales[ j ].itemId < sales[ next ].itemId ) ) {
+          next = j;
+        }
+      }
+      if ( next < 0 ) {
+        break;
+      }
+      last = sales[ next ].itemId;
+      PubItem const *item = findPubItem( items, iCount, last );
+      if ( item != NULL ) {
+        fprintf( out, "%3d %-30.30s %6d %6d %6d\n", item->id, item->name, item->cost, sales[ next ].sold,
+                 sales[ next ].sold * item->cost );
+      }
+    }
+    fprintf( out, "%-41s %6d %6d\n", "TOTAL", member->sold, member->sales );
+  } else {
+    return false;
+  }
+
+  fprintf( out, "EPOCH %ld\n", buffer->epoch );
+  return true;
+}
+
+int main( int argc, char **argv )
+{
+  if ( argc < 3 || argc > 4 || ( argc == 4 ) != ( strcmp( argv[ 2 ], "member" ) == 0 ) ) {
+    usage();
+  }
+
+  PubMap *map = openPubMap( argv[ 1 ] );
+  if ( map == NULL ) {
+    fprintf( stderr, "Can't open segment: %s\n", argv[ 1 ] );
+    exit( EXIT_FAILURE );
+  }
+
+  // the report is made in memory, and only printed once it's known to be from one copy
+  while ( true ) {
+    unsigned long seq = 0;
+    PubBuffer const *buffer = beginPubRead( map, &seq );
+    if ( buffer == NULL ) {
+      fprintf( stderr, "Can't open segment: %s\n", argv[ 1 ] );
+      closePubMap( map );
+      exit( EXIT_FAILURE );
+    }
+
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream( &text, &len );
+    bool valid = printReport( map, buffer, argv[ 2 ], argc == 4 ? argv[ 3 ] : NULL, out );
+    fclose( out );
+
+    if ( endPubRead( buffer, seq ) ) {
+      if ( valid ) {
+        fwrite( text, 1, len, stdout );
+      } else {
+        fprintf( stderr, "Invalid report\n" );
+      }
+      free( text );
+      closePubMap( map );
+      return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    free( text );
+  }
+}
@@ -0,0 +1,204 @@
+/**
+ * @file trace.c
+ * @author Luke Early
+ * Source file for Chrome trace output of command phases.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+/** Set while a trace file is open */
+static bool tracing = false;
+
+/** The trace file, written only while holding traceLock */
+static FILE *traceFile = NULL;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Whether an event has been written yet, so the rest need a comma */
+static bool wroteEvent = false;
+
+/** Every thread's ring, newest first */
+static TraceRing *rings = NULL;
+
+/** Number given to the next thread's ring */
+static int nextTid = 1;
+
+/** This thread's ring, or NULL until it records its first event */
+static __thread TraceRing *ring = NULL;
+
+/**
+ * Starts tracing to the file with the given name.
+ *
+ * @param filename name of the trace file
+ * @return false if the file can't be opened
+ */
+bool openTrace( char const *filename )
+{
+  traceFile = fopen( filename, "w" );
+  if ( traceFile == NULL ) {
+    return false;
+  }
+  fprintf( traceFile, "{\"traceEvents\":[\n" );
+  wroteEvent = false;
+  __atomic_store_n( &tracing, true, __ATOMIC_RELEASE );
+  return true;
+}
+
+/**
+ * Writes a string into the trace file as a JSON string.
+ *
+ * @param str the string
+ */
+static void writeJsonString( char const *str )
+{
+  fputc( '"', traceFile );
+  for ( ; *str != '\0'; str++ ) {
+    unsigned char ch = *str;
+    if ( ch == '"' || ch == '\\' ) {
+      fprintf( traceFile, "\\%c", ch );
+    } else if ( ch < 0x20 ) {
+      fprintf( traceFile, "\\u%04x", ch );
+    } else {
+      fputc( ch, traceFile );
+    }
+  }
+  fputc( '"', traceFile );
+}
+
+/**
+ * Writes out the events in a ring that haven't been written yet.
+ * Must be called holding traceLock.
+ *
+ * @param r the ring
+ */
+static void flushRing( TraceRing *r )
+{
+  long head = __atomic_load_n( &r->head, __ATOMIC_ACQUIRE );
+  int pid = getpid();
+
+  for ( long i = r->tail; i < head; i++ ) {
+    TraceEvent const *event = &r->events[ i % TRACE_RING_SIZE ];
+    fprintf( traceFile, "%s{\"name\":", wroteEvent ? ",\n" : "" );
+    writeJsonString( event->name );
+    fprintf( traceFile, ",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d",
+             event->phase, event->time / 1000, event->time % 1000, pid, r->tid );
+    if ( event->detail[ 0 ] != '\0' ) {
+      fprintf( traceFile, ",\"args\":{\"detail\":" );
+      writeJsonString( event->detail );
+      fputc( '}', traceFile );
+    }
+    fputc( '}', traceFile );
+    wroteEvent = true;
+  }
+
+  // the slots can be reused once they're written
+  __atomic_store_n( &r->tail, head, __ATOMIC_RELEASE );
+}
+
+/**
+ * Writes out every thread's events, finishes the trace file and closes
+ * it. No other thread may still be recording events.
+ */
+void closeTrace()
+{
+  if ( !tracing ) {
+    return;
+  }
+  __atomic_store_n( &tracing, false, __ATOMIC_RELEASE );
+
+  // rings are kept, since their threads may trace again if tracing restarts
+  pthread_mutex_lock( &traceLock );
+  for ( TraceRing *r = rings; r != NULL; r = r->next ) {
+    flushRing( r );
+  }
+  fprintf( traceFile, "\n]}\n" );
+  fclose( traceFile );
+  traceFile = NULL;
+  pthread_mutex_unlock( &traceLock );
+}
+
+/**
+ * Makes the ring for this thread and adds it to the list of rings.
+ *
+ * @return the new ring
+ */
+static TraceRing *makeRing()
+{
+  TraceRing *r = ( TraceRing *)malloc( sizeof( TraceRing ) );
+  r->tid = __atomic_fetch_add( &nextTid, 1, __ATOMIC_RELAXED );
+  r->head = 0;
+  r->tail = 0;
+
+  r->next = __atomic_load_n( &rings, __ATOMIC_RELAXED );
+  while ( !__atomic_compare_exchange_n( &rings, &r->next, r, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED ) ) {
+  }
+  return r;
+}
+
+/**
+ * Records one event in this thread's ring, writing the ring out first if
+ * it's full.
+ *
+ * @param name what the event is for
+ * @param phase 'B' or 'E'
+ * @param detail extra text to keep with it, or NULL
+ */
+static void record( char const *name, char phase, char const *detail )
+{
+  if ( ring == NULL ) {
+    ring = makeRing();
+  }
+
+  if ( ring->head - __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE ) == TRACE_RING_SIZE ) {
+    pthread_mutex_lock( &traceLock );
+    if ( traceFile != NULL ) {
+      flushRing( ring );
+    }
+    pthread_mutex_unlock( &traceLock );
+  }
+
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+
+  TraceEvent *event = &ring->events[ ring->head % TRACE_RING_SIZE ];
+  event->time = now.tv_sec * 1000000000LL + now.tv_nsec;
+  event->name = name;
+  event->phase = phase;
+  event->detail[ 0 ] = '\0';
+  if ( detail != NULL ) {
+    strncat( event->detail, detail, TRACE_DETAIL_MAX );
+  }
+
+  // the event is complete before a flush can see it
+  __atomic_store_n( &ring->head, ring->head + 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Records the start of a command or phase on this thread.
+ *
+ * @param name what's starting; must be a string literal
+ * @param detail extra text shown with the event, such as the command line, or NULL
+ */
+void traceBegin( char const *name, char const *detail )
+{
+  if ( __atomic_load_n( &tracing, __ATOMIC_RELAXED ) ) {
+    record( name, 'B', detail );
+  }
+}
+
+/**
+ * Records the end of a command or phase started with traceBegin().
+ *
+ * @param name what's ending, the same name it began with
+ */
+void traceEnd( char const *name )
+{
+  if ( __atomic_load_n( &tracing, __ATOMIC_RELAXED ) ) {
+    record( name, 'E', NULL );
+  }
+}
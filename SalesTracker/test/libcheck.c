@@ -0,0 +1,190 @@
+/**
+ * @file libcheck.c
+ * @author Luke Early
+ * Checks libsalestracker from many threads at once. Every thread records
+ * its own run of sales through st_record_sale(), all of them also selling
+ * one hot item, and queries the group as it goes. Once they're done the
+ * totals of every item, every member and the group are checked against
+ * what the sales add up to, and a few reports are printed for test.sh to
+ * compare.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "salestracker.h"
+
+/** Threads recording sales, and sales each one records */
+#define THREADS 16
+#define ROUNDS 2000
+
+/** Most items and members the check keeps track of */
+#define RECORDS_MAX 64
+
+/** Item every thread sells on every round */
+#define HOT_ITEM 365
+
+/** The group, and the items and members the threads sell */
+static StGroup *group;
+static StItemInfo items[ RECORDS_MAX ];
+static int itemCount;
+static StMemberInfo members[ RECORDS_MAX ];
+static int memberCount;
+
+/**
+ * Picks the sale a thread makes on a round, the same way every time.
+ *
+ * @param thread number of the thread
+ * @param round number of the round
+ * @param item set to the index of the item sold
+ * @param member set to the index of the member who sold it
+ * @param qty set to how many were sold
+ */
+static void pickSale( int thread, int round, int *item, int *member, int *qty )
+{
+  *item = ( thread * 3 + round ) % itemCount;
+  *member = ( thread + round * 7 ) % memberCount;
+  *qty = 1 + ( thread + round ) % 3;
+}
+
+/**
+ * Body of each selling thread: records its sales, and every so often
+ * queries the group and runs a report, which mustn't get in the way.
+ *
+ * @param arg the thread's number, as an int pointer
+ * @return NULL, or a non-NULL pointer if a sale was refused
+ */
+static void *sell( void *arg )
+{
+  int thread = *( int *) arg;
+  FILE *sink = fopen( "/dev/null", "w" );
+  bool refused = false;
+  for ( int round = 0; round < ROUNDS; round++ ) {
+    int item = 0;
+    int member = 0;
+    int qty = 0;
+    pickSale( thread, round, &item, &member, &qty );
+    refused |= !st_record_sale( group, members[ member ].id, items[ item ].id, qty );
+    refused |= !st_record_sale( group, members[ member ].id, HOT_ITEM, 1 );
+
+    if ( round % 100 == 0 ) {
+      StItemInfo itemInfo;
+      StMemberInfo memberInfo;
+      int sold = 0;
+      int sales = 0;
+      st_query_item( group, HOT_ITEM, &itemInfo );
+      st_query_member( group, members[ member ].id, &memberInfo );
+      st_query_totals( group, &sold, &sales );
+      st_run_command( group, "list topsellers item 365 3", sink );
+      st_run_command( group, "list topitems 3", sink );
+      st_run_command( group, "list topitems units 3", sink );
+      st_run_command( group, "list topsellers last 1 hour limit 3", sink );
+    }
+  }
+  fclose( sink );
+  return refused ? arg : NULL;
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @param argc number of command-line arguments
+ * @param argv the item file and the member file
+ * @return exit status
+ */
+int main( int argc, char **argv )
+{
+  if ( argc != 3 ) {
+    fprintf( stderr, "usage: libcheck item-file member-file\n" );
+    return EXIT_FAILURE;
+  }
+  group = st_open( argv[ 1 ], argv[ 2 ] );
+  if ( group == NULL ) {
+    return EXIT_FAILURE;
+  }
+
+  // the records to sell, and what they cost, read back from the files
+  FILE *fp = fopen( argv[ 1 ], "r" );
+  int id = 0;
+  while ( itemCount < RECORDS_MAX && fscanf( fp, "%d%*[^\n]", &id ) == 1 ) {
+    st_query_item( group, id, &items[ itemCount++ ] );
+  }
+  fclose( fp );
+  fp = fopen( argv[ 2 ], "r" );
+  char memberId[ ST_ID_MAX + 1 ];
+  while ( memberCount < RECORDS_MAX && fscanf( fp, "%8s%*[^\n]", memberId ) == 1 ) {
+    st_query_member( group, memberId, &members[ memberCount++ ] );
+  }
+  fclose( fp );
+
+  pthread_t ids[ THREADS ];
+  int numbers[ THREADS ];
+  for ( int i = 0; i < THREADS; i++ ) {
+    numbers[ i ] = i;
+    pthread_create( &ids[ i ], NULL, sell, &numbers[ i ] );
+  }
+  int refused = 0;
+  for ( int i = 0; i < THREADS; i++ ) {
+    void *result = NULL;
+    pthread_join( ids[ i ], &result );
+    refused += result != NULL;
+  }
+  printf( "threads with a refused sale: %d\n", refused );
+
+  // what every sale adds up to, worked out again on this thread
+  int itemSold[ RECORDS_MAX ] = { 0 };
+  int memberSold[ RECORDS_MAX ] = { 0 };
+  int memberSales[ RECORDS_MAX ] = { 0 };
+  int hot = 0;
+  while ( items[ hot ].id != HOT_ITEM ) {
+    hot++;
+  }
+  for ( int thread = 0; thread < THREADS; thread++ ) {
+    for ( int round = 0; round < ROUNDS; round++ ) {
+      int item = 0;
+      int member = 0;
+      int qty = 0;
+      pickSale( thread, round, &item, &member, &qty );
+      itemSold[ item ] += qty;
+      memberSold[ member ] += qty;
+      memberSales[ member ] += qty * items[ item ].cost;
+      itemSold[ hot ] += 1;
+      memberSold[ member ] += 1;
+      memberSales[ member ] += items[ hot ].cost;
+    }
+  }
+
+  int wrongItems = 0;
+  int totalSold = 0;
+  int totalSales = 0;
+  for ( int i = 0; i < itemCount; i++ ) {
+    StItemInfo info;
+    st_query_item( group, items[ i ].id, &info );
+    wrongItems += info.sold != itemSold[ i ] || info.sales != itemSold[ i ] * items[ i ].cost;
+    totalSold += itemSold[ i ];
+    totalSales += itemSold[ i ] * items[ i ].cost;
+  }
+  printf( "items with wrong totals: %d of %d\n", wrongItems, itemCount );
+
+  int wrongMembers = 0;
+  for ( int i = 0; i < memberCount; i++ ) {
+    StMemberInfo info;
+    st_query_member( group, members[ i ].id, &info );
+    wrongMembers += info.sold != memberSold[ i ] || info.sales != memberSales[ i ];
+  }
+  printf( "members with wrong totals: %d of %d\n", wrongMembers, memberCount );
+
+  int sold = 0;
+  int sales = 0;
+  st_query_totals( group, &sold, &sales );
+  printf( "group totals: sold %d, sales %d, %s\n", sold, sales,
+          sold == totalSold && sales == totalSales ? "right" : "wrong" );
+
+  st_run_command( group, "list topsellers item 365 5", stdout );
+  st_run_command( group, "list topitems 5", stdout );
+  st_run_command( group, "list topitems units 5", stdout );
+  st_close( group );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file loadcheck.c
+ * @author Luke Early
+ * Checks that files split into chunks for loading come back whole and in
+ * file order, on a first load and on loads of lines appended since. The
+ * split is forced down to small chunks on four threads, so files a few
+ * kilobytes long are split the way big ones are on a machine with more
+ * cores. What each load found is printed for test.sh to compare.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "loader.h"
+#include "group.h"
+#include "reload.h"
+
+/** Threads and smallest chunk the loads are split with */
+#define CHECK_THREADS 4
+#define CHECK_CHUNK_BYTES 256
+
+/** Files the checks write, removed by test.sh before each test */
+#define LINES_FILE "output-lines.txt"
+#define ITEMS_FILE "output-items.txt"
+#define MEMBERS_FILE "output-members.txt"
+
+/**
+ * Parses a line holding just a number.
+ *
+ * @param line the line
+ * @return the number in a newly allocated int, or NULL if the line isn't one
+ */
+static void *parseNumber( char *line )
+{
+  int value = 0;
+  int end = 0;
+  if ( sscanf( line, "%d %n", &value, &end ) != 1 || line[ end ] != '\0' ) {
+    return NULL;
+  }
+  int *record = ( int *)malloc( sizeof( int ) );
+  *record = value;
+  return record;
+}
+
+/**
+ * Writes the numbers from first up to but not including last to a file,
+ * one per line, padded to different widths so lines straddle the chunk
+ * boundaries in different places.
+ *
+ * @param filename the file
+ * @param mode "w" to start it again, "a" to add to its end
+ * @param first the first number
+ * @param last one past the last number
+ */
+static void writeNumbers( char const *filename, char const *mode, int first, int last )
+{
+  FILE *fp = fopen( filename, mode );
+  for ( int i = first; i < last; i++ ) {
+    fprintf( fp, "%*d\n", 1 + i % 7, i );
+  }
+  fclose( fp );
+}
+
+/**
+ * Loads the numbers file and prints how it was split, how many records it
+ * gave, and whether they were the numbers expected, in order.
+ *
+ * @param what describes the load
+ * @param mark what was loaded last time
+ * @param first the number the load should start with
+ */
+static void checkLoad( char const *what, FileMark *mark, int first )
+{
+  Load *load = loadFile( LINES_FILE, parseNumber, mark );
+  int expected = first;
+  bool inOrder = true;
+  for ( int i = 0; i < load->chunkCount; i++ ) {
+    for ( int j = 0; j < load->chunks[ i ].count; j++ ) {
+      int *record = ( int *)load->chunks[ i ].records[ j ];
+      if ( *record != expected++ ) {
+        inOrder = false;
+      }
+      free( record );
+    }
+  }
+
+  printf( "%s: %d chunks, %d records from %d, %s, %s%s\n", what, load->chunkCount, loadCount( load ), first,
+          inOrder ? "in order" : "out of order", load->appended ? "appended" : "whole file",
+          loadInvalid( load ) ? ", invalid" : "" );
+  freeLoad( load );
+}
+
+/**
+ * Prints how many items the group has and whether they're in the order
+ * the item file lists them, IDs counting up from 1000.
+ *
+ * @param what describes the load
+ * @param group the group
+ */
+static void checkItems( char const *what, Group *group )
+{
+  bool inOrder = true;
+  for ( int i = 0; i < group->iCount; i++ ) {
+    if ( group->iList[ i ]->id != 1000 + i ) {
+      inOrder = false;
+    }
+  }
+  printf( "%s: %d items, %s\n", what, group->iCount, inOrder ? "in file order" : "out of order" );
+}
+
+/**
+ * Writes items with IDs from first up to but not including last.
+ *
+ * @param mode "w" to start the file again, "a" to add to its end
+ * @param first the first ID
+ * @param last one past the last ID
+ */
+static void writeItems( char const *mode, int first, int last )
+{
+  FILE *fp = fopen( ITEMS_FILE, mode );
+  for ( int id = first; id < last; id++ ) {
+    fprintf( fp, "%d %d Item number %d\n", id, 1 + id % 20, id );
+  }
+  fclose( fp );
+}
+
+/**
+ * Starts a reload of the group and waits for it to finish.
+ *
+ * @param group the group
+ */
+static void reloadAndWait( Group *group )
+{
+  startReload( group );
+  struct timespec pause = { 0, 10000000L };
+  bool running = true;
+  while ( running ) {
+    nanosleep( &pause, NULL );
+    pthread_mutex_lock( &group->reload->lock );
+    running = group->reload->running;
+    pthread_mutex_unlock( &group->reload->lock );
+  }
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @return exit status
+ */
+int main()
+{
+  setLoadSplit( CHECK_THREADS, CHECK_CHUNK_BYTES );
+
+  // the chunks of a first load, and of lines added after it
+  FileMark mark = { 0, 0 };
+  writeNumbers( LINES_FILE, "w", 0, 1000 );
+  checkLoad( "first load", &mark, 0 );
+  checkLoad( "unchanged", &mark, 1000 );
+  writeNumbers( LINES_FILE, "a", 1000, 1500 );
+  checkLoad( "500 appended", &mark, 1000 );
+  writeNumbers( LINES_FILE, "a", 1500, 1510 );
+  checkLoad( "10 appended", &mark, 1500 );
+
+  // a file changed before its end is loaded whole again
+  writeNumbers( LINES_FILE, "w", 5000, 6600 );
+  checkLoad( "rewritten", &mark, 5000 );
+
+  // a bad line in the last chunk spoils the load
+  FILE *fp = fopen( LINES_FILE, "a" );
+  fprintf( fp, "not a number\n" );
+  fclose( fp );
+  FileMark fresh = { 0, 0 };
+  checkLoad( "bad last line", &fresh, 5000 );
+
+  // the group's items are kept in file order, and items appended to the
+  // file are added after them by a reload
+  writeItems( "w", 1000, 1400 );
+  fp = fopen( MEMBERS_FILE, "w" );
+  fprintf( fp, "ab Anne Brown\n" );
+  fclose( fp );
+  Group *group = makeGroup();
+  if ( !readItems( ITEMS_FILE, group ) || !readMembers( MEMBERS_FILE, group ) ) {
+    freeGroup( group );
+    return EXIT_FAILURE;
+  }
+  checkItems( "items loaded", group );
+  writeItems( "a", 1400, 1700 );
+  reloadAndWait( group );
+  checkItems( "items reloaded", group );
+  pthread_mutex_lock( &group->reload->lock );
+  printf( "%s\n", group->reload->result );
+  pthread_mutex_unlock( &group->reload->lock );
+
+  freeGroup( group );
+  return EXIT_SUCCESS;
+}
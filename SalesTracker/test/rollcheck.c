@@ -0,0 +1,134 @@
+/**
+ * @file rollcheck.c
+ * @author Luke Early
+ * Checks the sales rollups at fixed times, so bucket boundaries can be
+ * tested without waiting for the clock. Sales and windows are given as
+ * seconds after midnight UTC on a fixed day, and every window asked for
+ * is printed with what it adds up to, for test.sh to compare. Every sale
+ * is of one item costing 10, by one member.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "rollup.h"
+
+/** Midnight UTC on the day the checks start, in seconds since the epoch */
+#define DAY_ZERO 1699920000LL
+
+/** The only item sold */
+static Item item = { 1, "Towel", 10, 0, 0, NULL };
+
+/**
+ * Adds a sale to the rollup at the given time, printing it.
+ *
+ * @param rollup the rollup
+ * @param at when the sale happened, in seconds after DAY_ZERO
+ * @param sold how many were sold
+ */
+static void sell( Rollup *rollup, long long at, int sold )
+{
+  addRollup( rollup, DAY_ZERO + at, 0, 0, sold );
+  printf( "sale of %d at %lld\n", sold, at );
+}
+
+/**
+ * Prints what a window ending at the given time adds up to, or that
+ * the window is invalid.
+ *
+ * @param rollup the rollup
+ * @param count how many units the window covers
+ * @param unit the unit
+ * @param at when the window ends, in seconds after DAY_ZERO
+ */
+static void check( Rollup const *rollup, int count, char const *unit, long long at )
+{
+  Window window;
+  printf( "last %d %s at %lld: ", count, unit, at );
+  if ( !parseWindow( count, unit, DAY_ZERO + at, &window ) ) {
+    printf( "invalid\n" );
+    return;
+  }
+
+  // the sales come from the tallies, valued at the item's cost
+  Item *items[] = { &item };
+  TallyTable table = { NULL, 0, 0 };
+  tallyRollup( rollup, &window, items, 1, 1, &table );
+  int sales = 0;
+  for ( int i = 0; i < table.cap; i++ ) {
+    if ( table.slots[ i ].member >= 0 ) {
+      sales += table.slots[ i ].sales;
+    }
+  }
+  clearTallies( &table );
+  printf( "sold %d, sales %d\n", sumRollup( rollup, &window ), sales );
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @return exit status
+ */
+int main()
+{
+  Rollup *rollup = makeRollup();
+
+  // the first and last second of a minute share its bucket
+  sell( rollup, 0, 1 );
+  sell( rollup, 59, 2 );
+  sell( rollup, 60, 4 );
+  check( rollup, 1, "minute", 59 );
+  check( rollup, 1, "minute", 60 );
+  check( rollup, 2, "minutes", 60 );
+  check( rollup, 1, "minute", 119 );
+  check( rollup, 1, "minute", 120 );
+  check( rollup, 2, "minutes", 120 );
+  check( rollup, 3, "minutes", 120 );
+  check( rollup, 1, "hour", 120 );
+  check( rollup, 1, "day", 120 );
+
+  // an hour later the minute ring reaches back only to minute 1
+  sell( rollup, 3600, 8 );
+  check( rollup, 1, "hour", 3600 );
+  check( rollup, 2, "hours", 3600 );
+  check( rollup, 60, "minutes", 3600 );
+  check( rollup, 60, "minutes", 3659 );
+  check( rollup, 60, "minutes", 3660 );
+
+  // two days later the minute and hour rings have been reused
+  sell( rollup, 2 * 86400, 16 );
+  check( rollup, 60, "minutes", 2 * 86400 );
+  check( rollup, 24, "hours", 2 * 86400 );
+  check( rollup, 2, "days", 2 * 86400 );
+  check( rollup, 3, "days", 2 * 86400 );
+
+  // a sale older than the minute and hour rings only counts by the day
+  sell( rollup, 3630, 32 );
+  check( rollup, 24, "hours", 2 * 86400 );
+  check( rollup, 3, "days", 2 * 86400 );
+
+  // a window past the newest sale holds nothing but what it reaches back to
+  check( rollup, 1, "day", 3 * 86400 );
+  check( rollup, 7, "days", 8 * 86400 + 86399 );
+  check( rollup, 7, "days", 9 * 86400 );
+
+  // no sales at all
+  Rollup *empty = makeRollup();
+  check( empty, 7, "days", 0 );
+  freeRollup( empty );
+
+  // the most buckets of each unit, and one more
+  check( rollup, 60, "minutes", 0 );
+  check( rollup, 61, "minutes", 0 );
+  check( rollup, 24, "hours", 0 );
+  check( rollup, 25, "hours", 0 );
+  check( rollup, 7, "days", 0 );
+  check( rollup, 8, "days", 0 );
+  check( rollup, 0, "minutes", 0 );
+  check( rollup, -1, "hour", 0 );
+  check( rollup, 1, "week", 0 );
+  check( rollup, 1, "Hour", 0 );
+  check( rollup, 2, "mins", 0 );
+
+  freeRollup( rollup );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file servecheck.c
+ * @author Luke Early
+ * A client for fundraiser --serve, for test.sh to talk to the server
+ * with. Sends everything it reads from standard input to the socket, and
+ * writes everything the server sends back to standard output, until the
+ * server closes the connection.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** Size of each read from standard input or the socket */
+#define CHUNK 4096
+
+/**
+ * Connects to the Unix domain socket at the given path.
+ *
+ * @param path file system path of the socket
+ * @return the connected descriptor, or -1 on failure
+ */
+static int connectTo( char const *path )
+{
+  struct sockaddr_un addr;
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  if ( strlen( path ) >= sizeof( addr.sun_path ) ) {
+    return -1;
+  }
+  strcpy( addr.sun_path, path );
+
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if ( fd >= 0 && connect( fd, ( struct sockaddr *)&addr, sizeof( addr ) ) < 0 ) {
+    close( fd );
+    fd = -1;
+  }
+  return fd;
+}
+
+/**
+ * Sends all len bytes to the socket.
+ *
+ * @param fd the socket
+ * @param data bytes to send
+ * @param len number of bytes
+ * @return false if the server has gone away
+ */
+static bool sendAll( int fd, char const *data, ssize_t len )
+{
+  while ( len > 0 ) {
+    ssize_t sent = send( fd, data, len, MSG_NOSIGNAL );
+    if ( sent < 0 && errno != EINTR ) {
+      return false;
+    }
+    if ( sent > 0 ) {
+      data += sent;
+      len -= sent;
+    }
+  }
+  return true;
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @param argc number of command-line arguments
+ * @param argv the socket's path is the only argument
+ * @return exit status
+ */
+int main( int argc, char **argv )
+{
+  if ( argc != 2 ) {
+    fprintf( stderr, "usage: servecheck socket-path\n" );
+    return EXIT_FAILURE;
+  }
+  int fd = connectTo( argv[ 1 ] );
+  if ( fd < 0 ) {
+    fprintf( stderr, "Can't connect to %s\n", argv[ 1 ] );
+    return EXIT_FAILURE;
+  }
+
+  // input is sent as it comes, so the replies can't back up behind it
+  struct pollfd fds[ 2 ];
+  fds[ 0 ].fd = STDIN_FILENO;
+  fds[ 0 ].events = POLLIN;
+  fds[ 1 ].fd = fd;
+  fds[ 1 ].events = POLLIN;
+  char buf[ CHUNK ];
+  while ( true ) {
+    if ( poll( fds, 2, -1 ) < 0 ) {
+      if ( errno == EINTR ) {
+        continue;
+      }
+      break;
+    }
+
+    if ( fds[ 0 ].revents != 0 ) {
+      ssize_t got = read( STDIN_FILENO, buf, CHUNK );
+      if ( got > 0 && !sendAll( fd, buf, got ) ) {
+        got = 0;
+      }
+      if ( got <= 0 ) {
+        // no more commands, but keep reading what the server sends
+        shutdown( fd, SHUT_WR );
+        fds[ 0 ].fd = -1;
+      }
+    }
+
+    if ( fds[ 1 ].revents != 0 ) {
+      ssize_t got = read( fd, buf, CHUNK );
+      if ( got <= 0 ) {
+        break;
+      }
+      fwrite( buf, 1, got, stdout );
+    }
+  }
+
+  close( fd );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file snapcheck.c
+ * @author Luke Early
+ * Checks that a read view stays as it was opened while another thread
+ * records sales and reloads the group under it, and that the records the
+ * view can still see are retired rather than freed until it's closed.
+ * What each step found is printed for test.sh to compare.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "group.h"
+#include "snapshot.h"
+#include "reload.h"
+
+/** Files the check writes, removed by test.sh before each test */
+#define ITEMS_FILE "output-items.txt"
+#define MEMBERS_FILE "output-members.txt"
+
+/**
+ * Writes text to a file, replacing what it held.
+ *
+ * @param filename the file
+ * @param text what to write
+ */
+static void writeFile( char const *filename, char const *text )
+{
+  FILE *fp = fopen( filename, "w" );
+  fputs( text, fp );
+  fclose( fp );
+}
+
+/**
+ * Describes every item and member in a read view.
+ *
+ * @param group the live group
+ * @param view the view
+ * @return a newly allocated description
+ */
+static char *describeView( Group const *group, Group const *view )
+{
+  char *text = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream( &text, &len );
+  for ( int i = 0; i < view->iCount; i++ ) {
+    Item const *item = view->iList[ i ];
+    fprintf( out, "  item %d %s costs %d, sold %d\n", item->id, item->name, item->cost, item->numSold );
+  }
+  for ( int i = 0; i < view->mCount; i++ ) {
+    Member const *member = view->mList[ i ];
+    fprintf( out, "  member %s %s sold %d for %d\n", memberId( group, member ), memberName( group, member ),
+             member->sold, member->sales );
+  }
+  fclose( out );
+  return text;
+}
+
+/**
+ * Tells whether the given memory is on the group's retired list, waiting
+ * to be freed.
+ *
+ * @param group the live group
+ * @param ptr the memory
+ * @return true if it's there
+ */
+static bool isRetired( Group *group, void const *ptr )
+{
+  Versions *v = group->versions;
+  pthread_mutex_lock( &v->lock );
+  bool found = false;
+  for ( Retired *r = v->retired; r != NULL; r = r->next ) {
+    if ( r->ptr == ptr ) {
+      found = true;
+    }
+  }
+  pthread_mutex_unlock( &v->lock );
+  return found;
+}
+
+/**
+ * Counts what's on the group's retired list.
+ *
+ * @param group the live group
+ * @return how many entries there are
+ */
+static int retiredCount( Group *group )
+{
+  Versions *v = group->versions;
+  pthread_mutex_lock( &v->lock );
+  int count = 0;
+  for ( Retired *r = v->retired; r != NULL; r = r->next ) {
+    count++;
+  }
+  pthread_mutex_unlock( &v->lock );
+  return count;
+}
+
+/**
+ * Body of the thread changing the group: records sales, reloads an item
+ * file that changes a cost and adds an item, sells the new item, and
+ * opens and closes a view of its own, which publishes the changes and
+ * frees whatever no pinned reader can see.
+ *
+ * @param arg the live group
+ * @return NULL
+ */
+static void *changeGroup( void *arg )
+{
+  Group *group = ( Group *)arg;
+  recordSale( group, "ab", 20, 3 );
+  recordSale( group, "cd", 30, 1 );
+
+  writeFile( ITEMS_FILE, "10 5 Towel\n20 12 Mug\n30 5 Candle\n40 8 Lamp\n" );
+  startReload( group );
+  struct timespec pause = { 0, 10000000L };
+  bool running = true;
+  while ( running ) {
+    nanosleep( &pause, NULL );
+    pthread_mutex_lock( &group->reload->lock );
+    running = group->reload->running;
+    pthread_mutex_unlock( &group->reload->lock );
+  }
+
+  recordSale( group, "cd", 40, 2 );
+  closeView( group, openView( group, true ) );
+  return NULL;
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @return exit status
+ */
+int main()
+{
+  writeFile( ITEMS_FILE, "10 5 Towel\n20 10 Mug\n30 5 Candle\n" );
+  writeFile( MEMBERS_FILE, "ab Anne Brown\ncd Carl Dunn\n" );
+  Group *group = makeGroup();
+  if ( !readItems( ITEMS_FILE, group ) || !readMembers( MEMBERS_FILE, group ) ) {
+    freeGroup( group );
+    return EXIT_FAILURE;
+  }
+  recordSale( group, "ab", 10, 2 );
+  recordSale( group, "cd", 20, 1 );
+
+  Group *view = openView( group, true );
+  char *before = describeView( group, view );
+  printf( "view opened:\n%s", before );
+
+  pthread_t changer;
+  pthread_create( &changer, NULL, changeGroup, group );
+  pthread_join( changer, NULL );
+
+  Group *latest = openView( group, true );
+  char *after = describeView( group, latest );
+  printf( "group after sales and a reload:\n%s", after );
+  closeView( group, latest );
+  free( after );
+
+  after = describeView( group, view );
+  printf( "view read again: %s\n", strcmp( before, after ) == 0 ? "unchanged" : "changed" );
+  free( before );
+  free( after );
+
+  // the view's own copies are still reachable, so they can't have been freed
+  printf( "view's snapshot retired, not freed: %s\n", isRetired( group, view->snapshot ) ? "yes" : "no" );
+  printf( "view's copy of item 20 retired, not freed: %s\n", isRetired( group, view->iList[ 1 ] ) ? "yes" : "no" );
+
+  closeView( group, view );
+  printf( "retired entries left once the view is closed: %d\n", retiredCount( group ) );
+
+  freeGroup( group );
+  return EXIT_SUCCESS;
+}
@@ -7,12 +7,180 @@ runTest() {
   TESTNO=$1
   ESTATUS=$2
 
-  rm -f output.txt stderr.txt
+  rm -f output.txt stderr.txt output-*
   
   echo "Test $TESTNO: ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt"
   ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt
   STATUS=$?
 
+  checkOutput
+}
+
+# Like runTest, but the item file the program loads, items-reload.txt,
+# starts as a copy of the third argument and is replaced with the fourth
+# just before the input's reload line, which then gets a moment to finish.
+# If there are fifth and sixth arguments, the member file the program loads,
+# members-reload.txt, goes from one to the other the same way.
+runReloadTest() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+  cp $3 items-reload.txt
+  if [ -n "$5" ]; then
+    cp $5 members-reload.txt
+  fi
+
+  echo "Test $TESTNO: ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt, reloading $4 $6"
+  while IFS= read -r line; do
+    if [ "$line" == "reload" ]; then
+      sleep 1
+      cp $4 items-reload.txt
+      if [ -n "$6" ]; then
+        cp $6 members-reload.txt
+      fi
+      echo "$line"
+      sleep 1
+    else
+      echo "$line"
+    fi
+  done < input-$TESTNO.txt | ./fundraiser ${args[@]} > output.txt 2> stderr.txt
+  STATUS=$?
+
+  checkOutput
+}
+
+# Like runTest, but runs a check program built from the test directory
+# instead of fundraiser, with no input.
+runCheck() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+
+  echo "Test $TESTNO: ./$3 > output.txt 2> stderr.txt"
+  ./$3 > output.txt 2> stderr.txt
+  STATUS=$?
+
+  checkOutput
+}
+
+# Like runTest, but args must write a trace to output-trace.json, which
+# is then checked with tracecheck, its verdict added to the output.
+runTraceTest() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+
+  echo "Test $TESTNO: ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt, checking output-trace.json"
+  ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt
+  STATUS=$?
+  if [ $STATUS -eq 0 ]; then
+    ./tracecheck output-trace.json >> output.txt 2>> stderr.txt
+    STATUS=$?
+  fi
+
+  checkOutput
+}
+
+# Like runTest, but runs the input with --jobs 4, so its runs of reports
+# are spread over threads, and checks the output is the same as running
+# one command at a time with --jobs 1.
+runJobsTest() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+
+  echo "Test $TESTNO: ./fundraiser --jobs 4 ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt, compared with --jobs 1"
+  ./fundraiser --jobs 1 ${args[@]} < input-$TESTNO.txt > output-jobs-1.txt 2> /dev/null
+  ./fundraiser --jobs 4 ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt
+  STATUS=$?
+
+  if ! diff -q output-jobs-1.txt output.txt >/dev/null 2>&1 ; then
+    echo "**** FAILED - output with --jobs 4 didn't match output with --jobs 1"
+    FAIL=1
+    return 1
+  fi
+
+  checkOutput
+}
+
+# Like runTest, but args must start the server on output-socket. Three
+# clients talk to it with servecheck: input-NN-1.txt and input-NN-2.txt
+# are sent at the same time by two clients, whose replies go to
+# output-client-1.txt and output-client-2.txt, then input-NN.txt is sent
+# once they're done, its reply going to output.txt. A fourth client stays
+# connected with nothing to say while the server is stopped with SIGTERM.
+runServeTest() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+
+  echo "Test $TESTNO: ./fundraiser ${args[@]} 2> stderr.txt, serving input-$TESTNO-1.txt, input-$TESTNO-2.txt then input-$TESTNO.txt"
+  ./fundraiser ${args[@]} > output-server.txt 2> stderr.txt &
+  SERVER=$!
+  for i in $(seq 50); do
+    [ -S output-socket ] && break
+    sleep 0.1
+  done
+
+  sleep 2 | ./servecheck output-socket > output-idle.txt &
+  IDLE=$!
+  ./servecheck output-socket < input-$TESTNO-1.txt > output-client-1.txt &
+  CLIENT1=$!
+  ./servecheck output-socket < input-$TESTNO-2.txt > output-client-2.txt &
+  CLIENT2=$!
+  wait $CLIENT1 $CLIENT2
+  ./servecheck output-socket < input-$TESTNO.txt > output.txt
+
+  kill -TERM $SERVER
+  wait $SERVER
+  STATUS=$?
+  wait $IDLE
+  if [ -e output-socket ]; then
+    echo "Socket file left behind" >> output.txt
+  fi
+
+  checkOutput
+}
+
+# Like runReloadTest, but args must publish to the segment named by the
+# fifth argument. Input lines starting with stread aren't sent; after a
+# moment for the copy to be made, the rest of the line is passed to stread
+# and its output added to output-stread.txt. Epochs depend on when the
+# copies were made, so they aren't compared.
+runPublishTest() {
+  TESTNO=$1
+  ESTATUS=$2
+
+  rm -f output.txt stderr.txt output-*
+  cp $3 items-reload.txt
+
+  echo "Test $TESTNO: ./fundraiser ${args[@]} < input-$TESTNO.txt > output.txt 2> stderr.txt, reloading $4, reading $5"
+  while IFS= read -r line; do
+    if [ "$line" == "reload" ]; then
+      sleep 1
+      cp $4 items-reload.txt
+      echo "$line"
+      sleep 1
+    elif [ "${line%% *}" == "stread" ]; then
+      sleep 1
+      echo "$line" >> output-stread.txt
+      ./stread $5 ${line#stread } 2>&1 | sed 's/^EPOCH [0-9]*$/EPOCH/' >> output-stread.txt
+    else
+      echo "$line"
+    fi
+  done < input-$TESTNO.txt | ./fundraiser ${args[@]} > output.txt 2> stderr.txt
+  STATUS=$?
+
+  checkOutput
+}
+
+# Checks the exit status and output of the test just run.
+checkOutput() {
   # Make sure the program exited with the right exit status.
   if [ $STATUS -ne $ESTATUS ]; then
       echo "**** FAILED - Expected an exit status of $ESTATUS, but got: $STATUS"
@@ -35,6 +203,16 @@ runTest() {
       return 1
   fi
 
+  # Make sure any file the test wrote, output-<name>, matches expected-NN-<name>.
+  for EXPECTED in expected-$TESTNO-*; do
+    if [ -f "$EXPECTED" ] &&
+	   ! diff -q "$EXPECTED" "output-${EXPECTED#expected-$TESTNO-}" >/dev/null 2>&1 ; then
+      echo "**** FAILED - output to ${EXPECTED#expected-$TESTNO-} didn't match expected"
+      FAIL=1
+      return 1
+    fi
+  done
+
   echo "PASS"
   return 0
 }
@@ -109,6 +287,93 @@ if [ -x fundraiser ] ; then
     args=(items-h.txt members-b.txt)
     runTest 20 1
  
+    args=(items-c.txt members-c.txt)
+    runTest 21 0
+ 
+    args=(items-c.txt members-c.txt)
+    runTest 22 0
+ 
+    args=(items-reload.txt members-c.txt)
+    runReloadTest 23 0 items-i.txt items-j.txt
+ 
+    args=(--sketch 3 items-c.txt members-c.txt)
+    runTest 24 0
+ 
+    args=(items-c.txt members-c.txt)
+    runTest 25 0
+ 
+    args=(items-k.txt members-k.txt)
+    runTest 26 0
+ 
+    args=(items-c.txt members-c.txt)
+    runTest 27 0
+
+    make rollcheck
+    runCheck 28 0 rollcheck
+ 
+    args=(items-c.txt members-c.txt)
+    runTest 29 0
+ 
+    # test 31 reads back the history test 30 writes, with the members in another order
+    rm -f history-test.bin
+    args=(--history history-test.bin --history-ms 60000 items-c.txt members-c.txt)
+    runTest 30 0
+ 
+    args=(--history history-test.bin --history-ms 60000 items-c.txt members-l.txt)
+    runTest 31 0
+ 
+    args=(items-c.txt members-c.txt)
+    runTest 32 0
+ 
+    make tracecheck
+    args=(--trace output-trace.json --jobs 4 items-c.txt members-c.txt)
+    runTraceTest 33 0
+ 
+    args=(items-c.txt members-c.txt)
+    runJobsTest 34 0
+ 
+    make servecheck
+    args=(--serve output-socket items-c.txt members-c.txt)
+    runServeTest 35 0
+ 
+    # the reload adds more items than a new segment has room for, so the
+    # segment is filled again under another name and renamed over the first
+    awk '{ print } END { for ( id = 1000; id < 2100; id++ ) printf "%d   1 Extra item %d\n", id, id }' items-c.txt > items-publish-big.txt
+    args=(--publish /salestracker-test --publish-sales 1 --publish-ms 100 items-reload.txt members-c.txt)
+    runPublishTest 36 0 items-c.txt items-publish-big.txt /salestracker-test
+ 
+    make loadcheck
+    runCheck 37 0 loadcheck
+ 
+    # one member renamed and two added to the end, so the whole file is read
+    args=(items-reload.txt members-reload.txt)
+    runReloadTest 38 0 items-i.txt items-i.txt members-c.txt members-m.txt
+ 
+    # the member file lists jc again, so nothing changes, not even the items
+    args=(items-reload.txt members-reload.txt)
+    runReloadTest 39 0 items-i.txt items-j.txt members-c.txt members-n.txt
+ 
+    make snapcheck
+    runCheck 40 0 snapcheck
+ 
+    # sixteen threads selling through the library, all of them one hot item
+    make libcheck
+    runCheck 41 0 "libcheck items-c.txt members-c.txt"
+ 
+    # windows value sales at the costs after a reload, for items and members alike
+    args=(items-reload.txt members-c.txt)
+    runReloadTest 42 0 items-i.txt items-j.txt
+ 
+    # top items by revenue and by units, merged from the sale shards, and
+    # reranked by a reload that changes costs
+    args=(items-reload.txt members-c.txt)
+    runReloadTest 43 0 items-i.txt items-j.txt
+ 
+    # members are made from the lazily loaded file as sales and reports
+    # need them, and an export makes the rest
+    args=(--lazy items-c.txt members-c.txt)
+    runTest 44 0
+ 
 else
     echo "**** Your program couldn't be tested since it didn't compile successfully."
     FAIL=1
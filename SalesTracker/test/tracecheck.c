@@ -0,0 +1,388 @@
+/**
+ * @file tracecheck.c
+ * @author Luke Early
+ * Checks a trace file written with --trace: that it parses as JSON, that
+ * it holds a traceEvents array, and that on every thread each end event
+ * closes the begin event opened last with the same name. Prints one line
+ * saying the trace is valid, or what was wrong with it, for test.sh to
+ * compare. How many events there are depends on the options fundraiser
+ * ran with, so only an empty trace is rejected for its length.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+/** Most threads a trace can show */
+#define MAX_THREADS 256
+
+/** Deepest begin events can nest on one thread */
+#define MAX_DEPTH 64
+
+/** Longest event name kept */
+#define NAME_MAX 63
+
+/**
+ * The text being parsed, and how far the parser has got.
+ */
+struct ParserStruct {
+  char const *pos;
+  char const *end;
+};
+typedef struct ParserStruct Parser;
+
+/**
+ * The fields of one trace event that are checked.
+ */
+struct EventStruct {
+  char name[ NAME_MAX + 1 ];
+  char phase[ NAME_MAX + 1 ];
+  long tid;
+  bool hasName;
+  bool hasPhase;
+  bool hasTid;
+};
+typedef struct EventStruct Event;
+
+/**
+ * Begin events still open on one thread.
+ */
+struct ThreadStruct {
+  long tid;
+  int depth;
+  char open[ MAX_DEPTH ][ NAME_MAX + 1 ];
+};
+typedef struct ThreadStruct Thread;
+
+static bool parseValue( Parser *parser );
+
+/**
+ * Skips blanks.
+ *
+ * @param parser the parser
+ */
+static void skipBlanks( Parser *parser )
+{
+  while ( parser->pos < parser->end && isspace( ( unsigned char ) *parser->pos ) ) {
+    parser->pos++;
+  }
+}
+
+/**
+ * Skips blanks and then the given character, if it's next.
+ *
+ * @param parser the parser
+ * @param ch the character
+ * @return false if something else is next
+ */
+static bool expect( Parser *parser, char ch )
+{
+  skipBlanks( parser );
+  if ( parser->pos < parser->end && *parser->pos == ch ) {
+    parser->pos++;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Parses a string, keeping as much of it as fits.
+ *
+ * @param parser the parser
+ * @param buf where the string goes, or NULL to skip it
+ * @return false if it isn't a valid string
+ */
+static bool parseString( Parser *parser, char *buf )
+{
+  if ( !expect( parser, '"' ) ) {
+    return false;
+  }
+  int len = 0;
+  while ( parser->pos < parser->end && *parser->pos != '"' ) {
+    char ch = *parser->pos++;
+    if ( ( unsigned char ) ch < ' ' ) {
+      return false;
+    }
+    if ( ch == '\\' ) {
+      if ( parser->pos >= parser->end || strchr( "\"\\/bfnrtu", *parser->pos ) == NULL ) {
+        return false;
+      }
+      ch = *parser->pos++;
+    }
+    if ( buf != NULL && len < NAME_MAX ) {
+      buf[ len++ ] = ch;
+    }
+  }
+  if ( buf != NULL ) {
+    buf[ len ] = '\0';
+  }
+  return expect( parser, '"' );
+}
+
+/**
+ * Parses a number.
+ *
+ * @param parser the parser
+ * @param value set to the number, if not NULL
+ * @return false if it isn't a valid number
+ */
+static bool parseNumber( Parser *parser, double *value )
+{
+  skipBlanks( parser );
+  char *after = NULL;
+  double number = strtod( parser->pos, &after );
+  if ( after == parser->pos || after > parser->end ) {
+    return false;
+  }
+  parser->pos = after;
+  if ( value != NULL ) {
+    *value = number;
+  }
+  return true;
+}
+
+/**
+ * Parses an object, or an array if close is ']', calling parseValue() on
+ * each member.
+ *
+ * @param parser the parser, just past the opening bracket
+ * @param close the closing bracket
+ * @return false if it isn't valid
+ */
+static bool parseMembers( Parser *parser, char close )
+{
+  if ( expect( parser, close ) ) {
+    return true;
+  }
+  do {
+    if ( close == '}' && ( !parseString( parser, NULL ) || !expect( parser, ':' ) ) ) {
+      return false;
+    }
+    if ( !parseValue( parser ) ) {
+      return false;
+    }
+  } while ( expect( parser, ',' ) );
+  return expect( parser, close );
+}
+
+/**
+ * Parses any JSON value.
+ *
+ * @param parser the parser
+ * @return false if it isn't valid
+ */
+static bool parseValue( Parser *parser )
+{
+  skipBlanks( parser );
+  if ( parser->pos >= parser->end ) {
+    return false;
+  }
+  char ch = *parser->pos;
+  if ( ch == '{' || ch == '[' ) {
+    parser->pos++;
+    return parseMembers( parser, ch == '{' ? '}' : ']' );
+  }
+  if ( ch == '"' ) {
+    return parseString( parser, NULL );
+  }
+  char const *words[] = { "true", "false", "null" };
+  for ( int i = 0; i < 3; i++ ) {
+    int len = strlen( words[ i ] );
+    if ( parser->end - parser->pos >= len && strncmp( parser->pos, words[ i ], len ) == 0 ) {
+      parser->pos += len;
+      return true;
+    }
+  }
+  return parseNumber( parser, NULL );
+}
+
+/**
+ * Parses one trace event, keeping its name, phase and thread.
+ *
+ * @param parser the parser
+ * @param event set to the event's fields
+ * @return false if it isn't a valid object
+ */
+static bool parseEvent( Parser *parser, Event *event )
+{
+  memset( event, 0, sizeof( Event ) );
+  if ( !expect( parser, '{' ) ) {
+    return false;
+  }
+  if ( expect( parser, '}' ) ) {
+    return true;
+  }
+  do {
+    char key[ NAME_MAX + 1 ];
+    if ( !parseString( parser, key ) || !expect( parser, ':' ) ) {
+      return false;
+    }
+    double tid = 0;
+    bool valid;
+    if ( strcmp( key, "name" ) == 0 ) {
+      valid = event->hasName = parseString( parser, event->name );
+    } else if ( strcmp( key, "ph" ) == 0 ) {
+      valid = event->hasPhase = parseString( parser, event->phase );
+    } else if ( strcmp( key, "tid" ) == 0 ) {
+      valid = event->hasTid = parseNumber( parser, &tid );
+      event->tid = ( long ) tid;
+    } else {
+      valid = parseValue( parser );
+    }
+    if ( !valid ) {
+      return false;
+    }
+  } while ( expect( parser, ',' ) );
+  return expect( parser, '}' );
+}
+
+/**
+ * Checks one event against the begin events open on its thread.
+ *
+ * @param threads the threads seen so far
+ * @param threadCount how many there are, updated if this is a new one
+ * @param event the event
+ * @return a description of what's wrong, or NULL if nothing is
+ */
+static char const *checkEvent( Thread *threads, int *threadCount, Event const *event )
+{
+  if ( !event->hasName || !event->hasPhase || !event->hasTid ) {
+    return "event without a name, phase or thread";
+  }
+
+  Thread *thread = NULL;
+  for ( int t = 0; t < *threadCount && thread == NULL; t++ ) {
+    if ( threads[ t ].tid == event->tid ) {
+      thread = &threads[ t ];
+    }
+  }
+  if ( thread == NULL ) {
+    if ( *threadCount == MAX_THREADS ) {
+      return "too many threads";
+    }
+    thread = &threads[ ( *threadCount )++ ];
+    thread->tid = event->tid;
+  }
+
+  if ( strcmp( event->phase, "B" ) == 0 ) {
+    if ( thread->depth == MAX_DEPTH ) {
+      return "begin events nested too deep";
+    }
+    strcpy( thread->open[ thread->depth++ ], event->name );
+  } else if ( strcmp( event->phase, "E" ) == 0 ) {
+    if ( thread->depth == 0 || strcmp( thread->open[ thread->depth - 1 ], event->name ) != 0 ) {
+      return "end event doesn't match the last begin event";
+    }
+    thread->depth--;
+  } else {
+    return "phase isn't B or E";
+  }
+  return NULL;
+}
+
+/**
+ * Checks a whole trace.
+ *
+ * @param parser the parser, at the start of the file
+ * @param events set to how many events there were
+ * @return a description of what's wrong, or NULL if nothing is
+ */
+static char const *checkTrace( Parser *parser, int *events )
+{
+  static Thread threads[ MAX_THREADS ];
+  int threadCount = 0;
+  char key[ NAME_MAX + 1 ];
+
+  *events = 0;
+  if ( !expect( parser, '{' ) || !parseString( parser, key ) || strcmp( key, "traceEvents" ) != 0
+       || !expect( parser, ':' ) || !expect( parser, '[' ) ) {
+    return "no traceEvents array";
+  }
+  if ( !expect( parser, ']' ) ) {
+    do {
+      Event event;
+      if ( !parseEvent( parser, &event ) ) {
+        return "not valid JSON";
+      }
+      char const *problem = checkEvent( threads, &threadCount, &event );
+      if ( problem != NULL ) {
+        return problem;
+      }
+      ( *events )++;
+    } while ( expect( parser, ',' ) );
+    if ( !expect( parser, ']' ) ) {
+      return "not valid JSON";
+    }
+  }
+
+  // anything else in the object just has to be valid
+  while ( expect( parser, ',' ) ) {
+    if ( !parseString( parser, NULL ) || !expect( parser, ':' ) || !parseValue( parser ) ) {
+      return "not valid JSON";
+    }
+  }
+  if ( !expect( parser, '}' ) ) {
+    return "not valid JSON";
+  }
+  skipBlanks( parser );
+  if ( parser->pos != parser->end ) {
+    return "text after the JSON";
+  }
+
+  if ( *events == 0 ) {
+    return "no events";
+  }
+  for ( int t = 0; t < threadCount; t++ ) {
+    if ( threads[ t ].depth > 0 ) {
+      return "begin event never ended";
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Starting point of the program.
+ *
+ * @param argc number of command-line arguments
+ * @param argv the trace file's name is the only argument
+ * @return exit status
+ */
+int main( int argc, char **argv )
+{
+  if ( argc != 2 ) {
+    fprintf( stderr, "usage: tracecheck trace-file\n" );
+    return EXIT_FAILURE;
+  }
+  FILE *fp = fopen( argv[ 1 ], "r" );
+  if ( fp == NULL ) {
+    fprintf( stderr, "Can't open file: %s\n", argv[ 1 ] );
+    return EXIT_FAILURE;
+  }
+
+  // read the whole file, with a terminator so strtod can't run off the end
+  int cap = 1024;
+  int len = 0;
+  char *text = ( char *)malloc( cap );
+  int got;
+  while ( ( got = fread( text + len, 1, cap - len - 1, fp ) ) > 0 ) {
+    len += got;
+    if ( len + 1 == cap ) {
+      cap *= 2;
+      text = ( char *)realloc( text, cap );
+    }
+  }
+  fclose( fp );
+  text[ len ] = '\0';
+
+  Parser parser = { text, text + len };
+  int events = 0;
+  char const *problem = checkTrace( &parser, &events );
+  if ( problem != NULL ) {
+    printf( "Trace is invalid: %s\n", problem );
+  } else {
+    printf( "Trace is valid, balanced on every thread\n" );
+  }
+  free( text );
+  return problem == NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+}